@@ -9,6 +9,22 @@ ClientParticles = ClientParticles or {}
 -- Cache for loaded particle systems
 local loadedSystems = {}
 
+-- Instances following an entity: [instanceID] = {entity, attachmentID, offset}
+local attachedInstances = {}
+
+-- Current world position of an entity attachment plus offset
+local function GetAttachmentPosition(entity, attachmentID, offset)
+    local attachPos = entity:GetPos()
+    if attachmentID > 0 then
+        local attach = entity:GetAttachment(attachmentID)
+        if attach then
+            attachPos = attach.Pos
+        end
+    end
+
+    return attachPos + offset
+end
+
 --[[
     Load a particle system from file
     @param effectName string - Name of the .gpart file
@@ -20,8 +36,23 @@ function ClientParticles.Load(effectName)
         return true
     end
 
-    -- Read the .gpart file using GMod's file system
+    -- Read the .gpart file using GMod's file system, preferring the
+    -- compiled .gpartc next to it (built with gpartc, skips JSON parsing)
     local filePath = "particles/" .. effectName
+    local compiledPath = filePath .. "c"
+    if file.Exists(compiledPath, "GAME") then
+        local compiledContent = file.Read(compiledPath, "GAME")
+        if compiledContent and particles.LoadFromString(effectName, compiledContent) then
+            loadedSystems[effectName] = true
+            print("[ClientParticles] Loaded: " .. effectName .. " (compiled)")
+            return true
+        end
+
+        -- Stale after a format change, or damaged: the JSON still works
+        print("[ClientParticles] Warning: " .. compiledPath .. " is out of date, loading " .. filePath ..
+              " instead (rebuild it with gpartc)")
+    end
+
     local jsonContent = file.Read(filePath, "GAME")
 
     if not jsonContent then
@@ -51,11 +82,13 @@ end
     @param position Vector - World position
     @param scale number - Scale multiplier (optional)
     @param color Color - Color tint (optional)
+    @param priority number - Budget priority, higher keeps more particles (optional)
     @return number - Instance ID, or -1 on failure
 ]]
-function ClientParticles.Spawn(effectName, position, scale, color)
+function ClientParticles.Spawn(effectName, position, scale, color, priority)
     scale = scale or 1.0
     color = color or Color(255, 255, 255, 255)
+    priority = priority or 1.0
 
     -- Ensure the system is loaded
     if not loadedSystems[effectName] then
@@ -63,7 +96,7 @@ function ClientParticles.Spawn(effectName, position, scale, color)
     end
 
     -- Call binary module to spawn
-    local instanceID = particles.Spawn(effectName, position, scale, color)
+    local instanceID = particles.Spawn(effectName, position, scale, color, priority)
 
     if GetConVar("particles_debug"):GetBool() then
         print("[ClientParticles] Spawned '" .. effectName .. "' at " .. tostring(position) .. " (ID: " .. instanceID .. ")")
@@ -80,7 +113,7 @@ end
     @param offset Vector - Offset from attachment
     @param scale number - Scale multiplier
     @param color Color - Color tint
-    @return number - Instance ID
+    @return number - Instance ID (the effect follows the entity while it is valid)
 ]]
 function ClientParticles.SpawnAttached(effectName, entity, attachmentID, offset, scale, color)
     if not IsValid(entity) then return -1 end
@@ -90,18 +123,14 @@ function ClientParticles.SpawnAttached(effectName, entity, attachmentID, offset,
     scale = scale or 1.0
     color = color or Color(255, 255, 255, 255)
 
-    -- Get attachment position
-    local attachPos = entity:GetPos()
-    if attachmentID > 0 then
-        local attach = entity:GetAttachment(attachmentID)
-        if attach then
-            attachPos = attach.Pos
-        end
-    end
+    local attachPos = GetAttachmentPosition(entity, attachmentID, offset)
+    local instanceID = ClientParticles.Spawn(effectName, attachPos, scale, color)
 
-    attachPos = attachPos + offset
+    if instanceID > 0 then
+        attachedInstances[instanceID] = { entity = entity, attachmentID = attachmentID, offset = offset }
+    end
 
-    return ClientParticles.Spawn(effectName, attachPos, scale, color)
+    return instanceID
 end
 
 --[[
@@ -109,6 +138,7 @@ end
     @param instanceID number - Instance ID returned from Spawn
 ]]
 function ClientParticles.Kill(instanceID)
+    attachedInstances[instanceID] = nil
     particles.Kill(instanceID)
 end
 
@@ -121,6 +151,26 @@ function ClientParticles.KillInRadius(position, radius)
     particles.KillInRadius(position, radius)
 end
 
+--[[
+    Move a particle effect's emitter
+    @param instanceID number - Instance ID returned from Spawn
+    @param position Vector - New world position
+    @return boolean - False if the instance no longer exists
+]]
+function ClientParticles.SetPosition(instanceID, position)
+    return particles.SetPosition(instanceID, position)
+end
+
+--[[
+    Find particle effects whose emitter is within a radius
+    @param position Vector - Center position
+    @param radius number - Radius
+    @return table - Instance IDs
+]]
+function ClientParticles.FindInRadius(position, radius)
+    return particles.FindInRadius(position, radius)
+end
+
 --[[
     Get list of loaded particle systems
     @return table - Table of loaded system names
@@ -141,6 +191,125 @@ function ClientParticles.GetTotalParticleCount()
     return particles.GetTotalParticleCount()
 end
 
+--[[
+    Set the maximum number of particles alive across all effects
+    @param maxParticles number - Global particle budget
+]]
+function ClientParticles.SetBudget(maxParticles)
+    particles.SetBudget(maxParticles)
+end
+
+--[[
+    Get budget statistics from the last update
+    @return table - {budget, demand, allocated, culled}
+]]
+function ClientParticles.GetBudgetStats()
+    return particles.GetBudgetStats()
+end
+
+--[[
+    Set the distance beyond which whole effects are not rendered
+    @param distance number - Cull distance in world units (0 = no limit)
+]]
+function ClientParticles.SetCullDistance(distance)
+    particles.SetCullDistance(distance)
+end
+
+--[[
+    Set the CPU time allowed for particle simulation each frame
+    @param microseconds number - Frame budget in microseconds (0 = unlimited)
+]]
+function ClientParticles.SetUpdateBudget(microseconds)
+    particles.SetUpdateBudget(microseconds)
+end
+
+--[[
+    Set the number of worker threads that fill particle and vertex data
+    @param count number - Worker threads (0 = render thread only)
+]]
+function ClientParticles.SetWorkerThreads(count)
+    particles.SetWorkerThreads(count)
+end
+
+--[[
+    Simulate the next frame on a separate thread while the current one renders
+    @param enabled boolean - True to render the previous update (one frame of latency)
+]]
+function ClientParticles.SetPipelinedUpdate(enabled)
+    particles.SetPipelinedUpdate(enabled)
+end
+
+--[[
+    Set how close in time spawns of the same effect must be to share one simulation
+    @param seconds number - Share window in seconds (0 = never share)
+]]
+function ClientParticles.SetShareWindow(seconds)
+    particles.SetShareWindow(seconds)
+end
+
+--[[
+    Set the on-screen width below which particles are merged
+    @param pixels number - Smaller particles are drawn this wide with lower alpha, or thinned out (0 = off)
+]]
+function ClientParticles.SetSubPixelThreshold(pixels)
+    particles.SetSubPixelThreshold(pixels)
+end
+
+--[[
+    Set the fraction of particles drawn in reflection views (water, mirrors, RT cameras)
+    @param fraction number - 0 to 1; kept particles grow to cover for the others (0 = none, default 0.5)
+]]
+function ClientParticles.SetReflectionDetail(fraction)
+    particles.SetReflectionDetail(fraction)
+end
+
+--[[
+    Draw unchanged effects (paused, time-sliced or asleep) from their last vertices
+    @param enabled boolean - False to rebuild every particle every view
+    @param maxCameraMove number - Optional camera movement allowed, in units (default 1)
+    @param maxCameraAngle number - Optional camera rotation allowed, in degrees (default 0.25)
+]]
+function ClientParticles.SetVertexReuse(enabled, maxCameraMove, maxCameraAngle)
+    particles.SetVertexReuse(enabled, maxCameraMove, maxCameraAngle)
+end
+
+--[[
+    Draw pooled particles smaller than a few pixels as point sprites, one vertex each
+    @param pixels number - Width below which a particle becomes a point (0 = off, default 3, max 15.9)
+]]
+function ClientParticles.SetPointSpriteSize(pixels)
+    particles.SetPointSpriteSize(pixels)
+end
+
+--[[
+    Draw all effects from one globally sorted particle pool
+    @param enabled boolean - False to issue one draw per effect instance
+]]
+function ClientParticles.SetUseParticlePool(enabled)
+    particles.SetUseParticlePool(enabled)
+end
+
+--[[
+    Get instance statistics from the last update and render
+    @return table - {instances, visible, culled, simulations, sleeping, retired, updated, deferred, updateTime, pipelineWait, workers, drawCalls, stateChanges,
+                     sizeClampedMax, sizeClampedMin, subPixelKept, subPixelCulled,
+                     views, reflectionViews, packetsReused, detailCulled, particlesReused, vertexReuseRate,
+                     quadParticles, pointParticles, pointCulled}
+    Draw calls and particle counts are summed over every view of the last frame
+]]
+function ClientParticles.GetStats()
+    return particles.GetStats()
+end
+
+--[[
+    Get the world-space bounds of an effect's particles after the last update
+    @param instanceID number - Instance ID returned by Spawn
+    @return Vector, Vector - Mins and maxs, or nil if the instance doesn't exist
+]]
+function ClientParticles.GetBounds(instanceID)
+    return particles.GetBounds(instanceID)
+end
+
 --[[
     Get GPU time spent on particle simulation/rendering
     @return number - Time in milliseconds
@@ -201,6 +370,26 @@ end)
 concommand.Add("cl_particle_stats", function()
     print("Particle System Statistics:")
     print("  Total particles: " .. ClientParticles.GetTotalParticleCount())
+
+    local budget = ClientParticles.GetBudgetStats()
+    print("  Budget: " .. budget.allocated .. " / " .. budget.budget .. " (demand " .. budget.demand .. ", culled " .. budget.culled .. ")")
+    local stats = ClientParticles.GetStats()
+    print("  Instances: " .. stats.visible .. " visible / " .. stats.instances .. " (" .. stats.culled .. " culled)")
+    print("  Simulations: " .. stats.simulations .. " (" .. stats.sleeping .. " sleeping)")
+    print("  Retired: " .. stats.retired)
+    print("  Near player: " .. #ClientParticles.FindInRadius(LocalPlayer():GetPos(), 1000))
+    print("  Updated: " .. stats.updated .. " (" .. stats.deferred .. " deferred, " .. stats.updateTime .. " us)")
+    print("  Pipeline wait: " .. stats.pipelineWait .. " us")
+    print("  Worker threads: " .. stats.workers)
+    print("  Draw calls: " .. stats.drawCalls .. " (" .. stats.stateChanges .. " state changes)")
+    print("  Size clamps: " .. stats.sizeClampedMax .. " max, " .. stats.sizeClampedMin .. " min")
+    print("  Sub-pixel: " .. stats.subPixelKept .. " merged, " .. stats.subPixelCulled .. " culled")
+    print("  Views: " .. stats.views .. " (" .. stats.reflectionViews .. " reflection, " ..
+          stats.packetsReused .. " packets reused, " .. stats.detailCulled .. " culled by detail)")
+    print("  Vertex reuse: " .. stats.particlesReused .. " particles (" ..
+          math.Round(stats.vertexReuseRate * 100, 1) .. "%)")
+    print("  Quads/points: " .. stats.quadParticles .. "/" .. stats.pointParticles ..
+          " (" .. stats.pointCulled .. " points thinned)")
     print("  GPU time: " .. ClientParticles.GetGPUTime() .. " ms")
 end)
 
@@ -220,24 +409,90 @@ hook.Add("InitPostEntity", "ParticleSystem_Preload", function()
     end
 end)
 
--- Create console variable
+-- Create console variables
 CreateClientConVar("particles_debug", "0", true, false, "Enable debug output for particle system")
+CreateClientConVar("particles_budget", "20000", true, false, "Maximum number of particles alive across all effects")
+
+if particles and particles.SetBudget then
+    particles.SetBudget(GetConVar("particles_budget"):GetInt())
+end
+
+cvars.AddChangeCallback("particles_budget", function(_, _, newValue)
+    ClientParticles.SetBudget(tonumber(newValue) or 20000)
+end, "ParticleSystem_Budget")
+
+CreateClientConVar("particles_cull_distance", "10000", true, false, "Distance beyond which particle effects are not rendered (0 = no limit)")
+
+if particles and particles.SetCullDistance then
+    particles.SetCullDistance(GetConVar("particles_cull_distance"):GetFloat())
+end
+
+cvars.AddChangeCallback("particles_cull_distance", function(_, _, newValue)
+    ClientParticles.SetCullDistance(tonumber(newValue) or 0)
+end, "ParticleSystem_CullDistance")
+
+CreateClientConVar("particles_update_budget", "2000", true, false, "Microseconds of particle simulation allowed per frame (0 = unlimited)")
+
+if particles and particles.SetUpdateBudget then
+    particles.SetUpdateBudget(GetConVar("particles_update_budget"):GetInt())
+end
+
+cvars.AddChangeCallback("particles_update_budget", function(_, _, newValue)
+    ClientParticles.SetUpdateBudget(tonumber(newValue) or 0)
+end, "ParticleSystem_UpdateBudget")
+
+CreateClientConVar("particles_share_window", "0", true, false, "Seconds within which spawns of the same effect share one simulation (0 = never share)")
+
+if particles and particles.SetShareWindow then
+    particles.SetShareWindow(GetConVar("particles_share_window"):GetFloat())
+end
+
+cvars.AddChangeCallback("particles_share_window", function(_, _, newValue)
+    ClientParticles.SetShareWindow(tonumber(newValue) or 0)
+end, "ParticleSystem_ShareWindow")
+
+CreateClientConVar("particles_pool", "1", true, false, "Draw all particle effects from one globally sorted pool")
+
+if particles and particles.SetUseParticlePool then
+    particles.SetUseParticlePool(GetConVar("particles_pool"):GetBool())
+end
+
+cvars.AddChangeCallback("particles_pool", function(_, _, newValue)
+    ClientParticles.SetUseParticlePool(tobool(newValue))
+end, "ParticleSystem_Pool")
 
 -- Hook into GMod's think and render systems
 hook.Add("Think", "ParticleSystem_Update", function()
     -- Update particles every frame
     -- Delta time is calculated by the C++ module
+    if particles and particles.SetPosition then
+        for instanceID, attached in pairs(attachedInstances) do
+            if not IsValid(attached.entity) or
+               not particles.SetPosition(instanceID, GetAttachmentPosition(attached.entity, attached.attachmentID, attached.offset)) then
+                attachedInstances[instanceID] = nil
+            end
+        end
+    end
+
     if particles and particles.Update then
         particles.Update(FrameTime())
     end
 end)
 
-hook.Add("PostDrawOpaqueRenderables", "ParticleSystem_Render", function()
+hook.Add("PostDrawOpaqueRenderables", "ParticleSystem_Render", function(drawingDepth, drawingSkybox, draw3DSkybox)
     -- Render particles after opaque world geometry but before translucent
     if not particles or not particles.Render then
         return
     end
 
+    -- Effects live in the world, not in the 3D skybox's scaled copy of it
+    if drawingDepth or drawingSkybox or draw3DSkybox then
+        return
+    end
+
+    -- Water reflections, mirrors and RT cameras draw into a render target
+    local reflection = render.GetRenderTarget() ~= nil
+
     -- Get camera view setup
     local view = render.GetViewSetup()
     if not view then
@@ -252,7 +507,7 @@ hook.Add("PostDrawOpaqueRenderables", "ParticleSystem_Render", function()
     -- Call C++ render function
     -- The C++ module will extract origin, angles, fov, and aspect ratio
     local success, err = pcall(function()
-        particles.Render(view)
+        particles.Render(view, reflection)
     end)
 
     if not success and err then
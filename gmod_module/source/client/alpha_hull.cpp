@@ -0,0 +1,213 @@
+#include "alpha_hull.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace GPUParticles {
+
+namespace {
+
+// Texel-edge coordinates: x right, y down, one unit per texel
+struct Point {
+    double x, y;
+};
+
+// Corners may land this far outside the region from rounding alone
+const double kRegionTolerance = 1e-6;
+
+double Cross(const Point& o, const Point& a, const Point& b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Positive when the corners turn counter-clockwise in texel coordinates
+double SignedArea(const std::vector<Point>& polygon) {
+    double twiceArea = 0.0;
+    for (size_t i = 0, n = polygon.size(); i < n; ++i) {
+        const Point& a = polygon[i];
+        const Point& b = polygon[(i + 1) % n];
+        twiceArea += a.x * b.y - b.x * a.y;
+    }
+    return twiceArea * 0.5;
+}
+
+double PolygonArea(const std::vector<Point>& polygon) {
+    return std::fabs(SignedArea(polygon));
+}
+
+// Andrew's monotone chain. Collinear points are dropped, so every corner
+// of the result is a real turn.
+std::vector<Point> ConvexHull(std::vector<Point> points) {
+    std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+
+    std::vector<Point> hull(2 * points.size());
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (k >= 2 && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0) {
+            k--;
+        }
+        hull[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && Cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0) {
+            k--;
+        }
+        hull[k++] = points[i];
+    }
+
+    hull.resize(k > 1 ? k - 1 : k);  // Last point repeats the first
+    return hull;
+}
+
+// Corner that replaces edge (i, i+1) when its two neighbouring edges are
+// extended until they meet. Fails when they never meet beyond the edge or
+// meet outside the region.
+bool RemoveEdgeCorner(const std::vector<Point>& polygon, size_t i, double width, double height,
+                      Point& corner, double& addedArea) {
+    const size_t n = polygon.size();
+    const Point& before = polygon[(i + n - 1) % n];
+    const Point& a = polygon[i];
+    const Point& b = polygon[(i + 1) % n];
+    const Point& after = polygon[(i + 2) % n];
+
+    const Point d1 = { a.x - before.x, a.y - before.y };
+    const Point d2 = { after.x - b.x, after.y - b.y };
+    const Point ab = { b.x - a.x, b.y - a.y };
+
+    // The hull turns one way throughout; the neighbours only converge
+    // beyond the edge when they turn that way too
+    const double denom = d1.x * d2.y - d1.y * d2.x;
+    if (denom <= 1e-12) {
+        return false;
+    }
+
+    const double t = (ab.x * d2.y - ab.y * d2.x) / denom;
+    const double s = (ab.x * d1.y - ab.y * d1.x) / denom;
+    if (t < 0.0 || s > 0.0) {
+        return false;
+    }
+
+    corner = { a.x + d1.x * t, a.y + d1.y * t };
+    if (corner.x < -kRegionTolerance || corner.x > width + kRegionTolerance ||
+        corner.y < -kRegionTolerance || corner.y > height + kRegionTolerance) {
+        return false;
+    }
+
+    addedArea = std::fabs(Cross(a, corner, b)) * 0.5;
+    return true;
+}
+
+} // namespace
+
+AlphaHull AlphaHull::FullQuad() {
+    // Same corner order as the billboard quad: bottom-left first
+    AlphaHull hull;
+    hull.vertexCount = 4;
+    const float u[4] = { 0.0f, 1.0f, 1.0f, 0.0f };
+    const float v[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+    for (int i = 0; i < 4; ++i) {
+        hull.u[i] = u[i];
+        hull.v[i] = v[i];
+    }
+    hull.area = 1.0f;
+    return hull;
+}
+
+AlphaHull AlphaHull::Compute(const uint8_t* alpha,
+                             int width,
+                             int height,
+                             int texelStride,
+                             int rowStride,
+                             int maxVertices,
+                             uint8_t threshold) {
+    maxVertices = std::max(4, std::min(kMaxVertices, maxVertices));
+
+    // The hull of all visible texel squares is the hull of the first and
+    // last visible texel of every row
+    std::vector<Point> points;
+    double minX = width, minY = height, maxX = 0.0, maxY = 0.0;
+
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* row = alpha + static_cast<size_t>(y) * rowStride;
+        int first = -1;
+        int last = -1;
+        for (int x = 0; x < width; ++x) {
+            if (row[static_cast<size_t>(x) * texelStride] > threshold) {
+                if (first < 0) {
+                    first = x;
+                }
+                last = x;
+            }
+        }
+        if (first < 0) {
+            continue;
+        }
+
+        points.push_back({ double(first), double(y) });
+        points.push_back({ double(first), double(y + 1) });
+        points.push_back({ double(last + 1), double(y) });
+        points.push_back({ double(last + 1), double(y + 1) });
+
+        minX = std::min(minX, double(first));
+        maxX = std::max(maxX, double(last + 1));
+        minY = std::min(minY, double(y));
+        maxY = std::max(maxY, double(y + 1));
+    }
+
+    // Nothing visible: nothing to trim against
+    if (points.empty()) {
+        return FullQuad();
+    }
+
+    std::vector<Point> polygon = ConvexHull(points);
+
+    // Greedy reduction: drop the edge whose removal adds the least area
+    while (static_cast<int>(polygon.size()) > maxVertices) {
+        size_t bestEdge = 0;
+        Point bestCorner = { 0.0, 0.0 };
+        double bestArea = -1.0;
+
+        for (size_t i = 0; i < polygon.size(); ++i) {
+            Point corner;
+            double addedArea;
+            if (RemoveEdgeCorner(polygon, i, width, height, corner, addedArea) &&
+                (bestArea < 0.0 || addedArea < bestArea)) {
+                bestEdge = i;
+                bestCorner = corner;
+                bestArea = addedArea;
+            }
+        }
+
+        if (bestArea < 0.0) {
+            break;  // Every removal would leave the region
+        }
+
+        // Corners bestEdge and bestEdge + 1 become one
+        const size_t next = (bestEdge + 1) % polygon.size();
+        polygon[bestEdge] = bestCorner;
+        polygon.erase(polygon.begin() + next);
+    }
+
+    const std::vector<Point> rectangle = { { minX, maxY }, { maxX, maxY }, { maxX, minY }, { minX, minY } };
+    if (static_cast<int>(polygon.size()) > maxVertices || PolygonArea(rectangle) <= PolygonArea(polygon)) {
+        polygon = rectangle;
+    }
+
+    // Same winding as the full quad, so trimmed and untrimmed particles
+    // face the same way
+    if (SignedArea(polygon) > 0.0) {
+        std::reverse(polygon.begin(), polygon.end());
+    }
+
+    AlphaHull hull;
+    hull.vertexCount = static_cast<int>(polygon.size());
+    for (int i = 0; i < hull.vertexCount; ++i) {
+        hull.u[i] = static_cast<float>(std::max(0.0, std::min(1.0, polygon[i].x / width)));
+        hull.v[i] = static_cast<float>(std::max(0.0, std::min(1.0, polygon[i].y / height)));
+    }
+    hull.area = static_cast<float>(PolygonArea(polygon) / (static_cast<double>(width) * height));
+    return hull;
+}
+
+} // namespace GPUParticles
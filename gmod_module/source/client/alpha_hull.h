@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace GPUParticles {
+
+/**
+ * @brief Convex polygon around the visible texels of a texture region
+ *
+ * Particles drawn with this outline instead of the full quad skip the
+ * rasterization of fully transparent texels. Computed from the alpha
+ * channel only and free of any graphics API, so the renderer can use it
+ * at load time and the gparthull tool can use it offline.
+ */
+struct AlphaHull {
+    static constexpr int kMaxVertices = 8;
+
+    int vertexCount;
+    float u[kMaxVertices];  // Texture coordinates within the region (0-1, v down),
+    float v[kMaxVertices];  // in order around the polygon
+    float area;             // Fraction of the region covered (1 = full quad)
+
+    AlphaHull() : vertexCount(0), u(), v(), area(0.0f) {}
+
+    /**
+     * @brief The untrimmed region
+     */
+    static AlphaHull FullQuad();
+
+    /**
+     * @brief Smallest polygon found that contains every texel with alpha above a threshold
+     *
+     * The exact convex hull of the texels is reduced by repeatedly removing
+     * the edge that adds the least area, while every corner stays inside
+     * the region; the bounding rectangle is used when it is smaller. A
+     * region without visible texels gives the full quad.
+     *
+     * @param alpha First alpha value of the region
+     * @param width Region width in texels
+     * @param height Region height in texels
+     * @param texelStride Bytes between horizontally adjacent alpha values (1 for A8, 4 for BGRA)
+     * @param rowStride Bytes between rows
+     * @param maxVertices Corner limit, 4 to kMaxVertices
+     * @param threshold Texels with alpha at or below this are treated as empty
+     */
+    static AlphaHull Compute(const uint8_t* alpha,
+                             int width,
+                             int height,
+                             int texelStride,
+                             int rowStride,
+                             int maxVertices,
+                             uint8_t threshold = 0);
+};
+
+} // namespace GPUParticles
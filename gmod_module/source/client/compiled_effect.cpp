@@ -0,0 +1,700 @@
+#include "compiled_effect.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace GPUParticles {
+
+constexpr char CompiledEffect::kMagic[4];
+
+namespace {
+
+// Record size of each optional module, by bit index
+const size_t kModuleRecordSizes[kCompiledModuleCount] = {
+    sizeof(CompiledEmissionModule),
+    sizeof(CompiledShapeModule),
+    sizeof(CompiledVelocityModule),
+    sizeof(CompiledLimitVelocityModule),
+    sizeof(CompiledForceModule),
+    sizeof(CompiledColorModule),
+    sizeof(CompiledSizeModule),
+    sizeof(CompiledRotationModule),
+    sizeof(CompiledNoiseModule),
+    sizeof(CompiledCollisionModule),
+    sizeof(CompiledTextureSheetModule),
+};
+
+uint32_t Flag(bool value) {
+    return value ? 1u : 0u;
+}
+
+// Collects the tables while the records are written
+class CompiledEffectWriter {
+public:
+    CompiledEffectWriter() : m_strings(1, '\0') {}  // Offset 0 is the empty string
+
+    template <typename Record>
+    void AddRecord(const Record& record) {
+        static_assert(sizeof(Record) % 4 == 0, "Records keep the tables 4-byte aligned");
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+        m_modules.insert(m_modules.end(), bytes, bytes + sizeof(Record));
+    }
+
+    CompiledRange AddKeys(const AnimationCurve& curve) {
+        CompiledRange range = { static_cast<uint32_t>(m_keyframes.size()), static_cast<uint32_t>(curve.keys.size()) };
+        m_keyframes.insert(m_keyframes.end(), curve.keys.begin(), curve.keys.end());
+        return range;
+    }
+
+    CompiledCurve AddCurve(const MinMaxCurve& curve) {
+        CompiledCurve out;
+        out.mode = static_cast<uint32_t>(curve.mode);
+        out.constant = curve.constant;
+        out.constantMin = curve.constantMin;
+        out.constantMax = curve.constantMax;
+        out.multiplier = curve.multiplier;
+        out.curve = AddKeys(curve.curve);
+        out.curveMin = AddKeys(curve.curveMin);
+        out.curveMax = AddKeys(curve.curveMax);
+        return out;
+    }
+
+    CompiledGradient AddGradient(const Gradient& gradient) {
+        CompiledGradient out;
+        out.colorKeys = { static_cast<uint32_t>(m_colorKeys.size()), static_cast<uint32_t>(gradient.colorKeys.size()) };
+        out.alphaKeys = { static_cast<uint32_t>(m_alphaKeys.size()), static_cast<uint32_t>(gradient.alphaKeys.size()) };
+        m_colorKeys.insert(m_colorKeys.end(), gradient.colorKeys.begin(), gradient.colorKeys.end());
+        m_alphaKeys.insert(m_alphaKeys.end(), gradient.alphaKeys.begin(), gradient.alphaKeys.end());
+        return out;
+    }
+
+    CompiledRange AddBursts(const std::vector<Burst>& bursts) {
+        CompiledRange range = { static_cast<uint32_t>(m_bursts.size()), static_cast<uint32_t>(bursts.size()) };
+        m_bursts.insert(m_bursts.end(), bursts.begin(), bursts.end());
+        return range;
+    }
+
+    void AddSubEmitter(const SubEmitter& subEmitter) {
+        m_subEmitters.push_back({ static_cast<uint32_t>(subEmitter.type), AddString(subEmitter.subEmitterName) });
+    }
+
+    // Repeated strings (material and texture often match) are stored once
+    uint32_t AddString(const std::string& value) {
+        if (value.empty()) {
+            return 0;
+        }
+        auto known = m_stringOffsets.find(value);
+        if (known != m_stringOffsets.end()) {
+            return known->second;
+        }
+
+        const uint32_t offset = static_cast<uint32_t>(m_strings.size());
+        m_strings.insert(m_strings.end(), value.begin(), value.end());
+        m_strings.push_back('\0');
+        m_stringOffsets[value] = offset;
+        return offset;
+    }
+
+    std::vector<uint8_t> Finish(CompiledEffectHeader header) {
+        std::vector<uint8_t> file(sizeof(CompiledEffectHeader));
+
+        auto append = [&file](const void* data, size_t bytes, uint32_t count) {
+            while (file.size() % 4 != 0) {
+                file.push_back(0);
+            }
+            CompiledSection section = { static_cast<uint32_t>(file.size()), count };
+            const uint8_t* begin = static_cast<const uint8_t*>(data);
+            file.insert(file.end(), begin, begin + bytes);
+            return section;
+        };
+        auto appendTable = [&append](const auto& table) {
+            return append(table.data(), table.size() * sizeof(table[0]), static_cast<uint32_t>(table.size()));
+        };
+
+        header.modules = appendTable(m_modules);
+        header.keyframes = appendTable(m_keyframes);
+        header.colorKeys = appendTable(m_colorKeys);
+        header.alphaKeys = appendTable(m_alphaKeys);
+        header.bursts = appendTable(m_bursts);
+        header.subEmitters = appendTable(m_subEmitters);
+        header.strings = appendTable(m_strings);
+        while (file.size() % 4 != 0) {
+            file.push_back(0);
+        }
+
+        header.fileSize = static_cast<uint32_t>(file.size());
+        std::memcpy(file.data(), &header, sizeof(header));
+        return file;
+    }
+
+private:
+    std::vector<uint8_t> m_modules;
+    std::vector<Keyframe> m_keyframes;
+    std::vector<GradientColorKey> m_colorKeys;
+    std::vector<GradientAlphaKey> m_alphaKeys;
+    std::vector<Burst> m_bursts;
+    std::vector<CompiledSubEmitter> m_subEmitters;
+    std::vector<char> m_strings;
+    std::unordered_map<std::string, uint32_t> m_stringOffsets;
+};
+
+} // namespace
+
+// ============================================================================
+// CompiledEffect
+// ============================================================================
+
+bool CompiledEffect::IsCompiled(const void* data, size_t size) {
+    return size >= sizeof(kMagic) && std::memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+std::vector<uint8_t> CompiledEffect::Compile(const ParticleSystemData& data) {
+    CompiledEffectWriter writer;
+
+    CompiledEffectHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.name = writer.AddString(data.name);
+    header.dataVersion = writer.AddString(data.version);
+
+    const MainModule& main = data.main;
+    CompiledMainModule mainRecord;
+    mainRecord.duration = main.duration;
+    mainRecord.looping = Flag(main.looping);
+    mainRecord.prewarm = Flag(main.prewarm);
+    mainRecord.startDelay = writer.AddCurve(main.startDelay);
+    mainRecord.startLifetime = writer.AddCurve(main.startLifetime);
+    mainRecord.startSpeed = writer.AddCurve(main.startSpeed);
+    mainRecord.startSize = writer.AddCurve(main.startSize);
+    mainRecord.startSize3D = Flag(main.startSize3D);
+    mainRecord.startSizeX = writer.AddCurve(main.startSizeX);
+    mainRecord.startSizeY = writer.AddCurve(main.startSizeY);
+    mainRecord.startSizeZ = writer.AddCurve(main.startSizeZ);
+    mainRecord.startRotation = writer.AddCurve(main.startRotation);
+    mainRecord.startRotation3D = Flag(main.startRotation3D);
+    mainRecord.startRotationX = writer.AddCurve(main.startRotationX);
+    mainRecord.startRotationY = writer.AddCurve(main.startRotationY);
+    mainRecord.startRotationZ = writer.AddCurve(main.startRotationZ);
+    mainRecord.startColor = main.startColor;
+    mainRecord.gravityModifier = writer.AddCurve(main.gravityModifier);
+    mainRecord.simulationSpace = static_cast<uint32_t>(main.simulationSpace);
+    mainRecord.simulationSpeed = main.simulationSpeed;
+    mainRecord.playOnAwake = Flag(main.playOnAwake);
+    mainRecord.maxParticles = main.maxParticles;
+    writer.AddRecord(mainRecord);
+
+    const RendererModule& renderer = data.renderer;
+    CompiledRendererModule rendererRecord;
+    rendererRecord.renderMode = static_cast<uint32_t>(renderer.renderMode);
+    rendererRecord.sortMode = static_cast<uint32_t>(renderer.sortMode);
+    rendererRecord.minParticleSize = renderer.minParticleSize;
+    rendererRecord.maxParticleSize = renderer.maxParticleSize;
+    rendererRecord.material = writer.AddString(renderer.material);
+    rendererRecord.texture = writer.AddString(renderer.texture);
+    rendererRecord.pivot = renderer.pivot;
+    rendererRecord.flip = Flag(renderer.flip);
+    rendererRecord.velocityScale = renderer.velocityScale;
+    rendererRecord.lengthScale = renderer.lengthScale;
+    rendererRecord.normalDirection = renderer.normalDirection;
+    rendererRecord.sortingOrder = renderer.sortingOrder;
+    rendererRecord.hullVertices = renderer.hullVertices;
+    writer.AddRecord(rendererRecord);
+
+    // Optional modules in bit order; the simulator ignores disabled ones,
+    // so they are left out
+    if (data.emission.enabled) {
+        header.moduleMask |= kCompiledEmission;
+        CompiledEmissionModule record;
+        record.rateOverTime = writer.AddCurve(data.emission.rateOverTime);
+        record.rateOverDistance = writer.AddCurve(data.emission.rateOverDistance);
+        record.bursts = writer.AddBursts(data.emission.bursts);
+        writer.AddRecord(record);
+    }
+
+    if (data.shape.enabled) {
+        const ShapeModule& shape = data.shape;
+        header.moduleMask |= kCompiledShape;
+        CompiledShapeModule record;
+        record.shapeType = static_cast<uint32_t>(shape.shapeType);
+        record.angle = shape.angle;
+        record.radius = shape.radius;
+        record.radiusThickness = shape.radiusThickness;
+        record.arc = shape.arc;
+        record.boxScale = shape.boxScale;
+        record.position = shape.position;
+        record.rotation = shape.rotation;
+        record.scale = shape.scale;
+        record.alignToDirection = Flag(shape.alignToDirection);
+        record.randomDirectionAmount = shape.randomDirectionAmount;
+        record.sphericalDirectionAmount = shape.sphericalDirectionAmount;
+        record.arcMode = static_cast<uint32_t>(shape.arcMode);
+        writer.AddRecord(record);
+    }
+
+    if (data.velocityOverLifetime.enabled) {
+        const VelocityOverLifetimeModule& velocity = data.velocityOverLifetime;
+        header.moduleMask |= kCompiledVelocityOverLifetime;
+        CompiledVelocityModule record;
+        record.x = writer.AddCurve(velocity.x);
+        record.y = writer.AddCurve(velocity.y);
+        record.z = writer.AddCurve(velocity.z);
+        record.space = static_cast<uint32_t>(velocity.space);
+        writer.AddRecord(record);
+    }
+
+    if (data.limitVelocityOverLifetime.enabled) {
+        const LimitVelocityOverLifetimeModule& limit = data.limitVelocityOverLifetime;
+        header.moduleMask |= kCompiledLimitVelocity;
+        CompiledLimitVelocityModule record;
+        record.limit = writer.AddCurve(limit.limit);
+        record.dampen = limit.dampen;
+        record.separateAxes = Flag(limit.separateAxes);
+        record.limitX = writer.AddCurve(limit.limitX);
+        record.limitY = writer.AddCurve(limit.limitY);
+        record.limitZ = writer.AddCurve(limit.limitZ);
+        writer.AddRecord(record);
+    }
+
+    if (data.forceOverLifetime.enabled) {
+        const ForceOverLifetimeModule& force = data.forceOverLifetime;
+        header.moduleMask |= kCompiledForceOverLifetime;
+        CompiledForceModule record;
+        record.x = writer.AddCurve(force.x);
+        record.y = writer.AddCurve(force.y);
+        record.z = writer.AddCurve(force.z);
+        record.space = static_cast<uint32_t>(force.space);
+        record.randomized = Flag(force.randomized);
+        writer.AddRecord(record);
+    }
+
+    if (data.colorOverLifetime.enabled) {
+        header.moduleMask |= kCompiledColorOverLifetime;
+        CompiledColorModule record;
+        record.gradient = writer.AddGradient(data.colorOverLifetime.gradient);
+        writer.AddRecord(record);
+    }
+
+    if (data.sizeOverLifetime.enabled) {
+        const SizeOverLifetimeModule& size = data.sizeOverLifetime;
+        header.moduleMask |= kCompiledSizeOverLifetime;
+        CompiledSizeModule record;
+        record.size = writer.AddCurve(size.size);
+        record.separateAxes = Flag(size.separateAxes);
+        record.x = writer.AddCurve(size.x);
+        record.y = writer.AddCurve(size.y);
+        record.z = writer.AddCurve(size.z);
+        writer.AddRecord(record);
+    }
+
+    if (data.rotationOverLifetime.enabled) {
+        const RotationOverLifetimeModule& rotation = data.rotationOverLifetime;
+        header.moduleMask |= kCompiledRotationOverLifetime;
+        CompiledRotationModule record;
+        record.x = writer.AddCurve(rotation.x);
+        record.y = writer.AddCurve(rotation.y);
+        record.z = writer.AddCurve(rotation.z);
+        record.separateAxes = Flag(rotation.separateAxes);
+        writer.AddRecord(record);
+    }
+
+    if (data.noise.enabled) {
+        const NoiseModule& noise = data.noise;
+        header.moduleMask |= kCompiledNoise;
+        CompiledNoiseModule record;
+        record.strength = writer.AddCurve(noise.strength);
+        record.frequency = noise.frequency;
+        record.scrollSpeed = noise.scrollSpeed;
+        record.damping = Flag(noise.damping);
+        record.octaves = noise.octaves;
+        record.octaveMultiplier = noise.octaveMultiplier;
+        record.octaveScale = noise.octaveScale;
+        record.quality = noise.quality;
+        record.separateAxes = Flag(noise.separateAxes);
+        record.strengthX = writer.AddCurve(noise.strengthX);
+        record.strengthY = writer.AddCurve(noise.strengthY);
+        record.strengthZ = writer.AddCurve(noise.strengthZ);
+        writer.AddRecord(record);
+    }
+
+    if (data.collision.enabled) {
+        const CollisionModule& collision = data.collision;
+        header.moduleMask |= kCompiledCollision;
+        CompiledCollisionModule record;
+        record.type = static_cast<uint32_t>(collision.type);
+        record.mode = static_cast<uint32_t>(collision.mode);
+        record.dampen = writer.AddCurve(collision.dampen);
+        record.bounce = writer.AddCurve(collision.bounce);
+        record.lifetimeLoss = writer.AddCurve(collision.lifetimeLoss);
+        record.minKillSpeed = collision.minKillSpeed;
+        record.maxKillSpeed = collision.maxKillSpeed;
+        record.radiusScale = collision.radiusScale;
+        record.collidesWithDynamic = Flag(collision.collidesWithDynamic);
+        record.maxCollisionShapes = collision.maxCollisionShapes;
+        writer.AddRecord(record);
+    }
+
+    if (data.textureSheetAnimation.enabled) {
+        const TextureSheetAnimationModule& sheet = data.textureSheetAnimation;
+        header.moduleMask |= kCompiledTextureSheet;
+        CompiledTextureSheetModule record;
+        record.numTilesX = sheet.numTilesX;
+        record.numTilesY = sheet.numTilesY;
+        record.animationType = static_cast<uint32_t>(sheet.animationType);
+        record.mode = static_cast<uint32_t>(sheet.mode);
+        record.frameOverTime = writer.AddCurve(sheet.frameOverTime);
+        record.startFrame = writer.AddCurve(sheet.startFrame);
+        record.cycleCount = sheet.cycleCount;
+        record.rowIndex = sheet.rowIndex;
+        writer.AddRecord(record);
+    }
+
+    for (const SubEmitter& subEmitter : data.subEmitters) {
+        writer.AddSubEmitter(subEmitter);
+    }
+
+    return writer.Finish(header);
+}
+
+// ============================================================================
+// CompiledEffectView
+// ============================================================================
+
+CompiledEffectView::CompiledEffectView()
+    : m_data(nullptr)
+    , m_header(nullptr)
+    , m_main(nullptr)
+    , m_renderer(nullptr)
+    , m_modules()
+    , m_keyframes(nullptr)
+    , m_colorKeys(nullptr)
+    , m_alphaKeys(nullptr)
+    , m_bursts(nullptr)
+    , m_subEmitters(nullptr)
+    , m_strings(nullptr)
+{
+}
+
+uint32_t CompiledEffectView::BitIndex(CompiledModuleBit bit) {
+    uint32_t index = 0;
+    while (index < kCompiledModuleCount && (1u << index) != bit) {
+        index++;
+    }
+    return index;
+}
+
+bool CompiledEffectView::Open(const void* data, size_t size, std::string& error) {
+    m_data = nullptr;
+
+    if (!CompiledEffect::IsCompiled(data, size) || size < sizeof(CompiledEffectHeader)) {
+        error = "not a compiled effect";
+        return false;
+    }
+    if (reinterpret_cast<uintptr_t>(data) % 4 != 0) {
+        error = "compiled effect buffer is not 4-byte aligned";
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const CompiledEffectHeader* header = reinterpret_cast<const CompiledEffectHeader*>(bytes);
+    if (header->version != CompiledEffect::kVersion) {
+        error = "compiled effect version " + std::to_string(header->version) + ", expected " +
+                std::to_string(CompiledEffect::kVersion) + " (rebuild it with gpartc)";
+        return false;
+    }
+    if (header->fileSize > size) {
+        error = "truncated compiled effect";
+        return false;
+    }
+    if (header->moduleMask >> kCompiledModuleCount) {
+        error = "unknown modules in compiled effect";
+        return false;
+    }
+
+    // Every table must lie inside the file before anything points into it
+    auto inFile = [header](const CompiledSection& section, size_t elementSize) {
+        return section.offset % 4 == 0 &&
+               static_cast<uint64_t>(section.offset) + static_cast<uint64_t>(section.count) * elementSize <=
+                   header->fileSize;
+    };
+    if (!inFile(header->modules, 1) || !inFile(header->keyframes, sizeof(Keyframe)) ||
+        !inFile(header->colorKeys, sizeof(GradientColorKey)) || !inFile(header->alphaKeys, sizeof(GradientAlphaKey)) ||
+        !inFile(header->bursts, sizeof(Burst)) || !inFile(header->subEmitters, sizeof(CompiledSubEmitter)) ||
+        !inFile(header->strings, 1)) {
+        error = "compiled effect table out of bounds";
+        return false;
+    }
+
+    size_t moduleBytes = sizeof(CompiledMainModule) + sizeof(CompiledRendererModule);
+    for (uint32_t i = 0; i < kCompiledModuleCount; ++i) {
+        if (header->moduleMask & (1u << i)) {
+            moduleBytes += kModuleRecordSizes[i];
+        }
+    }
+    if (header->modules.count != moduleBytes) {
+        error = "compiled effect module records do not match the module mask";
+        return false;
+    }
+
+    if (header->strings.count == 0 || bytes[header->strings.offset + header->strings.count - 1] != '\0') {
+        error = "compiled effect string table is not terminated";
+        return false;
+    }
+
+    // Fix-ups: point every record and table into the buffer
+    const uint8_t* record = bytes + header->modules.offset;
+    m_main = reinterpret_cast<const CompiledMainModule*>(record);
+    record += sizeof(CompiledMainModule);
+    m_renderer = reinterpret_cast<const CompiledRendererModule*>(record);
+    record += sizeof(CompiledRendererModule);
+    for (uint32_t i = 0; i < kCompiledModuleCount; ++i) {
+        m_modules[i] = nullptr;
+        if (header->moduleMask & (1u << i)) {
+            m_modules[i] = record;
+            record += kModuleRecordSizes[i];
+        }
+    }
+
+    m_keyframes = reinterpret_cast<const Keyframe*>(bytes + header->keyframes.offset);
+    m_colorKeys = reinterpret_cast<const GradientColorKey*>(bytes + header->colorKeys.offset);
+    m_alphaKeys = reinterpret_cast<const GradientAlphaKey*>(bytes + header->alphaKeys.offset);
+    m_bursts = reinterpret_cast<const Burst*>(bytes + header->bursts.offset);
+    m_subEmitters = reinterpret_cast<const CompiledSubEmitter*>(bytes + header->subEmitters.offset);
+    m_strings = reinterpret_cast<const char*>(bytes + header->strings.offset);
+
+    m_header = header;
+    m_data = bytes;
+    return true;
+}
+
+const char* CompiledEffectView::GetString(uint32_t offset) const {
+    return (offset < m_header->strings.count) ? m_strings + offset : "";
+}
+
+bool CompiledEffectView::ReadKeys(const CompiledRange& range, AnimationCurve& out) const {
+    if (static_cast<uint64_t>(range.first) + range.count > m_header->keyframes.count) {
+        return false;
+    }
+    out.keys.assign(m_keyframes + range.first, m_keyframes + range.first + range.count);
+    return true;
+}
+
+bool CompiledEffectView::ReadCurve(const CompiledCurve& in, MinMaxCurve& out) const {
+    out.mode = static_cast<CurveMode>(in.mode);
+    out.constant = in.constant;
+    out.constantMin = in.constantMin;
+    out.constantMax = in.constantMax;
+    out.multiplier = in.multiplier;
+    return ReadKeys(in.curve, out.curve) && ReadKeys(in.curveMin, out.curveMin) && ReadKeys(in.curveMax, out.curveMax);
+}
+
+bool CompiledEffectView::ReadGradient(const CompiledGradient& in, Gradient& out) const {
+    const CompiledRange& colors = in.colorKeys;
+    const CompiledRange& alphas = in.alphaKeys;
+    if (static_cast<uint64_t>(colors.first) + colors.count > m_header->colorKeys.count ||
+        static_cast<uint64_t>(alphas.first) + alphas.count > m_header->alphaKeys.count) {
+        return false;
+    }
+    out.colorKeys.assign(m_colorKeys + colors.first, m_colorKeys + colors.first + colors.count);
+    out.alphaKeys.assign(m_alphaKeys + alphas.first, m_alphaKeys + alphas.first + alphas.count);
+    return true;
+}
+
+std::unique_ptr<ParticleSystemData> CompiledEffectView::ToSystemData(std::string& error) const {
+    if (!m_data) {
+        error = "compiled effect is not open";
+        return nullptr;
+    }
+
+    auto data = std::make_unique<ParticleSystemData>();
+    bool ok = true;
+
+    data->name = GetString(m_header->name);
+    data->version = GetString(m_header->dataVersion);
+
+    const CompiledMainModule& mainRecord = *m_main;
+    MainModule& main = data->main;
+    main.duration = mainRecord.duration;
+    main.looping = mainRecord.looping != 0;
+    main.prewarm = mainRecord.prewarm != 0;
+    ok = ok && ReadCurve(mainRecord.startDelay, main.startDelay);
+    ok = ok && ReadCurve(mainRecord.startLifetime, main.startLifetime);
+    ok = ok && ReadCurve(mainRecord.startSpeed, main.startSpeed);
+    ok = ok && ReadCurve(mainRecord.startSize, main.startSize);
+    main.startSize3D = mainRecord.startSize3D != 0;
+    ok = ok && ReadCurve(mainRecord.startSizeX, main.startSizeX);
+    ok = ok && ReadCurve(mainRecord.startSizeY, main.startSizeY);
+    ok = ok && ReadCurve(mainRecord.startSizeZ, main.startSizeZ);
+    ok = ok && ReadCurve(mainRecord.startRotation, main.startRotation);
+    main.startRotation3D = mainRecord.startRotation3D != 0;
+    ok = ok && ReadCurve(mainRecord.startRotationX, main.startRotationX);
+    ok = ok && ReadCurve(mainRecord.startRotationY, main.startRotationY);
+    ok = ok && ReadCurve(mainRecord.startRotationZ, main.startRotationZ);
+    main.startColor = mainRecord.startColor;
+    ok = ok && ReadCurve(mainRecord.gravityModifier, main.gravityModifier);
+    main.simulationSpace = static_cast<ParticleSystemSimulationSpace>(mainRecord.simulationSpace);
+    main.simulationSpeed = mainRecord.simulationSpeed;
+    main.playOnAwake = mainRecord.playOnAwake != 0;
+    main.maxParticles = mainRecord.maxParticles;
+
+    const CompiledRendererModule& rendererRecord = *m_renderer;
+    RendererModule& renderer = data->renderer;
+    renderer.renderMode = static_cast<ParticleSystemRenderMode>(rendererRecord.renderMode);
+    renderer.sortMode = static_cast<ParticleSystemSortMode>(rendererRecord.sortMode);
+    renderer.minParticleSize = rendererRecord.minParticleSize;
+    renderer.maxParticleSize = rendererRecord.maxParticleSize;
+    renderer.material = GetString(rendererRecord.material);
+    renderer.texture = GetString(rendererRecord.texture);
+    renderer.pivot = rendererRecord.pivot;
+    renderer.flip = rendererRecord.flip != 0;
+    renderer.velocityScale = rendererRecord.velocityScale;
+    renderer.lengthScale = rendererRecord.lengthScale;
+    renderer.normalDirection = rendererRecord.normalDirection;
+    renderer.sortingOrder = rendererRecord.sortingOrder;
+    renderer.hullVertices = rendererRecord.hullVertices;
+
+    // Modules without a record keep their defaults, disabled
+    EmissionModule& emission = data->emission;
+    emission.enabled = false;
+    if (const auto* record = GetModule<CompiledEmissionModule>(kCompiledEmission)) {
+        emission.enabled = true;
+        ok = ok && ReadCurve(record->rateOverTime, emission.rateOverTime);
+        ok = ok && ReadCurve(record->rateOverDistance, emission.rateOverDistance);
+        if (static_cast<uint64_t>(record->bursts.first) + record->bursts.count > m_header->bursts.count) {
+            ok = false;
+        } else {
+            emission.bursts.assign(m_bursts + record->bursts.first, m_bursts + record->bursts.first + record->bursts.count);
+        }
+    }
+
+    ShapeModule& shape = data->shape;
+    shape.enabled = false;
+    if (const auto* record = GetModule<CompiledShapeModule>(kCompiledShape)) {
+        shape.enabled = true;
+        shape.shapeType = static_cast<ParticleSystemShapeType>(record->shapeType);
+        shape.angle = record->angle;
+        shape.radius = record->radius;
+        shape.radiusThickness = record->radiusThickness;
+        shape.arc = record->arc;
+        shape.boxScale = record->boxScale;
+        shape.position = record->position;
+        shape.rotation = record->rotation;
+        shape.scale = record->scale;
+        shape.alignToDirection = record->alignToDirection != 0;
+        shape.randomDirectionAmount = record->randomDirectionAmount;
+        shape.sphericalDirectionAmount = record->sphericalDirectionAmount;
+        shape.arcMode = static_cast<ParticleSystemShapeMultiModeValue>(record->arcMode);
+    }
+
+    if (const auto* record = GetModule<CompiledVelocityModule>(kCompiledVelocityOverLifetime)) {
+        VelocityOverLifetimeModule& velocity = data->velocityOverLifetime;
+        velocity.enabled = true;
+        ok = ok && ReadCurve(record->x, velocity.x);
+        ok = ok && ReadCurve(record->y, velocity.y);
+        ok = ok && ReadCurve(record->z, velocity.z);
+        velocity.space = static_cast<ParticleSystemSimulationSpace>(record->space);
+    }
+
+    if (const auto* record = GetModule<CompiledLimitVelocityModule>(kCompiledLimitVelocity)) {
+        LimitVelocityOverLifetimeModule& limit = data->limitVelocityOverLifetime;
+        limit.enabled = true;
+        ok = ok && ReadCurve(record->limit, limit.limit);
+        limit.dampen = record->dampen;
+        limit.separateAxes = record->separateAxes != 0;
+        ok = ok && ReadCurve(record->limitX, limit.limitX);
+        ok = ok && ReadCurve(record->limitY, limit.limitY);
+        ok = ok && ReadCurve(record->limitZ, limit.limitZ);
+    }
+
+    if (const auto* record = GetModule<CompiledForceModule>(kCompiledForceOverLifetime)) {
+        ForceOverLifetimeModule& force = data->forceOverLifetime;
+        force.enabled = true;
+        ok = ok && ReadCurve(record->x, force.x);
+        ok = ok && ReadCurve(record->y, force.y);
+        ok = ok && ReadCurve(record->z, force.z);
+        force.space = static_cast<ParticleSystemSimulationSpace>(record->space);
+        force.randomized = record->randomized != 0;
+    }
+
+    if (const auto* record = GetModule<CompiledColorModule>(kCompiledColorOverLifetime)) {
+        data->colorOverLifetime.enabled = true;
+        ok = ok && ReadGradient(record->gradient, data->colorOverLifetime.gradient);
+    }
+
+    if (const auto* record = GetModule<CompiledSizeModule>(kCompiledSizeOverLifetime)) {
+        SizeOverLifetimeModule& size = data->sizeOverLifetime;
+        size.enabled = true;
+        ok = ok && ReadCurve(record->size, size.size);
+        size.separateAxes = record->separateAxes != 0;
+        ok = ok && ReadCurve(record->x, size.x);
+        ok = ok && ReadCurve(record->y, size.y);
+        ok = ok && ReadCurve(record->z, size.z);
+    }
+
+    if (const auto* record = GetModule<CompiledRotationModule>(kCompiledRotationOverLifetime)) {
+        RotationOverLifetimeModule& rotation = data->rotationOverLifetime;
+        rotation.enabled = true;
+        ok = ok && ReadCurve(record->x, rotation.x);
+        ok = ok && ReadCurve(record->y, rotation.y);
+        ok = ok && ReadCurve(record->z, rotation.z);
+        rotation.separateAxes = record->separateAxes != 0;
+    }
+
+    if (const auto* record = GetModule<CompiledNoiseModule>(kCompiledNoise)) {
+        NoiseModule& noise = data->noise;
+        noise.enabled = true;
+        ok = ok && ReadCurve(record->strength, noise.strength);
+        noise.frequency = record->frequency;
+        noise.scrollSpeed = record->scrollSpeed;
+        noise.damping = record->damping != 0;
+        noise.octaves = record->octaves;
+        noise.octaveMultiplier = record->octaveMultiplier;
+        noise.octaveScale = record->octaveScale;
+        noise.quality = record->quality;
+        noise.separateAxes = record->separateAxes != 0;
+        ok = ok && ReadCurve(record->strengthX, noise.strengthX);
+        ok = ok && ReadCurve(record->strengthY, noise.strengthY);
+        ok = ok && ReadCurve(record->strengthZ, noise.strengthZ);
+    }
+
+    if (const auto* record = GetModule<CompiledCollisionModule>(kCompiledCollision)) {
+        CollisionModule& collision = data->collision;
+        collision.enabled = true;
+        collision.type = static_cast<ParticleSystemCollisionType>(record->type);
+        collision.mode = static_cast<ParticleSystemCollisionMode>(record->mode);
+        ok = ok && ReadCurve(record->dampen, collision.dampen);
+        ok = ok && ReadCurve(record->bounce, collision.bounce);
+        ok = ok && ReadCurve(record->lifetimeLoss, collision.lifetimeLoss);
+        collision.minKillSpeed = record->minKillSpeed;
+        collision.maxKillSpeed = record->maxKillSpeed;
+        collision.radiusScale = record->radiusScale;
+        collision.collidesWithDynamic = record->collidesWithDynamic != 0;
+        collision.maxCollisionShapes = record->maxCollisionShapes;
+    }
+
+    if (const auto* record = GetModule<CompiledTextureSheetModule>(kCompiledTextureSheet)) {
+        TextureSheetAnimationModule& sheet = data->textureSheetAnimation;
+        sheet.enabled = true;
+        sheet.numTilesX = record->numTilesX;
+        sheet.numTilesY = record->numTilesY;
+        sheet.animationType = static_cast<ParticleSystemAnimationType>(record->animationType);
+        sheet.mode = static_cast<ParticleSystemAnimationMode>(record->mode);
+        ok = ok && ReadCurve(record->frameOverTime, sheet.frameOverTime);
+        ok = ok && ReadCurve(record->startFrame, sheet.startFrame);
+        sheet.cycleCount = record->cycleCount;
+        sheet.rowIndex = record->rowIndex;
+    }
+
+    data->subEmitters.resize(m_header->subEmitters.count);
+    for (uint32_t i = 0; i < m_header->subEmitters.count; ++i) {
+        data->subEmitters[i].type = static_cast<ParticleSystemSubEmitterType>(m_subEmitters[i].type);
+        data->subEmitters[i].subEmitterName = GetString(m_subEmitters[i].name);
+    }
+
+    if (!ok) {
+        error = "compiled effect record points outside its table";
+        return nullptr;
+    }
+    return data;
+}
+
+} // namespace GPUParticles
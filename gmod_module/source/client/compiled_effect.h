@@ -0,0 +1,332 @@
+#pragma once
+
+#include "../particle_data.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Compiled effect: a flat binary image of one ParticleSystemData
+ *
+ * Written by the gpartc tool and detected by ParticleLoader from its
+ * magic. Everything is fixed-size records and tables addressed by byte
+ * offset from the start of the file, so a file read in one go (or
+ * mapped) is usable after bounds checks and pointer fix-ups only:
+ *
+ *   CompiledEffectHeader
+ *   Module records: CompiledMainModule, CompiledRendererModule, then one
+ *                   record per bit of moduleMask in bit order
+ *   Keyframe[]            Every curve's keys, one shared table
+ *   GradientColorKey[]    Every gradient's keys
+ *   GradientAlphaKey[]
+ *   Burst[]               Emission timeline
+ *   CompiledSubEmitter[]
+ *   char[]                Strings, NUL-terminated, by byte offset
+ *
+ * Disabled modules have no record and load as their defaults. Numbers
+ * are stored as the little-endian machines the module runs on hold them;
+ * any layout change bumps kVersion, and older files are rejected so the
+ * tool can rebuild them.
+ */
+struct CompiledEffect {
+    static constexpr char kMagic[4] = { 'G', 'P', 'R', 'C' };
+    static constexpr uint32_t kVersion = 1;
+
+    /**
+     * @brief Whether a buffer starts like a compiled effect (JSON never does)
+     */
+    static bool IsCompiled(const void* data, size_t size);
+
+    /**
+     * @brief Build the file image of an effect
+     */
+    static std::vector<uint8_t> Compile(const ParticleSystemData& data);
+};
+
+// Optional module records present in a file (CompiledEffectHeader::moduleMask)
+enum CompiledModuleBit : uint32_t {
+    kCompiledEmission              = 1u << 0,
+    kCompiledShape                 = 1u << 1,
+    kCompiledVelocityOverLifetime  = 1u << 2,
+    kCompiledLimitVelocity         = 1u << 3,
+    kCompiledForceOverLifetime     = 1u << 4,
+    kCompiledColorOverLifetime     = 1u << 5,
+    kCompiledSizeOverLifetime      = 1u << 6,
+    kCompiledRotationOverLifetime  = 1u << 7,
+    kCompiledNoise                 = 1u << 8,
+    kCompiledCollision             = 1u << 9,
+    kCompiledTextureSheet          = 1u << 10,
+    kCompiledModuleCount           = 11
+};
+
+// Elements [first, first + count) of one of the tables
+struct CompiledRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Table position in bytes from the start of the file
+struct CompiledSection {
+    uint32_t offset;
+    uint32_t count;   // Elements (bytes for the module records and strings)
+};
+
+struct CompiledEffectHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t fileSize;
+    uint32_t moduleMask;
+    uint32_t name;            // String offsets
+    uint32_t dataVersion;
+    CompiledSection modules;
+    CompiledSection keyframes;
+    CompiledSection colorKeys;
+    CompiledSection alphaKeys;
+    CompiledSection bursts;
+    CompiledSection subEmitters;
+    CompiledSection strings;
+};
+
+// Bools and enums are stored as uint32_t so no record has padding
+struct CompiledCurve {
+    uint32_t mode;            // CurveMode
+    float constant;
+    float constantMin;
+    float constantMax;
+    float multiplier;
+    CompiledRange curve;      // Keyframe table
+    CompiledRange curveMin;
+    CompiledRange curveMax;
+};
+
+struct CompiledGradient {
+    CompiledRange colorKeys;
+    CompiledRange alphaKeys;
+};
+
+struct CompiledMainModule {
+    float duration;
+    uint32_t looping;
+    uint32_t prewarm;
+    CompiledCurve startDelay;
+    CompiledCurve startLifetime;
+    CompiledCurve startSpeed;
+    CompiledCurve startSize;
+    uint32_t startSize3D;
+    CompiledCurve startSizeX;
+    CompiledCurve startSizeY;
+    CompiledCurve startSizeZ;
+    CompiledCurve startRotation;
+    uint32_t startRotation3D;
+    CompiledCurve startRotationX;
+    CompiledCurve startRotationY;
+    CompiledCurve startRotationZ;
+    Color startColor;
+    CompiledCurve gravityModifier;
+    uint32_t simulationSpace;
+    float simulationSpeed;
+    uint32_t playOnAwake;
+    int32_t maxParticles;
+};
+
+struct CompiledRendererModule {
+    uint32_t renderMode;
+    uint32_t sortMode;
+    float minParticleSize;
+    float maxParticleSize;
+    uint32_t material;        // String offsets
+    uint32_t texture;
+    Vector3 pivot;
+    uint32_t flip;
+    Vector3 velocityScale;
+    float lengthScale;
+    float normalDirection;
+    int32_t sortingOrder;
+    int32_t hullVertices;
+};
+
+struct CompiledEmissionModule {
+    CompiledCurve rateOverTime;
+    CompiledCurve rateOverDistance;
+    CompiledRange bursts;
+};
+
+struct CompiledShapeModule {
+    uint32_t shapeType;
+    float angle;
+    float radius;
+    float radiusThickness;
+    float arc;
+    Vector3 boxScale;
+    Vector3 position;
+    Vector3 rotation;
+    Vector3 scale;
+    uint32_t alignToDirection;
+    float randomDirectionAmount;
+    float sphericalDirectionAmount;
+    uint32_t arcMode;
+};
+
+struct CompiledVelocityModule {
+    CompiledCurve x;
+    CompiledCurve y;
+    CompiledCurve z;
+    uint32_t space;
+};
+
+struct CompiledLimitVelocityModule {
+    CompiledCurve limit;
+    float dampen;
+    uint32_t separateAxes;
+    CompiledCurve limitX;
+    CompiledCurve limitY;
+    CompiledCurve limitZ;
+};
+
+struct CompiledForceModule {
+    CompiledCurve x;
+    CompiledCurve y;
+    CompiledCurve z;
+    uint32_t space;
+    uint32_t randomized;
+};
+
+struct CompiledColorModule {
+    CompiledGradient gradient;
+};
+
+struct CompiledSizeModule {
+    CompiledCurve size;
+    uint32_t separateAxes;
+    CompiledCurve x;
+    CompiledCurve y;
+    CompiledCurve z;
+};
+
+struct CompiledRotationModule {
+    CompiledCurve x;
+    CompiledCurve y;
+    CompiledCurve z;
+    uint32_t separateAxes;
+};
+
+struct CompiledNoiseModule {
+    CompiledCurve strength;
+    float frequency;
+    float scrollSpeed;
+    uint32_t damping;
+    int32_t octaves;
+    float octaveMultiplier;
+    float octaveScale;
+    int32_t quality;
+    uint32_t separateAxes;
+    CompiledCurve strengthX;
+    CompiledCurve strengthY;
+    CompiledCurve strengthZ;
+};
+
+struct CompiledCollisionModule {
+    uint32_t type;
+    uint32_t mode;
+    CompiledCurve dampen;
+    CompiledCurve bounce;
+    CompiledCurve lifetimeLoss;
+    float minKillSpeed;
+    float maxKillSpeed;
+    float radiusScale;
+    uint32_t collidesWithDynamic;
+    int32_t maxCollisionShapes;
+};
+
+struct CompiledTextureSheetModule {
+    int32_t numTilesX;
+    int32_t numTilesY;
+    uint32_t animationType;
+    uint32_t mode;
+    CompiledCurve frameOverTime;
+    CompiledCurve startFrame;
+    int32_t cycleCount;
+    int32_t rowIndex;
+};
+
+struct CompiledSubEmitter {
+    uint32_t type;
+    uint32_t name;            // String offset
+};
+
+// The tables hold the runtime types as they are, so loading them is a copy
+static_assert(sizeof(Keyframe) == 16 && std::is_trivially_copyable<Keyframe>::value,
+              "Keyframe is stored as is in compiled effects");
+static_assert(sizeof(GradientColorKey) == 20 && std::is_trivially_copyable<GradientColorKey>::value,
+              "GradientColorKey is stored as is in compiled effects");
+static_assert(sizeof(GradientAlphaKey) == 8 && std::is_trivially_copyable<GradientAlphaKey>::value,
+              "GradientAlphaKey is stored as is in compiled effects");
+static_assert(sizeof(Burst) == 20 && std::is_trivially_copyable<Burst>::value,
+              "Burst is stored as is in compiled effects");
+
+/**
+ * @brief Read-only access to a compiled effect in memory
+ *
+ * Open checks the header and that every table lies inside the buffer,
+ * then points the tables into it; nothing is copied or decoded. The
+ * buffer must outlive the view and be 4-byte aligned.
+ */
+class CompiledEffectView {
+public:
+    CompiledEffectView();
+
+    /**
+     * @brief Check a buffer and set up the table pointers
+     * @return False with an error message if it is not a valid compiled effect
+     */
+    bool Open(const void* data, size_t size, std::string& error);
+
+    const CompiledEffectHeader& GetHeader() const { return *m_header; }
+    const CompiledMainModule& GetMain() const { return *m_main; }
+    const CompiledRendererModule& GetRenderer() const { return *m_renderer; }
+
+    /**
+     * @brief Record of an optional module, or nullptr when the effect has it disabled
+     */
+    template <typename Record>
+    const Record* GetModule(CompiledModuleBit bit) const {
+        return static_cast<const Record*>(m_modules[BitIndex(bit)]);
+    }
+
+    /**
+     * @brief String at an offset of the string table ("" when out of range)
+     */
+    const char* GetString(uint32_t offset) const;
+
+    /**
+     * @brief Copy into the structure the simulator runs on
+     * @return nullptr with an error message if a record points outside its table
+     */
+    std::unique_ptr<ParticleSystemData> ToSystemData(std::string& error) const;
+
+private:
+    static uint32_t BitIndex(CompiledModuleBit bit);
+
+    bool ReadCurve(const CompiledCurve& in, MinMaxCurve& out) const;
+    bool ReadKeys(const CompiledRange& range, AnimationCurve& out) const;
+    bool ReadGradient(const CompiledGradient& in, Gradient& out) const;
+
+    const uint8_t* m_data;
+    const CompiledEffectHeader* m_header;
+    const CompiledMainModule* m_main;
+    const CompiledRendererModule* m_renderer;
+    const void* m_modules[kCompiledModuleCount];
+    const Keyframe* m_keyframes;
+    const GradientColorKey* m_colorKeys;
+    const GradientAlphaKey* m_alphaKeys;
+    const Burst* m_bursts;
+    const CompiledSubEmitter* m_subEmitters;
+    const char* m_strings;
+};
+
+} // namespace GPUParticles
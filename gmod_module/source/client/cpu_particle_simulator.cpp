@@ -2,13 +2,23 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <limits>
 
 namespace GPUParticles {
 
+// Upper limit on simulation steps for one FastForward call
+static const int kMaxFastForwardSteps = 30;
+
+// Step length used by FastForward when the limit isn't hit
+static const float kFastForwardStep = 0.1f;
+
 CPUParticleSimulator::CPUParticleSimulator()
     : m_aliveCount(0)
     , m_emissionAccumulator(0.0f)
     , m_systemTime(0.0f)
+    , m_emissionScale(1.0f)
+    , m_particleCap(0)
+    , m_maxLifetime(0.0f)
     , m_initialized(false)
     , m_rng(std::random_device{}())
     , m_dist(0.0f, 1.0f)
@@ -41,6 +51,14 @@ bool CPUParticleSimulator::Initialize(const ParticleSystemData& data) {
     m_initialized = true;
     m_systemTime = 0.0f;
     m_emissionAccumulator = 0.0f;
+    m_emissionScale = 1.0f;
+    m_particleCap = m_data.main.maxParticles;
+    m_maxLifetime = std::max(0.0f, m_data.main.startLifetime.GetMaxValue());
+
+    // Prewarm: start as if one full loop had already played
+    if (m_data.main.prewarm && m_data.main.looping) {
+        FastForward(m_data.main.duration);
+    }
 
     std::cout << "[CPUParticleSimulator] Initialization successful!" << std::endl;
     return true;
@@ -62,8 +80,10 @@ void CPUParticleSimulator::Update(float deltaTime) {
     }
 
     // Clamp delta time to prevent huge jumps
-    deltaTime = std::min(deltaTime, 0.1f);
+    Step(std::min(deltaTime, 0.1f));
+}
 
+void CPUParticleSimulator::Step(float deltaTime) {
     m_systemTime += deltaTime;
 
     // Check duration and looping
@@ -91,8 +111,8 @@ void CPUParticleSimulator::EmitParticles(float deltaTime) {
     // Calculate emission rate
     float emissionRate = EvaluateMinMaxCurve(m_data.emission.rateOverTime, m_systemTime);
 
-    // Accumulate particles to emit
-    m_emissionAccumulator += emissionRate * deltaTime;
+    // Accumulate particles to emit (scaled down by the global budget)
+    m_emissionAccumulator += emissionRate * m_emissionScale * deltaTime;
 
     // Emit integer number of particles
     int particlesToEmit = static_cast<int>(m_emissionAccumulator);
@@ -108,12 +128,21 @@ void CPUParticleSimulator::EmitParticles(float deltaTime) {
             if (burst.maxCount > burst.minCount) {
                 count = burst.minCount + (rand() % (burst.maxCount - burst.minCount + 1));
             }
+
+            // Scale burst with stochastic rounding so small bursts don't vanish
+            if (m_emissionScale < 1.0f) {
+                float scaled = count * m_emissionScale;
+                count = static_cast<int>(scaled);
+                if (RandomRange(0, 1) < scaled - count) {
+                    count++;
+                }
+            }
             particlesToEmit += count;
         }
     }
 
     // Spawn particles
-    for (int i = 0; i < particlesToEmit && m_aliveCount < m_data.main.maxParticles; ++i) {
+    for (int i = 0; i < particlesToEmit && m_aliveCount < m_particleCap; ++i) {
         SpawnParticle();
     }
 }
@@ -230,6 +259,7 @@ Vector3 CPUParticleSimulator::GetEmissionVelocity() {
 
 void CPUParticleSimulator::UpdateParticles(float deltaTime) {
     m_aliveCount = 0;
+    m_bounds.Reset();
 
     for (auto& p : m_particles) {
         if (!p.alive) {
@@ -258,6 +288,7 @@ void CPUParticleSimulator::UpdateParticles(float deltaTime) {
         UpdateSizeOverLifetime(p);
         UpdateRotationOverLifetime(p, deltaTime);
 
+        m_bounds.Add(p.position, p.size);
         m_aliveCount++;
     }
 }
@@ -322,10 +353,74 @@ void CPUParticleSimulator::UpdateRotationOverLifetime(Particle& p, float deltaTi
     p.rotation += rotationSpeed * deltaTime;
 }
 
+void CPUParticleSimulator::SetEmissionScale(float scale) {
+    m_emissionScale = std::max(0.0f, std::min(1.0f, scale));
+}
+
+void CPUParticleSimulator::SetParticleCap(int cap) {
+    m_particleCap = std::max(0, std::min(cap, m_data.main.maxParticles));
+}
+
+void CPUParticleSimulator::FastForward(float seconds) {
+    if (!m_initialized || seconds <= 0.0f) {
+        return;
+    }
+
+    const float duration = std::max(m_data.main.duration, 0.001f);
+
+    if (seconds > m_maxLifetime) {
+        // Every particle alive now dies before the end, and nothing emitted
+        // before the last lifetime window survives: skip that time outright
+        float skipped = seconds - m_maxLifetime;
+
+        for (auto& p : m_particles) {
+            p.alive = false;
+        }
+        m_aliveCount = 0;
+        m_emissionAccumulator = 0.0f;
+        m_bounds.Reset();
+
+        if (m_data.main.looping) {
+            m_systemTime = fmod(m_systemTime + skipped, duration);
+        } else {
+            m_systemTime += skipped;
+        }
+
+        seconds = m_maxLifetime;
+    }
+
+    // Ended while skipping: nothing left to simulate
+    if (IsFinished()) {
+        return;
+    }
+
+    int steps = static_cast<int>(std::ceil(seconds / kFastForwardStep));
+    steps = std::max(1, std::min(steps, kMaxFastForwardSteps));
+
+    const float stepTime = seconds / steps;
+    for (int i = 0; i < steps; ++i) {
+        Step(stepTime);
+    }
+}
+
+bool CPUParticleSimulator::IsFinished() const {
+    return !m_data.main.looping && m_systemTime >= m_data.main.duration && m_aliveCount == 0;
+}
+
+float CPUParticleSimulator::GetRemainingTime() const {
+    if (m_data.main.looping) {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    // Emission stops at duration; the last particles live at most m_maxLifetime
+    return std::max(0.0f, m_data.main.duration - m_systemTime) + m_maxLifetime;
+}
+
 void CPUParticleSimulator::Reset() {
     m_systemTime = 0.0f;
     m_emissionAccumulator = 0.0f;
     m_aliveCount = 0;
+    m_bounds.Reset();
 
     for (auto& p : m_particles) {
         p.alive = false;
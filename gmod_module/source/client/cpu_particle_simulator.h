@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../particle_data.h"
+#include "particle_bounds.h"
 #include <vector>
 #include <memory>
 #include <random>
@@ -81,11 +82,58 @@ public:
      */
     void Reset();
 
+    /**
+     * @brief Get the particle system configuration
+     */
+    const ParticleSystemData& GetData() const { return m_data; }
+
+    /**
+     * @brief Scale emission (rate and bursts) relative to the authored values
+     * @param scale Fraction of nominal emission to keep (0-1)
+     */
+    void SetEmissionScale(float scale);
+    float GetEmissionScale() const { return m_emissionScale; }
+
+    /**
+     * @brief Limit how many particles may be alive at once
+     * @param cap Maximum alive particles (clamped to maxParticles)
+     */
+    void SetParticleCap(int cap);
+    int GetParticleCap() const { return m_particleCap; }
+
+    /**
+     * @brief Advance the simulation by a long interval in one bounded operation
+     *
+     * Only the last max-lifetime seconds can affect particles alive at the
+     * end, so older time is skipped analytically and the rest is stepped
+     * with a fixed maximum number of updates. Used for prewarm and to catch
+     * up instances that slept while off-screen.
+     */
+    void FastForward(float seconds);
+
+    /**
+     * @brief True once a non-looping effect stopped emitting and all particles died
+     */
+    bool IsFinished() const;
+
+    /**
+     * @brief Upper bound on the time until IsFinished() (infinite when looping)
+     */
+    float GetRemainingTime() const;
+
+    /**
+     * @brief Bounds of the alive particles after the last update
+     *
+     * Positions are in emitter space, sizes are unscaled.
+     */
+    const BoundsAccumulator& GetBounds() const { return m_bounds; }
+
 private:
     // Initialization
     void InitializeParticlePool();
 
     // Simulation steps
+    void Step(float deltaTime);
     void EmitParticles(float deltaTime);
     void UpdateParticles(float deltaTime);
     void ApplyForces(Particle& p, float deltaTime);
@@ -110,6 +158,10 @@ private:
     int m_aliveCount;
     float m_emissionAccumulator;
     float m_systemTime;
+    float m_emissionScale;
+    int m_particleCap;
+    float m_maxLifetime;
+    BoundsAccumulator m_bounds;
     bool m_initialized;
     std::string m_lastError;
 
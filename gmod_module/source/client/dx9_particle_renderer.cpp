@@ -2,6 +2,8 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
 namespace GPUParticles {
 
@@ -12,11 +14,40 @@ DX9ParticleRenderer::DX9ParticleRenderer()
     : m_context(nullptr)
     , m_device(nullptr)
     , m_vertexBuffer(nullptr)
+    , m_indexBuffer(nullptr)
     , m_texture(nullptr)
     , m_vertexShader(nullptr)
     , m_pixelShader(nullptr)
     , m_vertexDeclaration(nullptr)
+    , m_billboardVertexShader(nullptr)
+    , m_compactDeclaration(nullptr)
+    , m_pointBuffer(nullptr)
+    , m_pointVertexShader(nullptr)
+    , m_pointDeclaration(nullptr)
+    , m_vertexFormat(VertexFormat::Standard)
+    , m_workers(nullptr)
     , m_maxParticles(0)
+    , m_fanIndexStart()
+    , m_ringOffset(0)
+    , m_pointRingOffset(0)
+    , m_inFrame(false)
+    , m_vertexReuse(false)
+    , m_reuseMaxMove(1.0f)
+    , m_reuseMinAxisDot(std::cos(0.25f * 3.14159f / 180.0f))
+    , m_cacheGeneration(1)
+    , m_cameraSteady(false)
+    , m_frameReused(0)
+    , m_frameBuilt(0)
+    , m_lastFrameReused(0)
+    , m_lastFrameBuilt(0)
+    , m_framePoints(0)
+    , m_lastFramePoints(0)
+    , m_boundTexture(nullptr)
+    , m_boundBlend(BlendMode::Count)
+    , m_frameDraws(0)
+    , m_frameStateChanges(0)
+    , m_lastFrameDraws(0)
+    , m_lastFrameStateChanges(0)
     , m_initialized(false)
     , m_savedVertexShader(nullptr)
     , m_savedPixelShader(nullptr)
@@ -25,6 +56,7 @@ DX9ParticleRenderer::DX9ParticleRenderer()
     , m_savedStreamSource(nullptr)
     , m_savedStreamOffset(0)
     , m_savedStreamStride(0)
+    , m_savedIndices(nullptr)
 {
 }
 
@@ -67,6 +99,16 @@ bool DX9ParticleRenderer::Initialize(DX9Context* context) {
         return false;
     }
 
+    if (!CreateIndexBuffer()) {
+        std::cerr << "[DX9ParticleRenderer] Failed to create index buffer" << std::endl;
+        return false;
+    }
+
+    // Optional: without them every particle is drawn as a billboard
+    if (!CreatePointSprites()) {
+        LogToFile("[DX9ParticleRenderer] Point sprites unavailable: " + m_lastError);
+    }
+
     // Create default texture
     if (!CreateTexture()) {
         std::cerr << "[DX9ParticleRenderer] Failed to create texture" << std::endl;
@@ -86,7 +128,21 @@ void DX9ParticleRenderer::Shutdown() {
 
     std::cout << "[DX9ParticleRenderer] Shutting down..." << std::endl;
 
+    // Never leave the game's state behind a half-finished frame
+    EndFrame();
+    m_ringOffset = 0;
+
     // Release DirectX resources
+    if (m_compactDeclaration) {
+        m_compactDeclaration->Release();
+        m_compactDeclaration = nullptr;
+    }
+
+    if (m_billboardVertexShader) {
+        m_billboardVertexShader->Release();
+        m_billboardVertexShader = nullptr;
+    }
+
     if (m_vertexDeclaration) {
         m_vertexDeclaration->Release();
         m_vertexDeclaration = nullptr;
@@ -107,11 +163,32 @@ void DX9ParticleRenderer::Shutdown() {
         m_texture = nullptr;
     }
 
+    if (m_indexBuffer) {
+        m_indexBuffer->Release();
+        m_indexBuffer = nullptr;
+    }
+
     if (m_vertexBuffer) {
         m_vertexBuffer->Release();
         m_vertexBuffer = nullptr;
     }
 
+    if (m_pointBuffer) {
+        m_pointBuffer->Release();
+        m_pointBuffer = nullptr;
+    }
+
+    // Cleared so SetPointSpriteSize sees point sprites as unsupported
+    if (m_pointVertexShader) {
+        m_pointVertexShader->Release();
+        m_pointVertexShader = nullptr;
+    }
+
+    if (m_pointDeclaration) {
+        m_pointDeclaration->Release();
+        m_pointDeclaration = nullptr;
+    }
+
     m_device = nullptr;
     m_context = nullptr;
     m_initialized = false;
@@ -125,8 +202,11 @@ bool DX9ParticleRenderer::LoadShaders() {
     // For now, we'll compile shaders at runtime
     // In production, you'd pre-compile them
 
-    // Simple passthrough vertex shader (billboarding done on CPU now)
-    // NOTE: Matrix multiplication order matters! Trying both to find which works
+    // One vertex shader for everything. Particles are compiled with
+    // BILLBOARD: each vertex carries the particle center and its corner
+    // (-1..1), and the quad is rotated, scaled and expanded along the
+    // camera axes here. Without it the position is already final (debug
+    // test quads). RenderPacketBuilder::ExpandCorner is the CPU reference.
     const char* vsSource =
         "struct VS_INPUT { \n"
         "    float3 position : POSITION0; \n"
@@ -140,13 +220,23 @@ bool DX9ParticleRenderer::LoadShaders() {
         "    float2 texcoord : TEXCOORD0; \n"
         "}; \n"
         "float4x4 viewProjection : register(c0); \n"
+        "float4 cameraRight : register(c4); \n"
+        "float4 cameraUp : register(c5); \n"
         "VS_OUTPUT main(VS_INPUT input) { \n"
         "    VS_OUTPUT output; \n"
-        "    // Position is already expanded on CPU, just transform to screen space \n"
-        "    // CHANGED: Reverse multiplication order (matrix * vector instead of vector * matrix) \n"
-        "    output.position = mul(viewProjection, float4(input.position, 1.0)); \n"
-        "    output.color = input.color; \n"
+        "#ifdef BILLBOARD \n"
+        "    float s, c; \n"
+        "    sincos(input.sizeRot.y, s, c); \n"
+        "    float2 corner = float2(input.texcoord.x * c - input.texcoord.y * s, \n"
+        "                           input.texcoord.x * s + input.texcoord.y * c) * input.sizeRot.x; \n"
+        "    float3 worldPos = input.position + cameraRight.xyz * corner.x + cameraUp.xyz * corner.y; \n"
+        "    output.texcoord = input.texcoord * float2(0.5, -0.5) + 0.5; \n"
+        "#else \n"
+        "    float3 worldPos = input.position; \n"
         "    output.texcoord = input.texcoord; \n"
+        "#endif \n"
+        "    output.position = mul(viewProjection, float4(worldPos, 1.0)); \n"
+        "    output.color = input.color; \n"
         "    return output; \n"
         "} \n";
 
@@ -161,36 +251,23 @@ bool DX9ParticleRenderer::LoadShaders() {
         "    return texColor * input.color; \n"
         "} \n";
 
-    // Compile vertex shader
-    ID3DBlob* vsBuffer = nullptr;
-    ID3DBlob* errorBuffer = nullptr;
-
-    HRESULT hr = D3DCompile(vsSource, strlen(vsSource), nullptr, nullptr, nullptr,
-                           "main", "vs_2_0", 0, 0, &vsBuffer, &errorBuffer);
-
-    if (FAILED(hr)) {
-        if (errorBuffer) {
-            m_lastError = std::string("VS compile error: ") +
-                         static_cast<char*>(errorBuffer->GetBufferPointer());
-            errorBuffer->Release();
-        } else {
-            m_lastError = "Failed to compile vertex shader";
-        }
+    // Compile vertex shaders
+    if (!CompileVertexShader(vsSource, nullptr, &m_vertexShader)) {
         return false;
     }
 
-    hr = m_device->CreateVertexShader(static_cast<DWORD*>(vsBuffer->GetBufferPointer()),
-                                      &m_vertexShader);
-    vsBuffer->Release();
-
-    if (FAILED(hr)) {
-        m_lastError = "Failed to create vertex shader";
-        return false;
+    // Without the billboard shader, quads are expanded on the CPU and drawn
+    // with the passthrough shader
+    const D3D_SHADER_MACRO billboardDefines[] = { {"BILLBOARD", "1"}, {nullptr, nullptr} };
+    bool shaderBillboards = CompileVertexShader(vsSource, billboardDefines, &m_billboardVertexShader);
+    if (!shaderBillboards) {
+        LogToFile("[DX9ParticleRenderer] Billboard shader unavailable, expanding on the CPU: " + m_lastError);
     }
 
     // Compile pixel shader
     ID3DBlob* psBuffer = nullptr;
-    hr = D3DCompile(psSource, strlen(psSource), nullptr, nullptr, nullptr,
+    ID3DBlob* errorBuffer = nullptr;
+    HRESULT hr = D3DCompile(psSource, strlen(psSource), nullptr, nullptr, nullptr,
                    "main", "ps_2_0", 0, 0, &psBuffer, &errorBuffer);
 
     if (FAILED(hr)) {
@@ -228,22 +305,80 @@ bool DX9ParticleRenderer::LoadShaders() {
         return false;
     }
 
+    // Compact vertices need half float inputs; older cards keep the standard
+    // format. Both feed the same billboard shader.
+    m_vertexFormat = shaderBillboards ? VertexFormat::Standard : VertexFormat::Expanded;
+    const DWORD compactDeclTypes = D3DDTCAPS_FLOAT16_2 | D3DDTCAPS_SHORT2N;
+    if (shaderBillboards && (m_context->GetCaps().DeclTypes & compactDeclTypes) == compactDeclTypes) {
+        D3DVERTEXELEMENT9 compactElements[] = {
+            {0, 0,  D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+            {0, 12, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR, 0},
+            {0, 16, D3DDECLTYPE_FLOAT16_2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+            {0, 20, D3DDECLTYPE_SHORT2N, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 1},
+            D3DDECL_END()
+        };
+
+        if (SUCCEEDED(m_device->CreateVertexDeclaration(compactElements, &m_compactDeclaration))) {
+            m_vertexFormat = VertexFormat::Compact;
+        } else {
+            LogToFile("[DX9ParticleRenderer] Compact vertex declaration rejected, using standard format");
+        }
+    }
+
+    static const char* kFormatNames[] = { "standard", "compact", "CPU expanded" };
+    std::cout << "[DX9ParticleRenderer] Vertex format: "
+              << kFormatNames[static_cast<int>(m_vertexFormat)]
+              << " (" << GetVertexStride(m_vertexFormat) << " bytes)" << std::endl;
+
     std::cout << "[DX9ParticleRenderer] Shaders loaded successfully" << std::endl;
     return true;
 }
 
+bool DX9ParticleRenderer::CompileVertexShader(const char* source,
+                                              const D3D_SHADER_MACRO* defines,
+                                              IDirect3DVertexShader9** shader) {
+    ID3DBlob* vsBuffer = nullptr;
+    ID3DBlob* errorBuffer = nullptr;
+
+    HRESULT hr = D3DCompile(source, strlen(source), nullptr, defines, nullptr,
+                           "main", "vs_2_0", 0, 0, &vsBuffer, &errorBuffer);
+
+    if (FAILED(hr)) {
+        if (errorBuffer) {
+            m_lastError = std::string("VS compile error: ") +
+                         static_cast<char*>(errorBuffer->GetBufferPointer());
+            errorBuffer->Release();
+        } else {
+            m_lastError = "Failed to compile vertex shader";
+        }
+        return false;
+    }
+
+    hr = m_device->CreateVertexShader(static_cast<DWORD*>(vsBuffer->GetBufferPointer()), shader);
+    vsBuffer->Release();
+
+    if (FAILED(hr)) {
+        m_lastError = "Failed to create vertex shader";
+        return false;
+    }
+
+    return true;
+}
+
 bool DX9ParticleRenderer::CreateVertexBuffer() {
     std::cout << "[DX9ParticleRenderer] Creating vertex buffer for "
               << m_maxParticles << " particles..." << std::endl;
 
-    // Each particle needs 4 vertices (quad corners)
+    // Each particle needs 4 vertices (quad corners); trimmed outlines use
+    // up to 8, so fewer of them fit
     int vertexCount = m_maxParticles * 4;
-    int bufferSize = vertexCount * sizeof(ParticleVertex);
+    int bufferSize = vertexCount * GetVertexStride(m_vertexFormat);
 
+    // The compact format has no FVF equivalent; the declaration describes it
     HRESULT hr = m_device->CreateVertexBuffer(
         bufferSize,
         D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY,
-        ParticleVertex::FVF,
+        (m_vertexFormat == VertexFormat::Compact) ? 0 : kParticleVertexFVF,
         D3DPOOL_DEFAULT,
         &m_vertexBuffer,
         nullptr
@@ -258,6 +393,117 @@ bool DX9ParticleRenderer::CreateVertexBuffer() {
     return true;
 }
 
+bool DX9ParticleRenderer::CreatePointSprites() {
+    // Sprites are sized in pixels by the shader (no D3DRS_POINTSCALEENABLE)
+    // and the width byte reaches kMaxPixels
+    if (m_context->GetCaps().MaxPointSize < PointSpriteVertex::kMaxPixels) {
+        m_lastError = "MaxPointSize too small";
+        return false;
+    }
+
+    // Center and width come straight from the vertex; the pixel shader is
+    // the billboards' one, reading the texture coordinates the rasterizer
+    // generates across the sprite
+    const char* vsSource =
+        "struct VS_INPUT { \n"
+        "    float3 position : POSITION0; \n"
+        "    float4 color : COLOR0; \n"
+        "}; \n"
+        "struct VS_OUTPUT { \n"
+        "    float4 position : POSITION0; \n"
+        "    float4 color : COLOR0; \n"
+        "    float size : PSIZE; \n"
+        "}; \n"
+        "float4x4 viewProjection : register(c0); \n"
+        "VS_OUTPUT main(VS_INPUT input) { \n"
+        "    VS_OUTPUT output; \n"
+        "    output.position = mul(viewProjection, float4(input.position, 1.0)); \n"
+        "    output.color = float4(input.color.rgb, 1.0); \n"
+        "    output.size = input.color.a * (255.0 / 16.0); \n"
+        "    return output; \n"
+        "} \n";
+
+    IDirect3DVertexShader9* shader = nullptr;
+    if (!CompileVertexShader(vsSource, nullptr, &shader)) {
+        return false;
+    }
+
+    D3DVERTEXELEMENT9 pointElements[] = {
+        {0, 0,  D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+        {0, 12, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR, 0},
+        D3DDECL_END()
+    };
+
+    if (FAILED(m_device->CreateVertexDeclaration(pointElements, &m_pointDeclaration))) {
+        m_lastError = "Failed to create point sprite vertex declaration";
+        shader->Release();
+        return false;
+    }
+
+    HRESULT hr = m_device->CreateVertexBuffer(
+        m_maxParticles * sizeof(PointSpriteVertex),
+        D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY | D3DUSAGE_POINTS,
+        0,
+        D3DPOOL_DEFAULT,
+        &m_pointBuffer,
+        nullptr
+    );
+
+    if (FAILED(hr)) {
+        m_lastError = "Failed to create point sprite vertex buffer";
+        m_pointDeclaration->Release();
+        m_pointDeclaration = nullptr;
+        shader->Release();
+        return false;
+    }
+
+    m_pointVertexShader = shader;
+    std::cout << "[DX9ParticleRenderer] Point sprites available ("
+              << sizeof(PointSpriteVertex) << " bytes per particle)" << std::endl;
+    return true;
+}
+
+bool DX9ParticleRenderer::CreateIndexBuffer() {
+    // The fan patterns never change: build them once, one section per
+    // stream vertex count, and reuse them for every draw by moving the
+    // base vertex
+    static const uint32_t kFanSizes[] = { 4, 6, 8 };
+    uint32_t indexCount = 0;
+    for (uint32_t k : kFanSizes) {
+        m_fanIndexStart[k] = indexCount;
+        indexCount += RenderPacketBuilder::GetMaxParticlesPerDraw(k) * RenderPacketBuilder::GetIndicesPerParticle(k);
+    }
+
+    HRESULT hr = m_device->CreateIndexBuffer(
+        indexCount * sizeof(uint16_t),
+        D3DUSAGE_WRITEONLY,
+        D3DFMT_INDEX16,
+        D3DPOOL_DEFAULT,
+        &m_indexBuffer,
+        nullptr
+    );
+
+    if (FAILED(hr)) {
+        m_lastError = "Failed to create index buffer";
+        return false;
+    }
+
+    void* data = nullptr;
+    if (FAILED(m_indexBuffer->Lock(0, 0, &data, 0)) || !data) {
+        m_lastError = "Failed to lock index buffer";
+        return false;
+    }
+
+    for (uint32_t k : kFanSizes) {
+        RenderPacketBuilder::BuildFanIndices(static_cast<uint16_t*>(data) + m_fanIndexStart[k],
+                                             RenderPacketBuilder::GetMaxParticlesPerDraw(k), k);
+    }
+    m_indexBuffer->Unlock();
+
+    std::cout << "[DX9ParticleRenderer] Index buffer created" << std::endl;
+    return true;
+}
+
 bool DX9ParticleRenderer::CreateTexture() {
     LogToFile("[DX9ParticleRenderer] Creating default particle texture...");
 
@@ -305,33 +551,136 @@ bool DX9ParticleRenderer::CreateTexture() {
         }
     }
 
+    // A8R8G8B8 is stored B, G, R, A in memory
+    ComputeParticleShapes(static_cast<const uint8_t*>(lockedRect.pBits) + 3, size, 4, lockedRect.Pitch);
+
     m_texture->UnlockRect(0);
     LogToFile("[DX9ParticleRenderer] Texture created and filled successfully!");
     return true;
 }
 
-void DX9ParticleRenderer::Render(const CPUParticleSimulator& simulator,
+void DX9ParticleRenderer::ComputeParticleShapes(const uint8_t* alpha, int size, int texelStride, int rowStride) {
+    for (uint32_t k = 0; k <= ParticleShape::kMaxVertices; ++k) {
+        m_shapes[k] = ParticleShape();
+    }
+
+    for (int k = 4; k <= AlphaHull::kMaxVertices; ++k) {
+        AlphaHull hull = AlphaHull::Compute(alpha, size, size, texelStride, rowStride, k);
+        m_shapes[k] = ParticleShape::FromHull(hull);
+
+        char buf[128];
+        sprintf(buf, "[DX9ParticleRenderer] %d-vertex hull: %d corners, %.1f%% of the quad (%.1f%% less fill)",
+                k, hull.vertexCount, hull.area * 100.0f, (1.0f - hull.area) * 100.0f);
+        LogToFile(buf);
+    }
+}
+
+const ParticleShape& DX9ParticleRenderer::GetParticleShape(int hullVertices) const {
+    if (hullVertices < 4 || hullVertices > AlphaHull::kMaxVertices) {
+        return m_shapes[0];
+    }
+    return m_shapes[hullVertices];
+}
+
+// ============================================================================
+// Frame batching
+// ============================================================================
+
+void DX9ParticleRenderer::BeginFrame(const float* viewMatrix,
+                                     const float* projMatrix,
+                                     const float* cameraPos) {
+    if (!m_initialized || m_inFrame) {
+        return;
+    }
+
+    // One save of the game's state for every draw this frame
+    SetupRenderStates();
+    m_inFrame = true;
+
+    m_frameCamera = CameraData::FromViewMatrix(viewMatrix, cameraPos);
+
+    D3DVIEWPORT9 viewport;
+    if (SUCCEEDED(m_device->GetViewport(&viewport))) {
+        m_sizeFilter.SetView(m_frameCamera, projMatrix, static_cast<float>(viewport.Height));
+    }
+
+    Matrix4x4 viewProj = Matrix4x4::Multiply(Matrix4x4::FromArray(viewMatrix), Matrix4x4::FromArray(projMatrix));
+
+    static bool loggedVectors = false;
+    if (!loggedVectors) {
+        char buf[512];
+        sprintf(buf, "[Renderer] Camera right: (%.3f, %.3f, %.3f)",
+                m_frameCamera.right.x, m_frameCamera.right.y, m_frameCamera.right.z);
+        LogToFile(buf);
+        sprintf(buf, "[Renderer] Camera up: (%.3f, %.3f, %.3f)",
+                m_frameCamera.up.x, m_frameCamera.up.y, m_frameCamera.up.z);
+        LogToFile(buf);
+        loggedVectors = true;
+    }
+
+    m_device->SetVertexShader(GetParticleVertexShader());
+    m_device->SetPixelShader(m_pixelShader);
+    m_device->SetVertexDeclaration(GetParticleDeclaration());
+    m_device->SetVertexShaderConstantF(0, &viewProj.m[0][0], 4);
+    SetCameraConstants(m_frameCamera);
+    m_device->SetStreamSource(0, m_vertexBuffer, 0, GetVertexStride(m_vertexFormat));
+    m_device->SetIndices(m_indexBuffer);
+
+    m_pending = PendingDraw();
+    m_boundTexture = nullptr;
+    m_boundBlend = BlendMode::Count;
+    m_frameDraws = 0;
+    m_frameStateChanges = 0;
+    m_frameSizeStats = ScreenSizeStats();
+    m_frameReused = 0;
+    m_frameBuilt = 0;
+    m_framePoints = 0;
+
+    // Vertices are only worth keeping while the camera holds still
+    if (m_vertexReuse) {
+        m_cameraSteady = VertexCache::IsCameraClose(m_frameCamera, m_reuseCamera,
+                                                    m_reuseMaxMove, m_reuseMinAxisDot, true);
+        m_reuseCamera = m_frameCamera;
+    }
+}
+
+void DX9ParticleRenderer::EndFrame() {
+    if (!m_inFrame) {
+        return;
+    }
+
+    FlushPending();
+    RestoreRenderStates();
+    m_inFrame = false;
+
+    m_lastFrameDraws = m_frameDraws;
+    m_lastFrameStateChanges = m_frameStateChanges;
+    m_lastFrameSizeStats = m_frameSizeStats;
+    m_lastFrameReused = m_frameReused;
+    m_lastFrameBuilt = m_frameBuilt;
+    m_lastFramePoints = m_framePoints;
+}
+
+void DX9ParticleRenderer::Render(const std::vector<Particle>& particles,
+                                 int aliveCount,
                                  const float* viewMatrix,
                                  const float* projMatrix,
                                  const float* cameraPos,
                                  const float* emitterPos,
-                                 float scale) {
-
-    // TEMPORARY FIX: Calculate camera right/up vectors for CPU billboarding
-    Matrix4x4 view = Matrix4x4::FromArray(viewMatrix);
-    Vector3f cameraRight(view[0][0], view[1][0], view[2][0]);
-    Vector3f cameraUp(view[0][1], view[1][1], view[2][1]);
-    static int renderCallCount = 0;
+                                 float scale,
+                                 float alphaScale,
+                                 const Color& tint,
+                                 BlendMode blend,
+                                 const std::vector<uint32_t>* drawOrder,
+                                 const RenderModeParams& renderMode,
+                                 int hullVertices) {
     static bool firstRender = true;
 
-    if (!m_initialized || !simulator.IsInitialized()) {
+    if (!m_initialized) {
         return;
     }
 
-    const std::vector<Particle>& particles = simulator.GetParticles();
-    int aliveCount = simulator.GetAliveCount();
-
-    if (aliveCount == 0) {
+    if (aliveCount <= 0) {
         return;
     }
 
@@ -343,169 +692,347 @@ void DX9ParticleRenderer::Render(const CPUParticleSimulator& simulator,
         firstRender = false;
     }
 
-    // Update vertex buffer with particle data, applying world transform
-    // Pass camera vectors for CPU billboarding
-    UpdateVertexBuffer(particles, emitterPos, scale, cameraRight, cameraUp);
+    // Outside BeginFrame/EndFrame every call pays for its own state save
+    const bool ownFrame = !m_inFrame;
+    if (ownFrame) {
+        BeginFrame(viewMatrix, projMatrix, cameraPos);
+    }
 
-    // Setup render states
-    SetupRenderStates();
+    InstanceTransform transform;
+    transform.position = Vector3f(emitterPos[0], emitterPos[1], emitterPos[2]);
+    transform.scale = scale;
+    transform.alphaScale = alphaScale;
+    transform.tint = tint;
+    transform.blend = blend;
+    transform.renderMode = renderMode;
+
+    const ParticleShape& shape = GetParticleShape(hullVertices);
+    const uint32_t stride = ParticleShape::GetStreamVertexCount(shape.vertexCount);
+    transform.shape = shape.PaddedTo(stride);
+    transform.sizeFilter = &m_sizeFilter;
+    transform.sizeStats = &m_frameSizeStats;
+
+    // Alive count is an upper bound; the builder reports what it wrote
+    const ParticleView view = drawOrder ? ParticleView(particles, *drawOrder)
+                                        : ParticleView(particles);
+    const uint32_t capacity = static_cast<uint32_t>(m_maxParticles) * 4 / stride;
+    const uint32_t reserve = std::min(static_cast<uint32_t>(aliveCount), capacity);
+    uint32_t firstVertex = 0;
+    void* data = AllocateVertices(reserve * stride, firstVertex);
+    if (data) {
+        uint32_t written = RenderPacketBuilder::BuildInstance(view, transform, m_frameCamera,
+                                                              m_vertexFormat, data, reserve);
+        m_vertexBuffer->Unlock();
 
-    // Set shaders
-    m_device->SetVertexShader(m_vertexShader);
-    m_device->SetPixelShader(m_pixelShader);
-    m_device->SetVertexDeclaration(m_vertexDeclaration);
+        // Hand the unused tail of the reservation back to the ring
+        m_ringOffset -= (reserve - written) * stride;
+        QueueParticles(firstVertex, written, stride, m_texture, blend);
+        m_frameBuilt += written;
+    }
 
-    // Set shader constants (reuse view matrix from top of function)
-    Matrix4x4 proj = Matrix4x4::FromArray(projMatrix);
-    Matrix4x4 viewProj = Matrix4x4::Multiply(view, proj);
-    m_device->SetVertexShaderConstantF(0, &viewProj.m[0][0], 4);
+    if (ownFrame) {
+        EndFrame();
+    }
+}
 
-    // Camera vectors already calculated at top of function for CPU billboarding
+void DX9ParticleRenderer::RenderPool(const ParticlePool& pool,
+                                     const float* viewMatrix,
+                                     const float* projMatrix,
+                                     const float* cameraPos,
+                                     BlendMode blend) {
+    const uint32_t count = pool.GetCount();
+    if (!m_initialized || (count == 0 && pool.GetPointSprites().empty())) {
+        return;
+    }
 
-    static bool loggedVectors = false;
-    if (!loggedVectors) {
-        char buf[512];
-        sprintf(buf, "[Renderer] View matrix row0: [%.3f, %.3f, %.3f, %.3f]", view[0][0], view[0][1], view[0][2], view[0][3]);
-        LogToFile(buf);
-        sprintf(buf, "[Renderer] View matrix row1: [%.3f, %.3f, %.3f, %.3f]", view[1][0], view[1][1], view[1][2], view[1][3]);
-        LogToFile(buf);
-        sprintf(buf, "[Renderer] View matrix row2: [%.3f, %.3f, %.3f, %.3f]", view[2][0], view[2][1], view[2][2], view[2][3]);
-        LogToFile(buf);
-        sprintf(buf, "[Renderer] Camera right: (%.3f, %.3f, %.3f)", cameraRight.x, cameraRight.y, cameraRight.z);
-        LogToFile(buf);
-        sprintf(buf, "[Renderer] Camera up: (%.3f, %.3f, %.3f)", cameraUp.x, cameraUp.y, cameraUp.z);
-        LogToFile(buf);
+    const bool ownFrame = !m_inFrame;
+    if (ownFrame) {
+        BeginFrame(viewMatrix, projMatrix, cameraPos);
+    }
+    m_frameSizeStats.Add(pool.GetScreenSizeStats());
+
+    // The points are the farthest particles, so even a sorted pool draws
+    // them first
+    DrawPointSprites(pool.GetPointSprites(), blend);
+
+    // One stream for the whole pool, split only where the ring wraps
+    const uint32_t stride = pool.GetVerticesPerParticle();
+    const uint32_t capacity = static_cast<uint32_t>(m_maxParticles) * 4 / stride;
+    for (uint32_t start = 0; start < count; ) {
+        const uint32_t batchCount = std::min(capacity, count - start);
+
+        uint32_t firstVertex = 0;
+        void* data = AllocateVertices(batchCount * stride, firstVertex);
+        if (!data) {
+            break;
+        }
 
-        // Also log first particle position for debugging
-        const std::vector<Particle>& particles = simulator.GetParticles();
-        for (const auto& p : particles) {
-            if (p.alive) {
-                sprintf(buf, "[Renderer] First particle pos: (%.1f, %.1f, %.1f) size: %.1f",
-                        p.position.x, p.position.y, p.position.z, p.size);
-                LogToFile(buf);
-                break;
-            }
+        FillPoolVertices(pool, start, batchCount, data);
+        m_vertexBuffer->Unlock();
+
+        QueueParticles(firstVertex, batchCount, stride, m_texture, blend);
+        start += batchCount;
+    }
+
+    if (ownFrame) {
+        EndFrame();
+    }
+}
+
+void DX9ParticleRenderer::FillPoolVertices(const ParticlePool& pool, uint32_t first, uint32_t count, void* out) {
+    // A sorted pool interleaves its instances: nothing to reuse
+    if (!m_vertexReuse || !pool.GetOrder().empty()) {
+        RenderPacketBuilder::BuildPool(pool, first, count, m_frameCamera, m_vertexFormat, out, m_workers);
+        m_frameBuilt += count;
+        return;
+    }
+
+    const uint32_t stride = pool.GetVerticesPerParticle();
+    const size_t particleBytes = static_cast<size_t>(stride) * GetVertexStride(m_vertexFormat);
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    const uint32_t end = first + count;
+
+    // Changed instances between two cached ones are built in one call, so
+    // they still spread over the workers
+    uint32_t pending = first;
+    auto buildPending = [&](uint32_t upTo) {
+        if (upTo > pending) {
+            RenderPacketBuilder::BuildPool(pool, pending, upTo - pending, m_frameCamera, m_vertexFormat,
+                                           bytes + (pending - first) * particleBytes, m_workers);
+            m_frameBuilt += upTo - pending;
         }
+    };
 
-        loggedVectors = true;
+    for (const ParticlePool::SourceRange& range : pool.GetSourceRanges()) {
+        // Instances split by the ring wrap are built like changed ones
+        if (range.begin < first) {
+            continue;
+        }
+        if (range.begin + range.count > end) {
+            break;
+        }
+        if (!range.packet || !range.packetReused) {
+            continue;
+        }
+
+        VertexCache& cache = range.packet->vertexCache;
+        const size_t rangeBytes = range.count * particleBytes;
+        const bool reusable = cache.generation == m_cacheGeneration &&
+            cache.CanReuse(m_vertexFormat, stride, range.count, m_frameCamera, m_reuseMaxMove, m_reuseMinAxisDot);
+
+        // A moving camera would only keep vertices to throw them away
+        if (!reusable && !m_cameraSteady) {
+            continue;
+        }
+
+        buildPending(range.begin);
+        if (reusable) {
+            m_frameReused += range.count;
+        } else {
+            // Unchanged since its packet was built, so likely to stay that
+            // way: keep what is built for the next views
+            cache.vertices.resize(rangeBytes);
+            RenderPacketBuilder::BuildPool(pool, range.begin, range.count, m_frameCamera, m_vertexFormat,
+                                           cache.vertices.data(), m_workers);
+            cache.particleCount = range.count;
+            cache.verticesPerParticle = stride;
+            cache.format = m_vertexFormat;
+            cache.orientationDependent = m_vertexFormat == VertexFormat::Expanded || range.oriented;
+            cache.camera = m_frameCamera;
+            cache.generation = m_cacheGeneration;
+            cache.valid = true;
+            m_frameBuilt += range.count;
+        }
+
+        std::memcpy(bytes + (range.begin - first) * particleBytes, cache.vertices.data(), rangeBytes);
+        pending = range.begin + range.count;
     }
+    buildPending(end);
+}
 
-    m_device->SetVertexShaderConstantF(4, &cameraRight.x, 1);
-    m_device->SetVertexShaderConstantF(5, &cameraUp.x, 1);
+void DX9ParticleRenderer::DrawPointSprites(const std::vector<PointSpriteVertex>& points, BlendMode blend) {
+    const uint32_t count = static_cast<uint32_t>(points.size());
+    if (count == 0 || !m_pointBuffer) {
+        return;
+    }
 
-    // Set texture
-    m_device->SetTexture(0, m_texture);
+    // Their own stream and shader: whatever is queued from the other one goes first
+    FlushPending();
+    ApplyDrawState(m_texture, blend);
+    SetRenderStateCached(D3DRS_POINTSPRITEENABLE, TRUE);
+    SetRenderStateCached(D3DRS_POINTSCALEENABLE, FALSE);
+    m_device->SetVertexShader(m_pointVertexShader);
+    m_device->SetVertexDeclaration(m_pointDeclaration);
+    m_device->SetStreamSource(0, m_pointBuffer, 0, sizeof(PointSpriteVertex));
+
+    // Same ring scheme as AllocateVertices
+    const uint32_t capacity = static_cast<uint32_t>(m_maxParticles);
+    for (uint32_t start = 0; start < count; ) {
+        const uint32_t batchCount = std::min(capacity, count - start);
+
+        DWORD flags = D3DLOCK_NOOVERWRITE;
+        if (m_pointRingOffset + batchCount > capacity) {
+            m_pointRingOffset = 0;
+            flags = D3DLOCK_DISCARD;
+        }
 
-    // Set vertex buffer and draw
-    m_device->SetStreamSource(0, m_vertexBuffer, 0, sizeof(ParticleVertex));
-    m_device->DrawPrimitive(D3DPT_TRIANGLELIST, 0, aliveCount * 2); // 2 triangles per particle
+        void* data = nullptr;
+        if (FAILED(m_pointBuffer->Lock(m_pointRingOffset * sizeof(PointSpriteVertex),
+                                       batchCount * sizeof(PointSpriteVertex), &data, flags)) || !data) {
+            break;
+        }
+        std::memcpy(data, points.data() + start, batchCount * sizeof(PointSpriteVertex));
+        m_pointBuffer->Unlock();
 
-    // Restore render states
-    RestoreRenderStates();
+        m_device->DrawPrimitive(D3DPT_POINTLIST, m_pointRingOffset, batchCount);
+        m_frameDraws++;
+        m_framePoints += batchCount;
+
+        m_pointRingOffset += batchCount;
+        start += batchCount;
+    }
+
+    m_device->SetVertexShader(GetParticleVertexShader());
+    m_device->SetVertexDeclaration(GetParticleDeclaration());
+    m_device->SetStreamSource(0, m_vertexBuffer, 0, GetVertexStride(m_vertexFormat));
 }
 
-void DX9ParticleRenderer::UpdateVertexBuffer(const std::vector<Particle>& particles,
-                                              const float* emitterPos,
-                                              float scale,
-                                              const Vector3f& cameraRight,
-                                              const Vector3f& cameraUp) {
-    void* data = nullptr;
-    HRESULT hr = m_vertexBuffer->Lock(0, 0, &data, D3DLOCK_DISCARD);
+void* DX9ParticleRenderer::AllocateVertices(uint32_t vertexCount, uint32_t& firstVertex) {
+    const uint32_t capacity = static_cast<uint32_t>(m_maxParticles) * 4;
+    const uint32_t vertexStride = GetVertexStride(m_vertexFormat);
+
+    // Append after the data the GPU may still be reading; start over with a
+    // fresh buffer only when the ring is full
+    DWORD flags = D3DLOCK_NOOVERWRITE;
+    if (m_ringOffset + vertexCount > capacity) {
+        FlushPending();
+        m_ringOffset = 0;
+        flags = D3DLOCK_DISCARD;
+    }
 
+    void* data = nullptr;
+    HRESULT hr = m_vertexBuffer->Lock(m_ringOffset * vertexStride, vertexCount * vertexStride, &data, flags);
     if (FAILED(hr) || !data) {
+        return nullptr;
+    }
+
+    firstVertex = m_ringOffset;
+    m_ringOffset += vertexCount;
+    return data;
+}
+
+void DX9ParticleRenderer::SetVertexReuseThreshold(float maxCameraMove, float maxCameraAngle) {
+    m_reuseMaxMove = std::max(0.0f, maxCameraMove);
+    m_reuseMinAxisDot = std::cos(std::max(0.0f, std::min(180.0f, maxCameraAngle)) * 3.14159f / 180.0f);
+}
+
+void DX9ParticleRenderer::QueueParticles(uint32_t firstVertex,
+                                         uint32_t particleCount,
+                                         uint32_t verticesPerParticle,
+                                         IDirect3DBaseTexture9* texture,
+                                         BlendMode blend) {
+    if (particleCount == 0) {
+        return;
+    }
+
+    // Consecutive particles with the same texture, blend and outline size
+    // become one draw
+    if (m_pending.particleCount > 0 &&
+        m_pending.texture == texture && m_pending.blend == blend &&
+        m_pending.verticesPerParticle == verticesPerParticle &&
+        m_pending.firstVertex + m_pending.particleCount * verticesPerParticle == firstVertex) {
+        m_pending.particleCount += particleCount;
         return;
     }
 
-    ParticleVertex* vertices = static_cast<ParticleVertex*>(data);
-    int vertexIndex = 0;
+    FlushPending();
+    m_pending.firstVertex = firstVertex;
+    m_pending.particleCount = particleCount;
+    m_pending.verticesPerParticle = verticesPerParticle;
+    m_pending.texture = texture;
+    m_pending.blend = blend;
+}
 
-    // Extract emitter position
-    Vector3f emitterPosition(emitterPos[0], emitterPos[1], emitterPos[2]);
+void DX9ParticleRenderer::FlushPending() {
+    if (m_pending.particleCount == 0) {
+        return;
+    }
 
-    static int particlesLogged = 0;
-    const int maxParticlesToLog = 5; // Log first 5 particles for debugging
+    ApplyDrawState(m_pending.texture, m_pending.blend);
+    DrawParticles(m_pending.firstVertex, m_pending.particleCount, m_pending.verticesPerParticle);
+    m_frameDraws++;
 
-    // For each alive particle, generate 4 vertices (2 triangles)
-    for (const auto& p : particles) {
-        if (!p.alive) {
-            continue;
+    m_pending.particleCount = 0;
+}
+
+void DX9ParticleRenderer::ApplyDrawState(IDirect3DBaseTexture9* texture, BlendMode blend) {
+    // Redundant-state filter: only touch the device when something changed
+    if (texture != m_boundTexture) {
+        m_device->SetTexture(0, texture);
+        m_boundTexture = texture;
+        m_frameStateChanges++;
+    }
+
+    if (blend != m_boundBlend) {
+        switch (blend) {
+            case BlendMode::Additive:
+                SetRenderStateCached(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+                SetRenderStateCached(D3DRS_DESTBLEND, D3DBLEND_ONE);
+                break;
+            case BlendMode::Premultiplied:
+                SetRenderStateCached(D3DRS_SRCBLEND, D3DBLEND_ONE);
+                SetRenderStateCached(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+                break;
+            case BlendMode::Alpha:
+            default:
+                SetRenderStateCached(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+                SetRenderStateCached(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+                break;
         }
+        m_boundBlend = blend;
+    }
+}
 
-        // Apply emitter position to particle position (world transform)
-        Vector3f pos(
-            p.position.x + emitterPosition.x,
-            p.position.y + emitterPosition.y,
-            p.position.z + emitterPosition.z
-        );
-
-        D3DCOLOR color = D3DCOLOR_COLORVALUE(p.color.r, p.color.g, p.color.b, p.color.a);
-
-        // Apply scale to particle size
-        Vector2f sizeRot(p.size * scale, p.rotation);
-
-        // Log first few particles for debugging
-        if (particlesLogged < maxParticlesToLog) {
-            char buf[512];
-            sprintf(buf, "[UpdateVB #%d] Particle: local(%.1f,%.1f,%.1f) + emitter(%.1f,%.1f,%.1f) = world(%.1f,%.1f,%.1f), size=%.1f*%.2f=%.1f",
-                    particlesLogged + 1,
-                    p.position.x, p.position.y, p.position.z,
-                    emitterPosition.x, emitterPosition.y, emitterPosition.z,
-                    pos.x, pos.y, pos.z,
-                    p.size, scale, sizeRot.x);
-            LogToFile(buf);
-
-            // Log the 4 corner vertices
-            sprintf(buf, "[UpdateVB #%d] Quad corners:", particlesLogged + 1);
-            LogToFile(buf);
-            sprintf(buf, "[UpdateVB #%d]   Corner 0: pos(%.1f,%.1f,%.1f) corner(-1,-1) size=%.1f", particlesLogged + 1, pos.x, pos.y, pos.z, sizeRot.x);
-            LogToFile(buf);
-            sprintf(buf, "[UpdateVB #%d]   Corner 1: pos(%.1f,%.1f,%.1f) corner(+1,-1) size=%.1f", particlesLogged + 1, pos.x, pos.y, pos.z, sizeRot.x);
-            LogToFile(buf);
-            sprintf(buf, "[UpdateVB #%d]   Corner 2: pos(%.1f,%.1f,%.1f) corner(+1,+1) size=%.1f", particlesLogged + 1, pos.x, pos.y, pos.z, sizeRot.x);
-            LogToFile(buf);
-            sprintf(buf, "[UpdateVB #%d]   Corner 3: pos(%.1f,%.1f,%.1f) corner(-1,+1) size=%.1f", particlesLogged + 1, pos.x, pos.y, pos.z, sizeRot.x);
-            LogToFile(buf);
-
-            particlesLogged++;
+void DX9ParticleRenderer::SetRenderStateCached(D3DRENDERSTATETYPE state, DWORD value) {
+    for (CachedRenderState& cached : m_stateCache) {
+        if (cached.state == state) {
+            if (cached.value != value) {
+                m_device->SetRenderState(state, value);
+                cached.value = value;
+                m_frameStateChanges++;
+            }
+            return;
         }
+    }
 
-        // CPU BILLBOARDING: Expand corners using camera vectors
-        float finalSize = sizeRot.x; // Already includes scale
-
-        // Calculate the 4 actual corner positions in world space
-        Vector3f bottomLeft = Vector3f(
-            pos.x + cameraRight.x * (-finalSize) + cameraUp.x * (-finalSize),
-            pos.y + cameraRight.y * (-finalSize) + cameraUp.y * (-finalSize),
-            pos.z + cameraRight.z * (-finalSize) + cameraUp.z * (-finalSize)
-        );
-        Vector3f bottomRight = Vector3f(
-            pos.x + cameraRight.x * (finalSize) + cameraUp.x * (-finalSize),
-            pos.y + cameraRight.y * (finalSize) + cameraUp.y * (-finalSize),
-            pos.z + cameraRight.z * (finalSize) + cameraUp.z * (-finalSize)
-        );
-        Vector3f topRight = Vector3f(
-            pos.x + cameraRight.x * (finalSize) + cameraUp.x * (finalSize),
-            pos.y + cameraRight.y * (finalSize) + cameraUp.y * (finalSize),
-            pos.z + cameraRight.z * (finalSize) + cameraUp.z * (finalSize)
-        );
-        Vector3f topLeft = Vector3f(
-            pos.x + cameraRight.x * (-finalSize) + cameraUp.x * (finalSize),
-            pos.y + cameraRight.y * (-finalSize) + cameraUp.y * (finalSize),
-            pos.z + cameraRight.z * (-finalSize) + cameraUp.z * (finalSize)
-        );
-
-        // Triangle 1: bottom-left, bottom-right, top-right
-        vertices[vertexIndex++] = {bottomLeft, color, sizeRot, Vector2f(0, 1)};   // UV: bottom-left
-        vertices[vertexIndex++] = {bottomRight, color, sizeRot, Vector2f(1, 1)};  // UV: bottom-right
-        vertices[vertexIndex++] = {topRight, color, sizeRot, Vector2f(1, 0)};     // UV: top-right
-
-        // Triangle 2: bottom-left, top-right, top-left
-        vertices[vertexIndex++] = {bottomLeft, color, sizeRot, Vector2f(0, 1)};   // UV: bottom-left
-        vertices[vertexIndex++] = {topRight, color, sizeRot, Vector2f(1, 0)};     // UV: top-right
-        vertices[vertexIndex++] = {topLeft, color, sizeRot, Vector2f(0, 0)};      // UV: top-left
-    }
-
-    m_vertexBuffer->Unlock();
+    m_device->SetRenderState(state, value);
+    m_stateCache.push_back({ state, value });
+    m_frameStateChanges++;
+}
+
+void DX9ParticleRenderer::SetCameraConstants(const CameraData& camera) {
+    // c4/c5 are float4 registers; w is unused
+    const float right[4] = { camera.right.x, camera.right.y, camera.right.z, 0.0f };
+    const float up[4] = { camera.up.x, camera.up.y, camera.up.z, 0.0f };
+    m_device->SetVertexShaderConstantF(4, right, 1);
+    m_device->SetVertexShaderConstantF(5, up, 1);
+}
+
+void DX9ParticleRenderer::DrawParticles(uint32_t firstVertex, uint32_t particleCount, uint32_t verticesPerParticle) {
+    // 16-bit indices reach GetMaxParticlesPerDraw particles; larger runs are
+    // split and each chunk offsets the base vertex into the stream
+    const uint32_t chunkSize = RenderPacketBuilder::GetMaxParticlesPerDraw(verticesPerParticle);
+    const uint32_t trianglesPerParticle = verticesPerParticle - 2;
+
+    for (uint32_t done = 0; done < particleCount; done += chunkSize) {
+        const uint32_t chunkCount = std::min(chunkSize, particleCount - done);
+        const INT baseVertex = static_cast<INT>(firstVertex + done * verticesPerParticle);
+
+        m_device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, baseVertex, 0,
+                                       chunkCount * verticesPerParticle,
+                                       m_fanIndexStart[verticesPerParticle],
+                                       chunkCount * trianglesPerParticle);
+    }
 }
 
 void DX9ParticleRenderer::SetupRenderStates() {
@@ -521,6 +1048,8 @@ void DX9ParticleRenderer::SetupRenderStates() {
     m_device->GetRenderState(D3DRS_ZENABLE, &m_savedZEnable);
     m_device->GetRenderState(D3DRS_ZWRITEENABLE, &m_savedZWriteEnable);
     m_device->GetRenderState(D3DRS_CULLMODE, &m_savedCullMode);
+    m_device->GetRenderState(D3DRS_POINTSPRITEENABLE, &m_savedPointSpriteEnable);
+    m_device->GetRenderState(D3DRS_POINTSCALEENABLE, &m_savedPointScaleEnable);
 
     // Save current shader states (CRITICAL for GMod compatibility!)
     m_device->GetVertexShader(&m_savedVertexShader);
@@ -528,6 +1057,7 @@ void DX9ParticleRenderer::SetupRenderStates() {
     m_device->GetVertexDeclaration(&m_savedVertexDeclaration);
     m_device->GetTexture(0, &m_savedTexture);
     m_device->GetStreamSource(0, &m_savedStreamSource, &m_savedStreamOffset, &m_savedStreamStride);
+    m_device->GetIndices(&m_savedIndices);
 
     // CRITICAL: Save vertex shader constants that we will overwrite (0-5)
     // This is what was causing the black screen!
@@ -543,13 +1073,25 @@ void DX9ParticleRenderer::SetupRenderStates() {
         firstCall = false;
     }
 
+    // The saved values are what the device holds now, so the cache can
+    // skip any state the game already had set the way we want it
+    m_stateCache.clear();
+    m_stateCache.push_back({ D3DRS_ALPHABLENDENABLE, m_savedAlphaBlendEnable });
+    m_stateCache.push_back({ D3DRS_SRCBLEND, m_savedSrcBlend });
+    m_stateCache.push_back({ D3DRS_DESTBLEND, m_savedDestBlend });
+    m_stateCache.push_back({ D3DRS_ZENABLE, m_savedZEnable });
+    m_stateCache.push_back({ D3DRS_ZWRITEENABLE, m_savedZWriteEnable });
+    m_stateCache.push_back({ D3DRS_CULLMODE, m_savedCullMode });
+    m_stateCache.push_back({ D3DRS_POINTSPRITEENABLE, m_savedPointSpriteEnable });
+    m_stateCache.push_back({ D3DRS_POINTSCALEENABLE, m_savedPointScaleEnable });
+
     // Set particle render states
-    m_device->SetRenderState(D3DRS_ALPHABLENDENABLE, TRUE);
-    m_device->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
-    m_device->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
-    m_device->SetRenderState(D3DRS_ZENABLE, FALSE);  // Disable depth testing completely
-    m_device->SetRenderState(D3DRS_ZWRITEENABLE, FALSE);  // No depth writes for transparency
-    m_device->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+    SetRenderStateCached(D3DRS_ALPHABLENDENABLE, TRUE);
+    SetRenderStateCached(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+    SetRenderStateCached(D3DRS_DESTBLEND, D3DBLEND_INVSRCALPHA);
+    SetRenderStateCached(D3DRS_ZENABLE, FALSE);  // Disable depth testing completely
+    SetRenderStateCached(D3DRS_ZWRITEENABLE, FALSE);  // No depth writes for transparency
+    SetRenderStateCached(D3DRS_CULLMODE, D3DCULL_NONE);
 }
 
 void DX9ParticleRenderer::RenderTestQuad(const float* worldPos,
@@ -643,6 +1185,8 @@ void DX9ParticleRenderer::RestoreRenderStates() {
     m_device->SetRenderState(D3DRS_ZENABLE, m_savedZEnable);
     m_device->SetRenderState(D3DRS_ZWRITEENABLE, m_savedZWriteEnable);
     m_device->SetRenderState(D3DRS_CULLMODE, m_savedCullMode);
+    m_device->SetRenderState(D3DRS_POINTSPRITEENABLE, m_savedPointSpriteEnable);
+    m_device->SetRenderState(D3DRS_POINTSCALEENABLE, m_savedPointScaleEnable);
 
     // Restore shader states (CRITICAL for GMod compatibility!)
     m_device->SetVertexShader(m_savedVertexShader);
@@ -650,6 +1194,7 @@ void DX9ParticleRenderer::RestoreRenderStates() {
     m_device->SetVertexDeclaration(m_savedVertexDeclaration);
     m_device->SetTexture(0, m_savedTexture);
     m_device->SetStreamSource(0, m_savedStreamSource, m_savedStreamOffset, m_savedStreamStride);
+    m_device->SetIndices(m_savedIndices);
 
     // CRITICAL: Restore vertex shader constants that we overwrote (0-5)
     // This fixes the black screen!
@@ -682,6 +1227,10 @@ void DX9ParticleRenderer::RestoreRenderStates() {
         m_savedStreamSource->Release();
         m_savedStreamSource = nullptr;
     }
+    if (m_savedIndices) {
+        m_savedIndices->Release();
+        m_savedIndices = nullptr;
+    }
 }
 
 void DX9ParticleRenderer::RenderTest2D(float screenX, float screenY, float pixelSize) {
@@ -741,7 +1290,7 @@ void DX9ParticleRenderer::RenderTest2D(float screenX, float screenY, float pixel
 
     // Create a quad using ParticleVertex format (for shaders)
     ParticleVertex quad[6];
-    D3DCOLOR testColor = D3DCOLOR_RGBA(255, 0, 0, 255); // Bright red
+    uint32_t testColor = D3DCOLOR_RGBA(255, 0, 0, 255); // Bright red
 
     float halfSize = pixelSize * 0.5f;
     float left = screenX - halfSize;
@@ -885,7 +1434,7 @@ void DX9ParticleRenderer::RenderTest3D(const float* worldPos, float size,
         center.z + cameraRight.z * (-halfSize) + cameraUp.z * halfSize
     );
 
-    D3DCOLOR testColor = D3DCOLOR_RGBA(255, 0, 0, 255); // Bright red
+    uint32_t testColor = D3DCOLOR_RGBA(255, 0, 0, 255); // Bright red
     ParticleVertex quad[6];
 
     // Triangle 1
@@ -991,7 +1540,7 @@ void DX9ParticleRenderer::RenderTest3DSourceMatrices(const float* worldPos, floa
         center.z + cameraRight.z * (-halfSize) + cameraUp.z * halfSize
     );
 
-    D3DCOLOR testColor = D3DCOLOR_RGBA(255, 0, 0, 255);
+    uint32_t testColor = D3DCOLOR_RGBA(255, 0, 0, 255);
     ParticleVertex quad[6];
     quad[0] = {bottomLeft, testColor, Vector2f(size, 0), Vector2f(0, 1)};
     quad[1] = {bottomRight, testColor, Vector2f(size, 0), Vector2f(1, 1)};
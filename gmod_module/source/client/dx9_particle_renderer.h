@@ -1,81 +1,19 @@
 #pragma once
 
 #include "dx9_context.h"
-#include "cpu_particle_simulator.h"
+#include "particle_pool.h"
+#include "render_packet.h"
 #include <d3d9.h>
 #include <d3dcompiler.h>
+#include <algorithm>
 #include <vector>
 #include <string>
 
 namespace GPUParticles {
 
-// Simple vector structures to replace D3DX types
-struct Vector3f {
-    float x, y, z;
-    Vector3f() : x(0), y(0), z(0) {}
-    Vector3f(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
-};
-
-struct Vector2f {
-    float x, y;
-    Vector2f() : x(0), y(0) {}
-    Vector2f(float _x, float _y) : x(_x), y(_y) {}
-};
-
-// Simple 4x4 matrix structure to replace D3DXMATRIX
-struct Matrix4x4 {
-    float m[4][4];
-
-    Matrix4x4() {
-        // Identity matrix
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                m[i][j] = (i == j) ? 1.0f : 0.0f;
-            }
-        }
-    }
-
-    // Access operator
-    float* operator[](int row) { return m[row]; }
-    const float* operator[](int row) const { return m[row]; }
-
-    // Multiply two matrices
-    static Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b) {
-        Matrix4x4 result;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                result.m[i][j] = 0;
-                for (int k = 0; k < 4; k++) {
-                    result.m[i][j] += a.m[i][k] * b.m[k][j];
-                }
-            }
-        }
-        return result;
-    }
-
-    // Create from float array (row-major)
-    static Matrix4x4 FromArray(const float* arr) {
-        Matrix4x4 result;
-        for (int i = 0; i < 4; i++) {
-            for (int j = 0; j < 4; j++) {
-                result.m[i][j] = arr[i * 4 + j];
-            }
-        }
-        return result;
-    }
-};
-
-/**
- * @brief Vertex format for particle rendering
- */
-struct ParticleVertex {
-    Vector3f position;       // Particle center
-    D3DCOLOR color;          // RGBA color
-    Vector2f sizeRot;        // x=size, y=rotation
-    Vector2f corner;         // Corner offset (-1 to 1)
+// Flexible vertex format matching ParticleVertex
+static const DWORD kParticleVertexFVF = D3DFVF_XYZ | D3DFVF_DIFFUSE | D3DFVF_TEX2;
 
-    static const DWORD FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE | D3DFVF_TEX2;
-};
 
 /**
  * @brief DirectX 9 particle renderer
@@ -104,21 +42,139 @@ public:
      */
     bool IsInitialized() const { return m_initialized; }
 
+    /**
+     * @brief Start batching particle draws for a frame
+     *
+     * Saves the game's render state once and binds everything shared by
+     * all particle draws. Render/RenderPool calls until EndFrame append to
+     * one ring-buffered vertex stream, and consecutive draws with the same
+     * texture and blend mode are merged into one DrawIndexedPrimitive.
+     * Outside a frame each Render/RenderPool call brackets itself.
+     */
+    void BeginFrame(const float* viewMatrix,
+                    const float* projMatrix,
+                    const float* cameraPos);
+
+    /**
+     * @brief Flush the pending draw and restore the game's render state
+     */
+    void EndFrame();
+
     /**
      * @brief Render particles
-     * @param simulator Particle simulator with particle data
+     * @param particles Particle slots of a simulator or of a snapshot of one
+     * @param aliveCount Alive particles among the slots
      * @param viewMatrix View matrix
      * @param projMatrix Projection matrix
      * @param cameraPos Camera position
      * @param emitterPos World position of the particle emitter
      * @param scale Scale multiplier for particle sizes
+     * @param alphaScale Alpha multiplier (budget compensation)
+     * @param tint Per-instance color multiplier
+     * @param blend Framebuffer blending
+     * @param drawOrder Particle slots in draw order (nullptr = storage order)
+     * @param renderMode Quad orientation of the effect
+     * @param hullVertices Corners of the alpha-trimmed outline (0 = full quad)
      */
-    void Render(const CPUParticleSimulator& simulator,
+    void Render(const std::vector<Particle>& particles,
+                int aliveCount,
                 const float* viewMatrix,
                 const float* projMatrix,
                 const float* cameraPos,
                 const float* emitterPos,
-                float scale);
+                float scale,
+                float alphaScale = 1.0f,
+                const Color& tint = Color(1, 1, 1, 1),
+                BlendMode blend = BlendMode::Alpha,
+                const std::vector<uint32_t>* drawOrder = nullptr,
+                const RenderModeParams& renderMode = RenderModeParams(),
+                int hullVertices = 0);
+
+    /**
+     * @brief Render a whole particle pool in its sorted order
+     * @param pool World-space particles of all visible instances
+     * @param viewMatrix View matrix
+     * @param projMatrix Projection matrix
+     * @param cameraPos Camera position
+     * @param blend Framebuffer blending
+     */
+    void RenderPool(const ParticlePool& pool,
+                    const float* viewMatrix,
+                    const float* projMatrix,
+                    const float* cameraPos,
+                    BlendMode blend = BlendMode::Alpha);
+
+    /**
+     * @brief Outline that trims the particle texture's transparent border
+     *
+     * Computed from the texture's alpha at load time, one per corner limit.
+     * @param hullVertices Corner limit, 4 to 8 (anything else = full quad)
+     */
+    const ParticleShape& GetParticleShape(int hullVertices) const;
+
+    /**
+     * @brief Particles narrower than this many pixels are merged (0 = off)
+     *
+     * See ScreenSizeFilter. The effects' min/maxParticleSize apply either way.
+     */
+    void SetSubPixelThreshold(float pixels) {
+        m_sizeFilter.SetMinPixelSize(std::max(0.0f, pixels));
+        m_cacheGeneration++;
+    }
+
+    /**
+     * @brief Fraction of particles drawn in the views that follow (1 = all)
+     *
+     * Set per view, e.g. lower for reflections. See ScreenSizeFilter::SetDetail.
+     */
+    void SetViewDetail(float fraction) { m_sizeFilter.SetDetail(fraction); }
+
+    /**
+     * @brief Pool particles narrower than this many pixels are drawn as point sprites (0 = off)
+     *
+     * One 16-byte vertex per particle from a separate stream instead of a
+     * billboard. Ignored when the device cannot draw point sprites of
+     * PointSpriteVertex::kMaxPixels. See ScreenSizeFilter::SetPointSpriteSize.
+     */
+    void SetPointSpriteSize(float pixels) {
+        m_sizeFilter.SetPointSpriteSize(m_pointVertexShader ? pixels : 0.0f);
+        m_cacheGeneration++;
+    }
+
+    /**
+     * @brief Let RenderPool draw unchanged instances from their cached vertices
+     *
+     * Applies to unsorted pools filled with packets (see ParticlePacket);
+     * a sorted queue interleaves its instances and is always rebuilt. Set
+     * per view: views that should neither use nor replace the main view's
+     * vertices, such as reflections, turn it off.
+     */
+    void SetVertexReuse(bool enabled) { m_vertexReuse = enabled; }
+
+    /**
+     * @brief How far the camera may move from the view cached vertices were built for
+     * @param maxCameraMove World units
+     * @param maxCameraAngle Degrees, for CPU billboards and oriented quads only
+     */
+    void SetVertexReuseThreshold(float maxCameraMove, float maxCameraAngle);
+
+    /**
+     * @brief Screen-size rules of the current frame, for filling a ParticlePool
+     */
+    const ScreenSizeFilter& GetScreenSizeFilter() const { return m_sizeFilter; }
+
+    /**
+     * @brief Threads used to fill the vertex buffer (nullptr = render thread only)
+     */
+    void SetWorkerPool(WorkerPool* workers) { m_workers = workers; }
+
+    // Statistics from the last frame
+    int GetLastDrawCalls() const { return m_lastFrameDraws; }
+    int GetLastStateChanges() const { return m_lastFrameStateChanges; }
+    const ScreenSizeStats& GetLastScreenSizeStats() const { return m_lastFrameSizeStats; }
+    uint32_t GetLastReusedParticles() const { return m_lastFrameReused; }  // Drawn from cached vertices
+    uint32_t GetLastBuiltParticles() const { return m_lastFrameBuilt; }    // Written from particle data
+    uint32_t GetLastPointSprites() const { return m_lastFramePoints; }     // Drawn as point sprites
 
     /**
      * @brief Test render - draw a simple quad without billboarding
@@ -178,29 +234,110 @@ public:
 private:
     // Initialization helpers
     bool LoadShaders();
+    bool CompileVertexShader(const char* source,
+                             const D3D_SHADER_MACRO* defines,
+                             IDirect3DVertexShader9** shader);
     bool CreateVertexBuffer();
+    bool CreatePointSprites();
+    bool CreateIndexBuffer();
     bool CreateTexture();
+    void ComputeParticleShapes(const uint8_t* alpha, int size, int texelStride, int rowStride);
 
     // Rendering helpers
-    void UpdateVertexBuffer(const std::vector<Particle>& particles,
-                           const float* emitterPos,
-                           float scale,
-                           const Vector3f& cameraRight,
-                           const Vector3f& cameraUp);
+    void* AllocateVertices(uint32_t vertexCount, uint32_t& firstVertex);
+    void FillPoolVertices(const ParticlePool& pool, uint32_t first, uint32_t count, void* out);
+    void DrawPointSprites(const std::vector<PointSpriteVertex>& points, BlendMode blend);
+    void QueueParticles(uint32_t firstVertex, uint32_t particleCount, uint32_t verticesPerParticle,
+                        IDirect3DBaseTexture9* texture, BlendMode blend);
+    void FlushPending();
+    void ApplyDrawState(IDirect3DBaseTexture9* texture, BlendMode blend);
+    void SetRenderStateCached(D3DRENDERSTATETYPE state, DWORD value);
+    void DrawParticles(uint32_t firstVertex, uint32_t particleCount, uint32_t verticesPerParticle);
     void SetupRenderStates();
     void RestoreRenderStates();
 
+    void SetCameraConstants(const CameraData& camera);
+
+    // Shader and declaration matching m_vertexFormat
+    IDirect3DVertexShader9* GetParticleVertexShader() const {
+        return (m_vertexFormat == VertexFormat::Expanded) ? m_vertexShader : m_billboardVertexShader;
+    }
+    IDirect3DVertexDeclaration9* GetParticleDeclaration() const {
+        return (m_vertexFormat == VertexFormat::Compact) ? m_compactDeclaration : m_vertexDeclaration;
+    }
+
     // Resources
     DX9Context* m_context;
     IDirect3DDevice9* m_device;
     IDirect3DVertexBuffer9* m_vertexBuffer;
+    IDirect3DIndexBuffer9* m_indexBuffer;   // Static fan patterns of 4, 6 and 8 corners
     IDirect3DTexture9* m_texture;
-    IDirect3DVertexShader9* m_vertexShader;
+    IDirect3DVertexShader9* m_vertexShader;           // Passthrough, test quads and CPU billboards
     IDirect3DPixelShader9* m_pixelShader;
     IDirect3DVertexDeclaration9* m_vertexDeclaration;
+    IDirect3DVertexShader9* m_billboardVertexShader;  // Expands particle quads (both formats)
+    IDirect3DVertexDeclaration9* m_compactDeclaration;
+    IDirect3DVertexBuffer9* m_pointBuffer;            // Point sprites, m_maxParticles of them
+    IDirect3DVertexShader9* m_pointVertexShader;      // Null when point sprites are unsupported
+    IDirect3DVertexDeclaration9* m_pointDeclaration;
 
     // State
-    int m_maxParticles;
+    VertexFormat m_vertexFormat;  // Chosen at init from the device caps
+    WorkerPool* m_workers;
+    int m_maxParticles;           // In full quads; trimmed outlines fit fewer
+    uint32_t m_fanIndexStart[ParticleShape::kMaxVertices + 1];  // By corners per particle
+
+    // Outlines of m_texture by corner limit; below 4 is the full quad
+    ParticleShape m_shapes[ParticleShape::kMaxVertices + 1];
+
+    // Particles queued for one draw, merged while texture, blend and
+    // outline size match
+    struct PendingDraw {
+        uint32_t firstVertex;
+        uint32_t particleCount;
+        uint32_t verticesPerParticle;
+        IDirect3DBaseTexture9* texture;
+        BlendMode blend;
+
+        PendingDraw() : firstVertex(0), particleCount(0), verticesPerParticle(4),
+                        texture(nullptr), blend(BlendMode::Alpha) {}
+    };
+
+    struct CachedRenderState {
+        D3DRENDERSTATETYPE state;
+        DWORD value;
+    };
+
+    // Frame batching
+    uint32_t m_ringOffset;        // Next free vertex in the vertex buffer
+    uint32_t m_pointRingOffset;   // Next free vertex in the point buffer
+    bool m_inFrame;
+    CameraData m_frameCamera;
+    ScreenSizeFilter m_sizeFilter;
+    ScreenSizeStats m_frameSizeStats;
+    ScreenSizeStats m_lastFrameSizeStats;
+    PendingDraw m_pending;
+
+    // Per-instance vertex reuse (see SetVertexReuse)
+    bool m_vertexReuse;
+    float m_reuseMaxMove;
+    float m_reuseMinAxisDot;      // Cosine of the angle limit
+    uint32_t m_cacheGeneration;   // Bumped by settings that change vertices
+    CameraData m_reuseCamera;     // Last view with reuse on
+    bool m_cameraSteady;          // This view is within the limits of that one
+    uint32_t m_frameReused;
+    uint32_t m_frameBuilt;
+    uint32_t m_lastFrameReused;
+    uint32_t m_lastFrameBuilt;
+    uint32_t m_framePoints;
+    uint32_t m_lastFramePoints;
+    IDirect3DBaseTexture9* m_boundTexture;
+    BlendMode m_boundBlend;
+    std::vector<CachedRenderState> m_stateCache;
+    int m_frameDraws;
+    int m_frameStateChanges;
+    int m_lastFrameDraws;
+    int m_lastFrameStateChanges;
     bool m_initialized;
     std::string m_lastError;
 
@@ -211,6 +348,8 @@ private:
     DWORD m_savedZEnable;
     DWORD m_savedZWriteEnable;
     DWORD m_savedCullMode;
+    DWORD m_savedPointSpriteEnable;
+    DWORD m_savedPointScaleEnable;
 
     // Saved shader states
     IDirect3DVertexShader9* m_savedVertexShader;
@@ -220,6 +359,7 @@ private:
     IDirect3DVertexBuffer9* m_savedStreamSource;
     UINT m_savedStreamOffset;
     UINT m_savedStreamStride;
+    IDirect3DIndexBuffer9* m_savedIndices;
 
     // Saved shader constants (we overwrite constants 0-5)
     float m_savedVSConstants[6 * 4]; // 6 float4 constants = 24 floats
@@ -0,0 +1,184 @@
+#include "instance_spatial_hash.h"
+#include <algorithm>
+#include <cmath>
+
+namespace GPUParticles {
+
+// Cell coordinates are packed into 21 bits per axis
+static const int kCoordBits = 21;
+static const uint64_t kCoordMask = (1ull << kCoordBits) - 1;
+
+InstanceSpatialHash::InstanceSpatialHash()
+    : m_cellSize(512.0f)
+    , m_invCellSize(1.0f / 512.0f)
+{
+}
+
+void InstanceSpatialHash::SetCellSize(float size) {
+    size = std::max(1.0f, size);
+    if (size == m_cellSize) {
+        return;
+    }
+
+    m_cellSize = size;
+    m_invCellSize = 1.0f / size;
+
+    // Re-bucket everything with the new size
+    m_cells.clear();
+    for (auto& pair : m_entries) {
+        AddToCell(pair.first, pair.second);
+    }
+}
+
+int InstanceSpatialHash::CellCoord(float value) const {
+    return static_cast<int>(std::floor(value * m_invCellSize));
+}
+
+uint64_t InstanceSpatialHash::CellKey(int x, int y, int z) const {
+    return ((static_cast<uint64_t>(x) & kCoordMask) << (2 * kCoordBits)) |
+           ((static_cast<uint64_t>(y) & kCoordMask) << kCoordBits) |
+           (static_cast<uint64_t>(z) & kCoordMask);
+}
+
+void InstanceSpatialHash::AddToCell(int id, Entry& entry) {
+    entry.cell = CellKey(CellCoord(entry.position.x), CellCoord(entry.position.y), CellCoord(entry.position.z));
+
+    std::vector<int>& ids = m_cells[entry.cell];
+    entry.slot = ids.size();
+    ids.push_back(id);
+}
+
+void InstanceSpatialHash::RemoveFromCell(const Entry& entry) {
+    auto cellIt = m_cells.find(entry.cell);
+    if (cellIt == m_cells.end()) {
+        return;
+    }
+
+    // Swap-remove, fixing up the slot of the id moved into the hole
+    std::vector<int>& ids = cellIt->second;
+    int movedId = ids.back();
+    ids[entry.slot] = movedId;
+    ids.pop_back();
+
+    if (entry.slot < ids.size()) {
+        m_entries[movedId].slot = entry.slot;
+    }
+
+    if (ids.empty()) {
+        m_cells.erase(cellIt);
+    }
+}
+
+void InstanceSpatialHash::Insert(int id, const Vector3& position) {
+    auto it = m_entries.find(id);
+    if (it != m_entries.end()) {
+        Move(id, position);
+        return;
+    }
+
+    Entry& entry = m_entries[id];
+    entry.position = position;
+    AddToCell(id, entry);
+}
+
+void InstanceSpatialHash::Remove(int id) {
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    RemoveFromCell(it->second);
+    m_entries.erase(it);
+}
+
+void InstanceSpatialHash::Move(int id, const Vector3& position) {
+    auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    Entry& entry = it->second;
+    entry.position = position;
+
+    // Only touch the buckets when the emitter changed cell
+    uint64_t cell = CellKey(CellCoord(position.x), CellCoord(position.y), CellCoord(position.z));
+    if (cell != entry.cell) {
+        RemoveFromCell(entry);
+        AddToCell(id, entry);
+    }
+}
+
+void InstanceSpatialHash::Clear() {
+    m_cells.clear();
+    m_entries.clear();
+}
+
+template <typename Visitor>
+void InstanceSpatialHash::VisitCells(const Vector3& mins, const Vector3& maxs, Visitor visit) const {
+    const int x0 = CellCoord(mins.x), x1 = CellCoord(maxs.x);
+    const int y0 = CellCoord(mins.y), y1 = CellCoord(maxs.y);
+    const int z0 = CellCoord(mins.z), z1 = CellCoord(maxs.z);
+
+    if (x1 < x0 || y1 < y0 || z1 < z0) {
+        return;
+    }
+
+    // A query spanning more cells than are occupied is cheaper as a scan
+    double range = double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1);
+    if (range > static_cast<double>(m_cells.size())) {
+        for (const auto& cell : m_cells) {
+            for (int id : cell.second) {
+                visit(id, m_entries.at(id).position);
+            }
+        }
+        return;
+    }
+
+    for (int x = x0; x <= x1; ++x) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int z = z0; z <= z1; ++z) {
+                auto cellIt = m_cells.find(CellKey(x, y, z));
+                if (cellIt == m_cells.end()) {
+                    continue;
+                }
+                for (int id : cellIt->second) {
+                    visit(id, m_entries.at(id).position);
+                }
+            }
+        }
+    }
+}
+
+void InstanceSpatialHash::QueryRadius(const Vector3& center, float radius, std::vector<int>& out) const {
+    out.clear();
+    if (radius < 0.0f) {
+        return;
+    }
+
+    const float radiusSq = radius * radius;
+    Vector3 mins(center.x - radius, center.y - radius, center.z - radius);
+    Vector3 maxs(center.x + radius, center.y + radius, center.z + radius);
+
+    VisitCells(mins, maxs, [&](int id, const Vector3& p) {
+        float dx = p.x - center.x;
+        float dy = p.y - center.y;
+        float dz = p.z - center.z;
+        if (dx * dx + dy * dy + dz * dz <= radiusSq) {
+            out.push_back(id);
+        }
+    });
+}
+
+void InstanceSpatialHash::QueryBox(const Vector3& mins, const Vector3& maxs, std::vector<int>& out) const {
+    out.clear();
+
+    VisitCells(mins, maxs, [&](int id, const Vector3& p) {
+        if (p.x >= mins.x && p.x <= maxs.x &&
+            p.y >= mins.y && p.y <= maxs.y &&
+            p.z >= mins.z && p.z <= maxs.z) {
+            out.push_back(id);
+        }
+    });
+}
+
+} // namespace GPUParticles
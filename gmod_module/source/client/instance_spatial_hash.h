@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../particle_data.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Loose spatial hash of instance positions
+ *
+ * Instances are bucketed by the cell containing their emitter position,
+ * so inserting, moving and removing are O(1) and a move only touches the
+ * hash when the emitter crosses a cell border. Queries visit the cells
+ * overlapping the query volume and test the stored positions exactly;
+ * callers wanting to include an effect's extent grow the query by it.
+ */
+class InstanceSpatialHash {
+public:
+    InstanceSpatialHash();
+
+    /**
+     * @brief Set the cell size in world units (rebuilds the hash)
+     */
+    void SetCellSize(float size);
+    float GetCellSize() const { return m_cellSize; }
+
+    void Insert(int id, const Vector3& position);
+    void Remove(int id);
+
+    /**
+     * @brief Update the position of an instance already in the hash
+     */
+    void Move(int id, const Vector3& position);
+
+    void Clear();
+
+    /**
+     * @brief Find instances whose position is within radius of center
+     * @param out Output, cleared first
+     */
+    void QueryRadius(const Vector3& center, float radius, std::vector<int>& out) const;
+
+    /**
+     * @brief Find instances whose position is inside the box
+     * @param out Output, cleared first
+     */
+    void QueryBox(const Vector3& mins, const Vector3& maxs, std::vector<int>& out) const;
+
+    size_t GetCount() const { return m_entries.size(); }
+    size_t GetCellCount() const { return m_cells.size(); }
+
+private:
+    struct Entry {
+        Vector3 position;
+        uint64_t cell;
+        size_t slot;    // Index in the cell's id list
+    };
+
+    int CellCoord(float value) const;
+    uint64_t CellKey(int x, int y, int z) const;
+
+    void AddToCell(int id, Entry& entry);
+    void RemoveFromCell(const Entry& entry);
+
+    // Calls visit(id, position) for every instance in cells overlapping the box
+    template <typename Visitor>
+    void VisitCells(const Vector3& mins, const Vector3& maxs, Visitor visit) const;
+
+    float m_cellSize;
+    float m_invCellSize;
+    std::unordered_map<uint64_t, std::vector<int>> m_cells;
+    std::unordered_map<int, Entry> m_entries;
+};
+
+} // namespace GPUParticles
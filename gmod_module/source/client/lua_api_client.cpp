@@ -128,6 +128,7 @@ LUA_FUNCTION(LUA_Load) {
 
 // particles.LoadFromString(name, jsonString)
 // Loads a particle system from JSON string (preferred method)
+// jsonString may also be the contents of a compiled .gpartc file
 // Returns: boolean success
 LUA_FUNCTION(LUA_LoadFromString) {
     // Ensure system is initialized
@@ -146,7 +147,10 @@ LUA_FUNCTION(LUA_LoadFromString) {
     LUA->CheckType(1, Type::STRING);
     LUA->CheckType(2, Type::STRING);
     const char* name = LUA->GetString(1);
-    const char* jsonString = LUA->GetString(2);
+    // Compiled effects contain NUL bytes, so keep the length
+    unsigned int jsonLength = 0;
+    const char* jsonData = LUA->GetString(2, &jsonLength);
+    const std::string jsonString(jsonData, jsonLength);
 
     // Print to Lua console
     LUA->PushSpecial(SPECIAL_GLOB);
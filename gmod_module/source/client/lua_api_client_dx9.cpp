@@ -8,8 +8,18 @@
 #include "particle_loader.h"
 #include "cpu_particle_simulator.h"
 #include "dx9_particle_renderer.h"
+#include "particle_pool.h"
+#include "particle_budget.h"
+#include "particle_bounds.h"
+#include "update_scheduler.h"
+#include "instance_spatial_hash.h"
+#include "worker_pool.h"
+#include "particle_sort.h"
+#include "simulation_pipeline.h"
 #include "../particle_data.h"
 
+#include <algorithm>
+#include <cfloat>
 #include <memory>
 #include <unordered_map>
 #include <iostream>
@@ -27,6 +37,7 @@ bool InitializeParticleSystem();
 void ShutdownParticleSystem();
 void UpdateParticles(float deltaTime);
 void RenderParticles(const float* viewMatrix, const float* projMatrix, const float* cameraPos);
+void RenderParticles(const float* viewMatrix, const float* projMatrix, const float* cameraPos, bool reflection);
 
 // Macro to define Lua functions
 #define LUA_FUNCTION(name) int name(lua_State* state)
@@ -40,11 +51,74 @@ struct Vector {
 // Global State
 // ============================================================================
 
-struct ParticleSystemInstance {
+// Loaded effect plus data derived from it once at load time
+struct ParticleSystemTemplate {
+    std::unique_ptr<ParticleSystemData> data;
+    EffectBounds bounds;        // Emitter-space bounds for culling
+    BlendMode blend;            // Render queue, classified from the material at load
+    RenderModeParams renderMode;
+    int hullVertices;           // Alpha-trimmed outline corners (0 = full quad)
+    int index;                  // Compact id, groups instances in the particle pool
+};
+
+// Simulation state. Instances of the same effect spawned close together
+// in time share one simulation and each draw it with their own transform.
+struct SharedSimulation {
     std::unique_ptr<CPUParticleSimulator> simulator;
+    float spawnTime;            // g_time when created, for the share window
+    bool finished;              // Retire all users at the end of the update
+
+    // Sleeping (not simulated while no user is visible)
+    bool asleep;
+    float sleepDebt;            // Simulation time owed since falling asleep
+
+    // Update scheduling
+    float pendingTime;          // Time accumulated since the last update
+    int updatePhase;            // Round-robin offset
+    int deferredFrames;         // Frames skipped for the update budget
+
+    // Gathered from the users each frame
+    float priority;             // Highest user priority
+    float distance;             // Closest user to the camera
+    bool anyVisible;            // Some user passed culling in a view of the last rendered frame
+    bool budgetApplied;         // Some user's allocation was applied this frame
+
+    // Stamp from g_particleVersion, renewed whenever the particles drawn
+    // from it change; render data built from an older stamp is stale
+    uint64_t version;
+
+    // State the game thread reads while pipelined updates own the simulator
+    TripleBuffer<ParticleSnapshot> snapshots;
+};
+
+struct ParticleSystemInstance {
+    std::shared_ptr<SharedSimulation> simulation;
     Vector3 position;
     float scale;
     Color color;
+
+    // Budget / LOD
+    float priority;
+    float sizeCompensation;     // From the budget manager
+    float alphaCompensation;
+
+    // Culling
+    EffectBounds bounds;        // Static bounds copied from the template
+    BoundingBox worldBounds;    // Tight world-space bounds after the last update
+
+    // Draw order of the simulator's particle slots (sorted effects only)
+    std::vector<uint32_t> sortOrder;
+    ParticleSystemSortMode sortMode;
+    BlendMode blend;
+    RenderModeParams renderMode;
+    int hullVertices;
+    uint64_t sortVersion;       // Simulation version of the sort order (age sorts are camera-independent)
+
+    // Pool data and vertices reused by every view, across frames, while
+    // the simulation and the transform are unchanged
+    ParticlePacket packet;
+
+    int templateIndex;
 };
 
 // Global components
@@ -54,12 +128,111 @@ static std::unique_ptr<DX9ParticleRenderer> g_renderer;
 static std::unique_ptr<ParticleLoader> g_loader;
 
 // Loaded particle system data
-static std::unordered_map<std::string, std::unique_ptr<ParticleSystemData>> g_loadedSystems;
+static std::unordered_map<std::string, ParticleSystemTemplate> g_loadedSystems;
 
 // Active particle instances
 static std::unordered_map<int, ParticleSystemInstance> g_activeInstances;
 static int g_nextInstanceID = 1;
 
+// Instance positions for radius/box queries
+static InstanceSpatialHash g_instanceHash;
+
+// Simulations referenced by active instances
+static std::vector<std::shared_ptr<SharedSimulation>> g_simulations;
+
+// Latest simulation of each effect, joined by spawns within the share window.
+// Off by default: spawns that join draw the same particles on the same
+// timeline, so sharing is for effects where that goes unnoticed.
+static std::unordered_map<std::string, std::weak_ptr<SharedSimulation>> g_openSimulations;
+static float g_shareWindow = 0.0f;
+
+// Time advanced by updates, in seconds
+static float g_time = 0.0f;
+
+// Draw all visible instances from one world-space pool
+static bool g_useParticlePool = true;
+static ParticlePool g_particlePools[static_cast<int>(BlendMode::Count)];
+static std::vector<ParticlePool::Source> g_poolSources[static_cast<int>(BlendMode::Count)];
+
+// Reflection views keep their own pools, so their sort order never becomes
+// the starting guess for the main camera's or the other way around
+static ParticlePool g_reflectionPools[static_cast<int>(BlendMode::Count)];
+
+// Threads for pool and vertex fills (render thread keeps the device)
+static WorkerPool g_workerPool;
+
+// Per-instance particle sorting (sorter scratch is shared)
+static ParticleSorter g_instanceSorter;
+static std::vector<uint32_t> g_sortKeys;
+
+// Global particle budget
+static ParticleBudgetManager g_budgetManager;
+
+// Time-sliced simulation updates
+static UpdateScheduler g_scheduler;
+
+// Scheduler results of the last finished update
+static int g_lastUpdated = 0;
+static int g_lastDeferred = 0;
+static int g_lastUpdateTime = 0;
+
+// Pipelined updates: the next frame simulates on its own thread while
+// this one renders the snapshots of the previous update
+static SimulationPipeline g_pipeline;
+static bool g_pipelinedUpdate = false;
+static int g_pipelineWait = 0;          // Microseconds the last update waited for it
+
+// Camera from the last render, used for distance LOD during update
+static Vector3 g_cameraPos;
+static bool g_hasCamera = false;
+
+// Instances further than this from the camera are culled (0 = no limit)
+static float g_cullDistance = 0.0f;
+
+// Particles narrower than this many pixels are merged (0 = off)
+static float g_subPixelThreshold = 1.0f;
+
+// Fraction of particles drawn in reflection views (water, mirrors, RT cameras)
+static float g_reflectionDetail = 0.5f;
+
+// GMod renders several views per frame; updates start a new frame
+static uint64_t g_frameNumber = 1;
+static uint64_t g_renderedFrame = 0;    // Frame of the last view rendered
+
+// Source of simulation version stamps (see SharedSimulation::version)
+static uint64_t g_particleVersion = 0;
+
+// Unchanged instances are drawn from their last vertices while the camera
+// stays this close to the view they were built for (main views only)
+static bool g_vertexReuse = true;
+static float g_vertexReuseMove = 1.0f;      // World units
+static float g_vertexReuseAngle = 0.25f;    // Degrees
+
+// Pool particles narrower than this many pixels are drawn as point sprites (0 = off)
+static float g_pointSpriteSize = 3.0f;
+
+// Culling results of the last main view
+static int g_visibleInstances = 0;
+static int g_culledInstances = 0;
+
+// Render work summed over the views of a frame
+struct FrameRenderStats {
+    int views = 0;
+    int reflectionViews = 0;
+    int packetsReused = 0;      // Instances copied from a packet built by an earlier view or frame
+    uint32_t particlesReused = 0;   // Drawn from cached vertices
+    uint32_t particlesBuilt = 0;    // Written from particle data
+    uint32_t pointSprites = 0;      // Drawn as point sprites instead of quads
+    int drawCalls = 0;
+    int stateChanges = 0;
+    ScreenSizeStats sizeStats;
+};
+static FrameRenderStats g_frameRenderStats;      // Frame in progress
+static FrameRenderStats g_lastFrameRenderStats;  // Last complete frame
+
+// Non-looping instances removed after they finished
+static int g_retiredInstances = 0;
+
 // State
 static bool g_systemInitialized = false;
 
@@ -83,11 +256,154 @@ static bool EnsureInitialized() {
     return true;
 }
 
+// ============================================================================
+// Simulation Snapshots
+// ============================================================================
+
+// With pipelined updates a simulator belongs to the simulation thread
+// between kicks, so the game thread reads the snapshot it published last
+
+static void PublishSnapshot(SharedSimulation& simulation) {
+    simulation.snapshots.GetWriteBuffer().CopyFrom(*simulation.simulator);
+    simulation.snapshots.Publish();
+}
+
+static const std::vector<Particle>& GetVisibleParticles(const SharedSimulation& simulation) {
+    return g_pipelinedUpdate ? simulation.snapshots.GetReadBuffer().particles
+                             : simulation.simulator->GetParticles();
+}
+
+static int GetVisibleAliveCount(const SharedSimulation& simulation) {
+    return g_pipelinedUpdate ? simulation.snapshots.GetReadBuffer().aliveCount
+                             : simulation.simulator->GetAliveCount();
+}
+
+static const BoundsAccumulator& GetVisibleBounds(const SharedSimulation& simulation) {
+    return g_pipelinedUpdate ? simulation.snapshots.GetReadBuffer().bounds
+                             : simulation.simulator->GetBounds();
+}
+
+// Block until the simulation thread is done; the simulators and the
+// scheduler may only be touched by the game thread after this
+static int WaitForSimulation() {
+    return g_pipeline.Wait();
+}
+
+// ============================================================================
+// Instance Bounds
+// ============================================================================
+
+// World-space box of everywhere the effect's particles can reach
+static BoundingBox GetReachBounds(const ParticleSystemInstance& instance) {
+    return instance.bounds.box.Offset(instance.position,
+                                      instance.bounds.maxParticleSize * instance.scale * instance.sizeCompensation);
+}
+
+// Refresh the world-space bounds of an instance from its simulation.
+// Particle positions are emitter-relative and unscaled; the instance scale
+// (and budget size compensation) only affects the quad size.
+static void UpdateInstanceBounds(ParticleSystemInstance& instance) {
+    const SharedSimulation& simulation = *instance.simulation;
+    const BoundsAccumulator& dynamic = GetVisibleBounds(simulation);
+
+    if (!simulation.asleep && !dynamic.IsEmpty()) {
+        instance.worldBounds = dynamic.GetBox().Offset(
+            instance.position, dynamic.GetMaxSize() * instance.scale * instance.sizeCompensation);
+    } else {
+        // Nothing alive yet, or particles kept moving while asleep:
+        // fall back to where the effect can reach
+        instance.worldBounds = GetReachBounds(instance);
+    }
+}
+
+// Render data built from the simulation's particles so far is stale
+static void MarkSimulationChanged(SharedSimulation& simulation) {
+    simulation.version = ++g_particleVersion;
+}
+
+// Stop simulating; a sleeping simulation only accumulates time debt
+static void SleepSimulation(SharedSimulation& simulation) {
+    simulation.asleep = true;
+    simulation.sleepDebt = simulation.pendingTime;  // Time not yet simulated is owed too
+    simulation.pendingTime = 0.0f;
+    simulation.deferredFrames = 0;
+}
+
+// Catch a sleeping simulation up on the time it owes in one bounded step.
+// Sleeping simulations are never handed to the simulation thread, so this
+// is safe while a pipelined update runs.
+static void WakeSimulation(SharedSimulation& simulation) {
+    simulation.simulator->FastForward(simulation.sleepDebt);
+    simulation.asleep = false;
+    simulation.sleepDebt = 0.0f;
+    MarkSimulationChanged(simulation);
+
+    if (g_pipelinedUpdate) {
+        PublishSnapshot(simulation);
+        simulation.snapshots.Acquire();
+    }
+}
+
+static float DistanceSquared(const Vector3& a, const Vector3& b) {
+    float dx = a.x - b.x;
+    float dy = a.y - b.y;
+    float dz = a.z - b.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+// Remove an instance and its spatial hash entry, returns the next iterator
+static std::unordered_map<int, ParticleSystemInstance>::iterator
+RemoveInstance(std::unordered_map<int, ParticleSystemInstance>::iterator it) {
+    g_instanceHash.Remove(it->first);
+    return g_activeInstances.erase(it);
+}
+
+// Read a GMod Vector argument field by field
+static Vector3 GetVector(ILuaBase* lua, int index) {
+    lua->CheckType(index, Type::VECTOR);
+    lua->Push(index);
+
+    Vector3 v;
+    lua->GetField(-1, "x");
+    v.x = (float)lua->GetNumber(-1);
+    lua->Pop();
+    lua->GetField(-1, "y");
+    v.y = (float)lua->GetNumber(-1);
+    lua->Pop();
+    lua->GetField(-1, "z");
+    v.z = (float)lua->GetNumber(-1);
+    lua->Pop(2);  // Pop z and vector
+
+    return v;
+}
+
+// Push a table array of instance IDs
+static void PushIDTable(ILuaBase* lua, const std::vector<int>& ids) {
+    lua->CreateTable();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        lua->PushNumber((double)(i + 1));
+        lua->PushNumber(ids[i]);
+        lua->SetTable(-3);
+    }
+}
+
+// Push a GMod Vector by calling the global Vector() constructor
+static void PushVector(ILuaBase* lua, const Vector3& v) {
+    lua->PushSpecial(SPECIAL_GLOB);
+    lua->GetField(-1, "Vector");
+    lua->PushNumber(v.x);
+    lua->PushNumber(v.y);
+    lua->PushNumber(v.z);
+    lua->Call(3, 1);
+    lua->Remove(-2);  // Remove global table
+}
+
 // ============================================================================
 // Lua API Functions
 // ============================================================================
 
 // particles.LoadFromString(name, jsonString)
+// jsonString may also be the contents of a compiled .gpartc file
 LUA_FUNCTION(LUA_LoadFromString) {
     // Ensure system is initialized
     if (!EnsureInitialized()) {
@@ -105,7 +421,10 @@ LUA_FUNCTION(LUA_LoadFromString) {
     LUA->CheckType(1, Type::STRING);
     LUA->CheckType(2, Type::STRING);
     const char* name = LUA->GetString(1);
-    const char* jsonString = LUA->GetString(2);
+    // Compiled effects contain NUL bytes, so keep the length
+    unsigned int jsonLength = 0;
+    const char* jsonData = LUA->GetString(2, &jsonLength);
+    const std::string jsonString(jsonData, jsonLength);
 
     // Print to Lua console
     LUA->PushSpecial(SPECIAL_GLOB);
@@ -134,8 +453,14 @@ LUA_FUNCTION(LUA_LoadFromString) {
         return 1;
     }
 
-    // Store loaded system
-    g_loadedSystems[name] = std::move(data);
+    // Store loaded system with its precomputed bounds
+    ParticleSystemTemplate& system = g_loadedSystems[name];
+    system.index = static_cast<int>(g_loadedSystems.size()) - 1;
+    system.bounds = EffectBounds::Compute(*data);
+    system.blend = ClassifyBlendMode(data->renderer.material);
+    system.renderMode = RenderModeParams(data->renderer);
+    system.hullVertices = data->renderer.hullVertices;
+    system.data = std::move(data);
 
     LUA->PushSpecial(SPECIAL_GLOB);
     LUA->GetField(-1, "print");
@@ -147,7 +472,7 @@ LUA_FUNCTION(LUA_LoadFromString) {
     return 1;
 }
 
-// particles.Spawn(name, pos, scale, color)
+// particles.Spawn(name, pos, scale, color, priority)
 LUA_FUNCTION(LUA_Spawn) {
     // Ensure system is initialized
     if (!EnsureInitialized()) {
@@ -208,6 +533,12 @@ LUA_FUNCTION(LUA_Spawn) {
         LUA->Pop();
     }
 
+    // Get budget priority (optional)
+    float priority = 1.0f;
+    if (LUA->Top() >= 5 && LUA->IsType(5, Type::NUMBER)) {
+        priority = (float)LUA->GetNumber(5);
+    }
+
     std::cout << "[Lua API] Spawning: " << name << " at (" << pos.x << "," << pos.y << "," << pos.z << ")" << std::endl;
 
     // Check if DX9 device is available
@@ -230,20 +561,69 @@ LUA_FUNCTION(LUA_Spawn) {
         return 1;
     }
 
-    // Create simulator instance
-    auto simulator = std::make_unique<CPUParticleSimulator>();
-    if (!simulator->Initialize(*it->second)) {
-        std::cerr << "[Lua API] Failed to initialize simulator: " << simulator->GetLastError() << std::endl;
-        LUA->PushNumber(-1);
-        return 1;
+    const ParticleSystemTemplate& system = it->second;
+
+    // The simulation thread may be finishing the simulation this would join
+    WaitForSimulation();
+
+    // Join a simulation of the same effect spawned within the share window
+    std::shared_ptr<SharedSimulation> simulation;
+    if (g_shareWindow > 0.0f) {
+        auto open = g_openSimulations.find(name);
+        if (open != g_openSimulations.end()) {
+            simulation = open->second.lock();
+            if (simulation && (simulation->asleep || simulation->finished ||
+                               g_time - simulation->spawnTime > g_shareWindow)) {
+                simulation.reset();
+            }
+        }
+    }
+
+    if (!simulation) {
+        // Create simulator instance
+        auto simulator = std::make_unique<CPUParticleSimulator>();
+        if (!simulator->Initialize(*system.data)) {
+            std::cerr << "[Lua API] Failed to initialize simulator: " << simulator->GetLastError() << std::endl;
+            LUA->PushNumber(-1);
+            return 1;
+        }
+
+        simulation = std::make_shared<SharedSimulation>();
+        simulation->simulator = std::move(simulator);
+        simulation->spawnTime = g_time;
+        simulation->finished = false;
+        simulation->asleep = false;
+        simulation->sleepDebt = 0.0f;
+        simulation->pendingTime = 0.0f;
+        simulation->updatePhase = g_nextInstanceID;
+        simulation->deferredFrames = 0;
+        simulation->priority = priority;
+        simulation->distance = 0.0f;
+        simulation->anyVisible = true;
+        simulation->budgetApplied = false;
+        MarkSimulationChanged(*simulation);
+
+        g_simulations.push_back(simulation);
+        g_openSimulations[name] = simulation;
     }
 
     // Create instance
     ParticleSystemInstance instance;
-    instance.simulator = std::move(simulator);
+    instance.simulation = simulation;
     instance.position = pos;
     instance.scale = scale;
     instance.color = color;
+    instance.priority = priority;
+    instance.sizeCompensation = 1.0f;
+    instance.alphaCompensation = 1.0f;
+    instance.bounds = system.bounds;
+    instance.templateIndex = system.index;
+    instance.sortMode = system.data->renderer.sortMode;
+    instance.blend = system.blend;
+    instance.renderMode = system.renderMode;
+    instance.hullVertices = system.hullVertices;
+    instance.sortVersion = 0;
+    UpdateInstanceBounds(instance);
 
     // Debug: Print position being stored
     char posDebug[256];
@@ -253,6 +633,7 @@ LUA_FUNCTION(LUA_Spawn) {
 
     // Assign ID and store
     int instanceID = g_nextInstanceID++;
+    g_instanceHash.Insert(instanceID, instance.position);
     g_activeInstances[instanceID] = std::move(instance);
 
     std::cout << "[Lua API] Spawned instance ID: " << instanceID << std::endl;
@@ -322,10 +703,12 @@ void BuildProjectionMatrix(float fov, float aspect, float zNear, float zFar, flo
     outMatrix[12] = 0; outMatrix[13] = 0; outMatrix[14] = (zNear * zFar) / (zNear - zFar); outMatrix[15] = 0;
 }
 
-// particles.Render(viewSetup)
+// particles.Render(viewSetup, [reflection])
+// Draw one view; reflection views (water, mirrors, RT cameras) use the reflection detail
 LUA_FUNCTION(LUA_Render) {
     // Get view setup table
     LUA->CheckType(1, Type::TABLE);
+    const bool reflection = LUA->IsType(2, Type::BOOL) && LUA->GetBool(2);
 
     // Extract camera position - read fields individually to avoid userdata corruption
     LUA->GetField(1, "origin");
@@ -379,6 +762,14 @@ LUA_FUNCTION(LUA_Render) {
 
     float cameraPos[3] = {origin.x, origin.y, origin.z};
 
+    // Remember the camera for next update's budget LOD; reflection cameras
+    // would pull it toward whatever a mirror or the water happens to show
+    if (!reflection) {
+        g_cameraPos = Vector3(origin.x, origin.y, origin.z);
+        g_hasCamera = true;
+        g_budgetManager.SetFieldOfView(fov);
+    }
+
     // Build proper view and projection matrices from GMod's view setup
     float viewMatrix[16];
     float projMatrix[16];
@@ -399,7 +790,7 @@ LUA_FUNCTION(LUA_Render) {
         logged = true;
     }
 
-    RenderParticles(viewMatrix, projMatrix, cameraPos);
+    RenderParticles(viewMatrix, projMatrix, cameraPos, reflection);
 
     return 0;
 }
@@ -507,13 +898,400 @@ static void LuaPrint(ILuaBase* lua, const std::string& msg) {
 LUA_FUNCTION(LUA_GetTotalParticleCount) {
     int total = 0;
     for (const auto& pair : g_activeInstances) {
-        total += pair.second.simulator->GetAliveCount();
+        total += GetVisibleAliveCount(*pair.second.simulation);
     }
 
     LUA->PushNumber(total);
     return 1;
 }
 
+// particles.Kill(instanceID)
+// Returns: boolean success
+LUA_FUNCTION(LUA_Kill) {
+    LUA->CheckType(1, Type::NUMBER);
+    int instanceID = (int)LUA->GetNumber(1);
+
+    auto it = g_activeInstances.find(instanceID);
+    if (it == g_activeInstances.end()) {
+        LUA->PushBool(false);
+        return 1;
+    }
+
+    RemoveInstance(it);
+    LUA->PushBool(true);
+    return 1;
+}
+
+// particles.KillInRadius(position, radius)
+// Returns: number of instances killed
+LUA_FUNCTION(LUA_KillInRadius) {
+    Vector3 center = GetVector(LUA, 1);
+    LUA->CheckType(2, Type::NUMBER);
+    float radius = (float)LUA->GetNumber(2);
+
+    static std::vector<int> ids;
+    g_instanceHash.QueryRadius(center, radius, ids);
+
+    for (int id : ids) {
+        auto it = g_activeInstances.find(id);
+        if (it != g_activeInstances.end()) {
+            RemoveInstance(it);
+        }
+    }
+
+    LUA->PushNumber((double)ids.size());
+    return 1;
+}
+
+// particles.SetPosition(instanceID, position)
+// Moves the emitter; alive particles move with it
+// Returns: boolean success
+LUA_FUNCTION(LUA_SetPosition) {
+    LUA->CheckType(1, Type::NUMBER);
+    int instanceID = (int)LUA->GetNumber(1);
+    Vector3 pos = GetVector(LUA, 2);
+
+    auto it = g_activeInstances.find(instanceID);
+    if (it == g_activeInstances.end()) {
+        LUA->PushBool(false);
+        return 1;
+    }
+
+    ParticleSystemInstance& instance = it->second;
+    Vector3 delta(pos.x - instance.position.x, pos.y - instance.position.y, pos.z - instance.position.z);
+    instance.position = pos;
+    instance.worldBounds = instance.worldBounds.Offset(delta, 0.0f);
+    g_instanceHash.Move(instanceID, pos);
+
+    LUA->PushBool(true);
+    return 1;
+}
+
+// particles.FindInRadius(position, radius)
+// Returns: table of instance IDs whose emitter is within radius
+LUA_FUNCTION(LUA_FindInRadius) {
+    Vector3 center = GetVector(LUA, 1);
+    LUA->CheckType(2, Type::NUMBER);
+
+    static std::vector<int> ids;
+    g_instanceHash.QueryRadius(center, (float)LUA->GetNumber(2), ids);
+
+    PushIDTable(LUA, ids);
+    return 1;
+}
+
+// particles.FindInBox(mins, maxs)
+// Returns: table of instance IDs whose emitter is inside the box
+LUA_FUNCTION(LUA_FindInBox) {
+    Vector3 mins = GetVector(LUA, 1);
+    Vector3 maxs = GetVector(LUA, 2);
+
+    static std::vector<int> ids;
+    g_instanceHash.QueryBox(mins, maxs, ids);
+
+    PushIDTable(LUA, ids);
+    return 1;
+}
+
+// particles.SetBudget(maxParticles)
+// Sets the maximum number of particles alive across all instances
+LUA_FUNCTION(LUA_SetBudget) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_budgetManager.SetBudget((int)LUA->GetNumber(1));
+    return 0;
+}
+
+// particles.GetBudget()
+LUA_FUNCTION(LUA_GetBudget) {
+    LUA->PushNumber(g_budgetManager.GetBudget());
+    return 1;
+}
+
+// particles.SetPriority(instanceID, priority)
+// Returns: boolean success
+LUA_FUNCTION(LUA_SetPriority) {
+    LUA->CheckType(1, Type::NUMBER);
+    LUA->CheckType(2, Type::NUMBER);
+    int instanceID = (int)LUA->GetNumber(1);
+
+    auto it = g_activeInstances.find(instanceID);
+    if (it == g_activeInstances.end()) {
+        LUA->PushBool(false);
+        return 1;
+    }
+
+    it->second.priority = (float)LUA->GetNumber(2);
+    LUA->PushBool(true);
+    return 1;
+}
+
+// particles.GetBudgetStats()
+// Returns: table {budget, demand, allocated, culled}
+LUA_FUNCTION(LUA_GetBudgetStats) {
+    LUA->CreateTable();
+
+    LUA->PushNumber(g_budgetManager.GetBudget());
+    LUA->SetField(-2, "budget");
+
+    LUA->PushNumber(g_budgetManager.GetLastDemand());
+    LUA->SetField(-2, "demand");
+
+    LUA->PushNumber(g_budgetManager.GetLastAllocated());
+    LUA->SetField(-2, "allocated");
+
+    LUA->PushNumber(g_budgetManager.GetLastCulledCount());
+    LUA->SetField(-2, "culled");
+
+    return 1;
+}
+
+// particles.SetCullDistance(distance)
+// Instances further than distance from the camera are not rendered (0 = no limit)
+LUA_FUNCTION(LUA_SetCullDistance) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_cullDistance = std::max(0.0f, (float)LUA->GetNumber(1));
+    return 0;
+}
+
+// particles.GetStats()
+// Returns: table {instances, visible, culled, simulations, sleeping, retired, updated, deferred, updateTime,
+//                 pipelineWait, workers, drawCalls, stateChanges,
+//                 sizeClampedMax, sizeClampedMin, subPixelKept, subPixelCulled,
+//                 views, reflectionViews, packetsReused, detailCulled, particlesReused, vertexReuseRate,
+//                 quadParticles, pointParticles, pointCulled}
+LUA_FUNCTION(LUA_GetStats) {
+    LUA->CreateTable();
+
+    LUA->PushNumber((double)g_activeInstances.size());
+    LUA->SetField(-2, "instances");
+
+    LUA->PushNumber(g_visibleInstances);
+    LUA->SetField(-2, "visible");
+
+    LUA->PushNumber(g_culledInstances);
+    LUA->SetField(-2, "culled");
+
+    LUA->PushNumber((double)g_simulations.size());
+    LUA->SetField(-2, "simulations");
+
+    int sleeping = 0;
+    for (const auto& simulation : g_simulations) {
+        if (simulation->asleep) {
+            sleeping++;
+        }
+    }
+    LUA->PushNumber(sleeping);
+    LUA->SetField(-2, "sleeping");
+
+    LUA->PushNumber(g_retiredInstances);
+    LUA->SetField(-2, "retired");
+
+    LUA->PushNumber(g_lastUpdated);
+    LUA->SetField(-2, "updated");
+
+    LUA->PushNumber(g_lastDeferred);
+    LUA->SetField(-2, "deferred");
+
+    LUA->PushNumber(g_lastUpdateTime);
+    LUA->SetField(-2, "updateTime");
+
+    LUA->PushNumber(g_pipelineWait);
+    LUA->SetField(-2, "pipelineWait");
+
+    LUA->PushNumber(g_workerPool.GetWorkerCount());
+    LUA->SetField(-2, "workers");
+
+    // Renderer counts are summed over every view of the last frame
+    const FrameRenderStats& frameStats = g_lastFrameRenderStats;
+    LUA->PushNumber(frameStats.drawCalls);
+    LUA->SetField(-2, "drawCalls");
+
+    LUA->PushNumber(frameStats.stateChanges);
+    LUA->SetField(-2, "stateChanges");
+
+    // Particles changed or removed by each screen-size rule
+    const ScreenSizeStats& sizeStats = frameStats.sizeStats;
+    LUA->PushNumber(sizeStats.clampedMax);
+    LUA->SetField(-2, "sizeClampedMax");
+
+    LUA->PushNumber(sizeStats.clampedMin);
+    LUA->SetField(-2, "sizeClampedMin");
+
+    LUA->PushNumber(sizeStats.subPixelKept);
+    LUA->SetField(-2, "subPixelKept");
+
+    LUA->PushNumber(sizeStats.subPixelCulled);
+    LUA->SetField(-2, "subPixelCulled");
+
+    LUA->PushNumber(frameStats.views);
+    LUA->SetField(-2, "views");
+
+    LUA->PushNumber(frameStats.reflectionViews);
+    LUA->SetField(-2, "reflectionViews");
+
+    LUA->PushNumber(frameStats.packetsReused);
+    LUA->SetField(-2, "packetsReused");
+
+    LUA->PushNumber(sizeStats.detailCulled);
+    LUA->SetField(-2, "detailCulled");
+
+    // Share of drawn particles whose vertices came from an earlier view or frame
+    const uint32_t drawnParticles = frameStats.particlesReused + frameStats.particlesBuilt;
+    LUA->PushNumber(frameStats.particlesReused);
+    LUA->SetField(-2, "particlesReused");
+
+    LUA->PushNumber(drawnParticles > 0 ? (double)frameStats.particlesReused / drawnParticles : 0.0);
+    LUA->SetField(-2, "vertexReuseRate");
+
+    // Split between the billboard and point sprite paths
+    LUA->PushNumber(drawnParticles);
+    LUA->SetField(-2, "quadParticles");
+
+    LUA->PushNumber(frameStats.pointSprites);
+    LUA->SetField(-2, "pointParticles");
+
+    LUA->PushNumber(sizeStats.pointCulled);
+    LUA->SetField(-2, "pointCulled");
+
+    return 1;
+}
+
+// particles.SetSubPixelThreshold(pixels)
+// Particles narrower than this on screen are drawn at this size with lower alpha,
+// or thinned out when too faint (0 = off, default 1)
+LUA_FUNCTION(LUA_SetSubPixelThreshold) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_subPixelThreshold = std::max(0.0f, (float)LUA->GetNumber(1));
+    if (g_renderer) {
+        g_renderer->SetSubPixelThreshold(g_subPixelThreshold);
+    }
+    return 0;
+}
+
+// particles.SetReflectionDetail(fraction)
+// Fraction of particles drawn in reflection views, 0 to 1 (0 = none, default 0.5)
+LUA_FUNCTION(LUA_SetReflectionDetail) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_reflectionDetail = std::max(0.0f, std::min(1.0f, (float)LUA->GetNumber(1)));
+    return 0;
+}
+
+// particles.SetVertexReuse(enabled, [maxCameraMove], [maxCameraAngle])
+// Draw unchanged instances from their last vertices while the camera moved less
+// than maxCameraMove units (default 1) and turned less than maxCameraAngle degrees (default 0.25)
+LUA_FUNCTION(LUA_SetVertexReuse) {
+    LUA->CheckType(1, Type::BOOL);
+    g_vertexReuse = LUA->GetBool(1);
+    if (LUA->IsType(2, Type::NUMBER)) {
+        g_vertexReuseMove = std::max(0.0f, (float)LUA->GetNumber(2));
+    }
+    if (LUA->IsType(3, Type::NUMBER)) {
+        g_vertexReuseAngle = std::max(0.0f, (float)LUA->GetNumber(3));
+    }
+    if (g_renderer) {
+        g_renderer->SetVertexReuseThreshold(g_vertexReuseMove, g_vertexReuseAngle);
+    }
+    return 0;
+}
+
+// particles.SetPointSpriteSize(pixels)
+// Pooled particles narrower than this on screen are drawn as single-vertex point sprites
+// instead of quads (0 = off, default 3, at most 15.9)
+LUA_FUNCTION(LUA_SetPointSpriteSize) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_pointSpriteSize = std::max(0.0f, (float)LUA->GetNumber(1));
+    if (g_renderer) {
+        g_renderer->SetPointSpriteSize(g_pointSpriteSize);
+    }
+    return 0;
+}
+
+// particles.SetUseParticlePool(enabled)
+// Draw all instances from one globally sorted pool instead of one draw per instance
+LUA_FUNCTION(LUA_SetUseParticlePool) {
+    LUA->CheckType(1, Type::BOOL);
+    g_useParticlePool = LUA->GetBool(1);
+    return 0;
+}
+
+// particles.SetShareWindow(seconds)
+// Spawns of the same effect within this time share one simulation (0 = never share)
+LUA_FUNCTION(LUA_SetShareWindow) {
+    LUA->CheckType(1, Type::NUMBER);
+    g_shareWindow = std::max(0.0f, (float)LUA->GetNumber(1));
+    return 0;
+}
+
+// particles.SetWorkerThreads(count)
+// Sets the threads used to fill particle and vertex data (0 = render thread only)
+LUA_FUNCTION(LUA_SetWorkerThreads) {
+    LUA->CheckType(1, Type::NUMBER);
+    int count = std::max(0, std::min(16, (int)LUA->GetNumber(1)));
+    if (count != g_workerPool.GetWorkerCount()) {
+        g_workerPool.Initialize(count);
+    }
+    return 0;
+}
+
+// particles.SetUpdateBudget(microseconds)
+// Sets the simulation time allowed per frame (0 = unlimited)
+LUA_FUNCTION(LUA_SetUpdateBudget) {
+    LUA->CheckType(1, Type::NUMBER);
+    WaitForSimulation();
+    g_scheduler.SetFrameBudget((int)LUA->GetNumber(1));
+    return 0;
+}
+
+// particles.SetPipelinedUpdate(enabled)
+// Simulates the next frame on a separate thread while the current one renders.
+// Rendering then shows the previous update: one frame of latency.
+LUA_FUNCTION(LUA_SetPipelinedUpdate) {
+    LUA->CheckType(1, Type::BOOL);
+    bool enabled = LUA->GetBool(1);
+    if (enabled == g_pipelinedUpdate) {
+        return 0;
+    }
+
+    WaitForSimulation();
+    g_pipelinedUpdate = enabled;
+
+    if (enabled) {
+        // Start from the current state so nothing blinks out for a frame
+        for (auto& simulation : g_simulations) {
+            PublishSnapshot(*simulation);
+            simulation->snapshots.Acquire();
+        }
+        g_pipeline.Initialize();
+    } else {
+        g_pipeline.Shutdown();
+    }
+
+    // Rendering switches between the snapshots and the live particles,
+    // which can differ, so nothing built from either is current
+    for (auto& simulation : g_simulations) {
+        MarkSimulationChanged(*simulation);
+    }
+    return 0;
+}
+
+// particles.GetBounds(instanceID)
+// Returns: mins, maxs (world-space Vectors) or nil if the instance doesn't exist
+LUA_FUNCTION(LUA_GetBounds) {
+    LUA->CheckType(1, Type::NUMBER);
+    int instanceID = (int)LUA->GetNumber(1);
+
+    auto it = g_activeInstances.find(instanceID);
+    if (it == g_activeInstances.end()) {
+        LUA->PushNil();
+        return 1;
+    }
+
+    const BoundingBox& box = it->second.worldBounds;
+    PushVector(LUA, box.mins);
+    PushVector(LUA, box.maxs);
+    return 2;
+}
+
 // particles.InitGPU() - Debug function
 LUA_FUNCTION(LUA_InitGPU) {
     LuaPrint(LUA, "[C++ Module] ===== Diagnostics =====");
@@ -573,6 +1351,175 @@ LUA_FUNCTION(LUA_InitGPU) {
 // Module Update/Render
 // ============================================================================
 
+// Distribute the global particle budget across all active instances
+static void ApplyParticleBudget() {
+    static std::vector<BudgetRequest> requests;
+    static std::vector<BudgetAllocation> allocations;
+
+    // Every instance draws its particles, so budget is requested per
+    // instance. Sleeping simulations don't take budget; they keep their
+    // last allocation until they wake up.
+    requests.clear();
+    for (const auto& pair : g_activeInstances) {
+        const ParticleSystemInstance& instance = pair.second;
+        if (instance.simulation->asleep) {
+            continue;
+        }
+
+        BudgetRequest request;
+        request.maxParticles = instance.simulation->simulator->GetData().main.maxParticles;
+        request.priority = instance.priority;
+
+        // Screen size estimate from the tight bounds of the last update
+        const BoundingBox& box = instance.worldBounds;
+        Vector3 center = box.GetCenter();
+        float hx = 0.5f * (box.maxs.x - box.mins.x);
+        float hy = 0.5f * (box.maxs.y - box.mins.y);
+        float hz = 0.5f * (box.maxs.z - box.mins.z);
+        request.radius = sqrtf(hx * hx + hy * hy + hz * hz);
+
+        if (g_hasCamera) {
+            request.distance = sqrtf(DistanceSquared(center, g_cameraPos));
+        }
+
+        requests.push_back(request);
+    }
+
+    g_budgetManager.Allocate(requests, allocations);
+
+    for (auto& simulation : g_simulations) {
+        simulation->budgetApplied = false;
+    }
+
+    // Map iteration order is stable while the map is unmodified
+    size_t index = 0;
+    for (auto& pair : g_activeInstances) {
+        ParticleSystemInstance& instance = pair.second;
+        SharedSimulation& simulation = *instance.simulation;
+        if (simulation.asleep) {
+            continue;
+        }
+
+        const BudgetAllocation& allocation = allocations[index++];
+
+        // A shared simulation runs at the most generous allocation of its users
+        CPUParticleSimulator& simulator = *simulation.simulator;
+        if (!simulation.budgetApplied || allocation.particleCap > simulator.GetParticleCap()) {
+            simulator.SetEmissionScale(allocation.emissionScale);
+            simulator.SetParticleCap(allocation.particleCap);
+            simulation.budgetApplied = true;
+        }
+
+        instance.sizeCompensation = allocation.sizeCompensation;
+        instance.alphaCompensation = allocation.alphaCompensation;
+    }
+}
+
+// Update the scheduled simulations, most urgent first, until the frame
+// budget is spent. With pipelined updates this runs on the simulation
+// thread: it only touches the simulations in the list and the scheduler,
+// and publishes a snapshot of every simulation it updated, whose version
+// changes when the snapshot is acquired. Otherwise it bumps the version of
+// every simulation it updated; skipped and deferred ones keep their
+// particles and their render data.
+static void RunScheduledUpdates(const std::vector<ScheduleRequest>& requests,
+                                const std::vector<SharedSimulation*>& scheduled,
+                                bool publish,
+                                bool log) {
+    static std::vector<size_t> order;
+
+    g_scheduler.BeginFrame(requests, order);
+
+    int updated = 0;
+    int deferred = 0;
+
+    for (size_t k = 0; k < order.size(); ++k) {
+        SharedSimulation& simulation = *scheduled[order[k]];
+        CPUParticleSimulator& simulator = *simulation.simulator;
+
+        // The most urgent simulation always runs so the update makes progress
+        if (k > 0 && !g_scheduler.HasTimeLeft()) {
+            simulation.deferredFrames++;
+            deferred++;
+            continue;
+        }
+
+        int beforeCount = simulator.GetAliveCount();
+
+        // Accumulated time beyond one update is caught up in bounded steps
+        if (simulation.pendingTime <= 0.1f) {
+            simulator.Update(simulation.pendingTime);
+        } else {
+            simulator.FastForward(simulation.pendingTime);
+        }
+        simulation.pendingTime = 0.0f;
+        simulation.deferredFrames = 0;
+        updated++;
+
+        int afterCount = simulator.GetAliveCount();
+
+        // LogToFile is not thread-safe, so the simulation thread stays quiet
+        if (log) {
+            char buf[512];
+            sprintf(buf, "[UpdateParticles] Simulation %d: before=%d after=%d",
+                    simulation.updatePhase, beforeCount, afterCount);
+            LogToFile(buf);
+        }
+
+        if (simulator.IsFinished()) {
+            simulation.finished = true;
+        }
+
+        if (publish) {
+            PublishSnapshot(simulation);
+        } else {
+            MarkSimulationChanged(simulation);
+        }
+    }
+
+    g_scheduler.EndFrame(updated, deferred);
+}
+
+// Apply the results of the last finished update: retire the users of
+// finished simulations and refresh the bounds of the rest
+static void FinishUpdate() {
+    g_lastUpdated = g_scheduler.GetLastUpdated();
+    g_lastDeferred = g_scheduler.GetLastDeferred();
+    g_lastUpdateTime = g_scheduler.GetLastElapsedMicroseconds();
+
+    for (auto it = g_activeInstances.begin(); it != g_activeInstances.end();) {
+        if (it->second.simulation->finished) {
+            it = RemoveInstance(it);
+            g_retiredInstances++;
+        } else {
+            UpdateInstanceBounds(it->second);
+            ++it;
+        }
+    }
+
+    // Drop simulations no instance references anymore
+    g_simulations.erase(
+        std::remove_if(g_simulations.begin(), g_simulations.end(),
+                       [](const std::shared_ptr<SharedSimulation>& simulation) {
+                           return simulation.use_count() == 1;
+                       }),
+        g_simulations.end());
+}
+
+// A simulation sleeps once none of its users was visible in any view of the last frame
+static void SleepHiddenSimulations() {
+    for (auto& simulation : g_simulations) {
+        if (!simulation->anyVisible && !simulation->asleep) {
+            SleepSimulation(*simulation);
+        }
+    }
+    for (auto& pair : g_activeInstances) {
+        if (pair.second.simulation->asleep) {
+            UpdateInstanceBounds(pair.second);
+        }
+    }
+}
+
 void UpdateParticles(float deltaTime) {
     static int updateCount = 0;
     updateCount++;
@@ -585,22 +1532,152 @@ void UpdateParticles(float deltaTime) {
         LogToFile(buf);
     }
 
-    // Update all active instances
-    for (auto& pair : g_activeInstances) {
-        int beforeCount = pair.second.simulator->GetAliveCount();
-        pair.second.simulator->Update(deltaTime);
-        int afterCount = pair.second.simulator->GetAliveCount();
+    // The simulation kicked by the previous update must be done before its
+    // results are read or its inputs change
+    g_pipelineWait = WaitForSimulation();
+
+    if (g_pipelinedUpdate) {
+        // Its snapshots become what the coming render shows; simulations
+        // it didn't reach keep their snapshot and their render data
+        for (auto& simulation : g_simulations) {
+            if (simulation->snapshots.Acquire()) {
+                MarkSimulationChanged(*simulation);
+            }
+        }
+        FinishUpdate();
+    }
 
-        if (updateCount % 60 == 1) {
-            char buf[512];
-            sprintf(buf, "[UpdateParticles] Instance %d: before=%d after=%d",
-                    pair.first, beforeCount, afterCount);
-            LogToFile(buf);
+    // Decided once every view of the last frame has been culled, so an
+    // effect seen only in a reflection or on an RT camera stays awake
+    SleepHiddenSimulations();
+
+    // Whatever the views draw from here on belongs to a new frame
+    g_frameNumber++;
+
+    g_time += deltaTime;
+
+    ApplyParticleBudget();
+
+    // Gather scheduling inputs of each simulation from its users
+    for (auto& simulation : g_simulations) {
+        simulation->priority = 0.0f;
+        simulation->distance = FLT_MAX;
+    }
+    for (const auto& pair : g_activeInstances) {
+        const ParticleSystemInstance& instance = pair.second;
+        SharedSimulation& simulation = *instance.simulation;
+
+        simulation.priority = std::max(simulation.priority, instance.priority);
+        float distance = g_hasCamera ? sqrtf(DistanceSquared(instance.worldBounds.GetCenter(), g_cameraPos)) : 0.0f;
+        simulation.distance = std::min(simulation.distance, distance);
+    }
+
+    // Left untouched until the next update, the simulation thread reads them
+    static std::vector<ScheduleRequest> requests;
+    static std::vector<SharedSimulation*> scheduled;
+
+    requests.clear();
+    scheduled.clear();
+
+    for (auto& simulationPtr : g_simulations) {
+        SharedSimulation& simulation = *simulationPtr;
+
+        if (simulation.asleep) {
+            // Same clamp the simulator applies to a single update
+            simulation.sleepDebt += std::min(deltaTime, 0.1f);
+
+            // Ended while asleep: retire without ever simulating it
+            if (simulation.sleepDebt >= simulation.simulator->GetRemainingTime()) {
+                simulation.finished = true;
+            }
+            continue;
+        }
+
+        // Awake simulations accumulate time until the scheduler runs them
+        simulation.pendingTime += deltaTime;
+
+        // Paused game: nothing to simulate, so the particles and everything
+        // built from them stay as they are
+        if (simulation.pendingTime <= 0.0f) {
+            continue;
+        }
+
+        ScheduleRequest request;
+        request.priority = simulation.priority;
+        request.distance = simulation.distance;
+        request.phase = simulation.updatePhase;
+        request.deferredFrames = simulation.deferredFrames;
+
+        requests.push_back(request);
+        scheduled.push_back(&simulation);
+    }
+
+    if (g_pipelinedUpdate) {
+        // Results are picked up by the next update
+        g_pipeline.Kick([] { RunScheduledUpdates(requests, scheduled, true, false); });
+        return;
+    }
+
+    RunScheduledUpdates(requests, scheduled, false, updateCount % 60 == 1);
+    FinishUpdate();
+}
+
+// Order an instance's particles for its effect's sort mode. The order of
+// the previous frame is the starting point, so a steady camera or an age
+// sort usually costs one scan instead of a full sort.
+static void SortInstanceParticles(ParticleSystemInstance& instance, const Vector3& camera) {
+    const std::vector<Particle>& particles = GetVisibleParticles(*instance.simulation);
+    const ParticleSystemSortMode mode = instance.sortMode;
+
+    // Age orders don't depend on the camera: one sort serves every view
+    // of the same particles
+    if (mode != ParticleSystemSortMode::Distance && instance.sortVersion == instance.simulation->version) {
+        return;
+    }
+    instance.sortVersion = instance.simulation->version;
+
+    // New particles are the youngest, so with oldest in front they go first
+    g_instanceSorter.TrackAlive(particles, instance.sortOrder, mode == ParticleSystemSortMode::OldestInFront);
+
+    g_sortKeys.resize(particles.size());
+    for (uint32_t slot : instance.sortOrder) {
+        const Particle& p = particles[slot];
+
+        switch (mode) {
+            case ParticleSystemSortMode::Distance: {
+                float dx = p.position.x + instance.position.x - camera.x;
+                float dy = p.position.y + instance.position.y - camera.y;
+                float dz = p.position.z + instance.position.z - camera.z;
+                g_sortKeys[slot] = ParticleSorter::DescendingKey(dx * dx + dy * dy + dz * dz);
+                break;
+            }
+            case ParticleSystemSortMode::OldestInFront:
+                g_sortKeys[slot] = ParticleSorter::FloatKey(p.age);
+                break;
+            default:
+                g_sortKeys[slot] = ParticleSorter::DescendingKey(p.age);
+                break;
         }
     }
+
+    g_instanceSorter.Sort(g_sortKeys.data(), instance.sortOrder, &g_workerPool);
+}
+
+// Add the renderer's counts for the view just drawn to the frame's
+static void AddViewStats() {
+    g_frameRenderStats.drawCalls += g_renderer->GetLastDrawCalls();
+    g_frameRenderStats.stateChanges += g_renderer->GetLastStateChanges();
+    g_frameRenderStats.sizeStats.Add(g_renderer->GetLastScreenSizeStats());
+    g_frameRenderStats.particlesReused += g_renderer->GetLastReusedParticles();
+    g_frameRenderStats.particlesBuilt += g_renderer->GetLastBuiltParticles();
+    g_frameRenderStats.pointSprites += g_renderer->GetLastPointSprites();
 }
 
 void RenderParticles(const float* viewMatrix, const float* projMatrix, const float* cameraPos) {
+    RenderParticles(viewMatrix, projMatrix, cameraPos, false);
+}
+
+void RenderParticles(const float* viewMatrix, const float* projMatrix, const float* cameraPos, bool reflection) {
     static int callCount = 0;
     callCount++;
 
@@ -632,21 +1709,189 @@ void RenderParticles(const float* viewMatrix, const float* projMatrix, const flo
         return;
     }
 
+    // First view of a new frame: publish the last frame's totals and
+    // gather visibility from scratch
+    if (g_renderedFrame != g_frameNumber) {
+        g_renderedFrame = g_frameNumber;
+        g_lastFrameRenderStats = g_frameRenderStats;
+        g_frameRenderStats = FrameRenderStats();
+
+        for (auto& simulation : g_simulations) {
+            simulation->anyVisible = false;
+        }
+    }
+    g_frameRenderStats.views++;
+    if (reflection) {
+        g_frameRenderStats.reflectionViews++;
+    }
+
     if (g_activeInstances.empty()) {
+        if (!reflection) {
+            g_visibleInstances = 0;
+            g_culledInstances = 0;
+        }
         return;  // No particles to render
     }
 
-    // Render all active instances
-    for (const auto& pair : g_activeInstances) {
-        const ParticleSystemInstance& instance = pair.second;
+    const float detail = reflection ? g_reflectionDetail : 1.0f;
+    if (detail <= 0.0f) {
+        return;  // Reflections turned off
+    }
+
+    // Cull whole instances against the view frustum and the cull distance
+    Matrix4x4 viewProj = Matrix4x4::Multiply(Matrix4x4::FromArray(viewMatrix),
+                                             Matrix4x4::FromArray(projMatrix));
+    Frustum frustum;
+    frustum.ExtractFromMatrix(&viewProj.m[0][0]);
+
+    int visibleInstances = 0;
+    int culledInstances = 0;
+
+    struct DrawEntry {
+        float distanceSq;
+        int id;
+        ParticleSystemInstance* instance;
+    };
+    static std::vector<DrawEntry> drawOrder;
+    drawOrder.clear();
+
+    const Vector3 camera(cameraPos[0], cameraPos[1], cameraPos[2]);
+
+    auto isVisible = [&](const BoundingBox& box) {
+        if (!frustum.IntersectsBox(box)) {
+            return false;
+        }
+
+        if (g_cullDistance > 0.0f) {
+            // Distance from the camera to the closest point of the box
+            float dx = std::max(std::max(box.mins.x - cameraPos[0], 0.0f), cameraPos[0] - box.maxs.x);
+            float dy = std::max(std::max(box.mins.y - cameraPos[1], 0.0f), cameraPos[1] - box.maxs.y);
+            float dz = std::max(std::max(box.mins.z - cameraPos[2], 0.0f), cameraPos[2] - box.maxs.z);
+            return (dx * dx + dy * dy + dz * dz) <= g_cullDistance * g_cullDistance;
+        }
 
-        int aliveCount = instance.simulator ? instance.simulator->GetAliveCount() : 0;
+        return true;
+    };
+
+    for (auto& pair : g_activeInstances) {
+        ParticleSystemInstance& instance = pair.second;
+        SharedSimulation& simulation = *instance.simulation;
+
+        bool visible = isVisible(instance.worldBounds);
+
+        // The reach of the effect is in view: catch up, then re-test
+        // against the real particle bounds
+        if (visible && simulation.asleep) {
+            WakeSimulation(simulation);
+            UpdateInstanceBounds(instance);
+            visible = isVisible(instance.worldBounds);
+        }
+
+        if (!visible) {
+            culledInstances++;
+            continue;
+        }
+
+        simulation.anyVisible = true;
+        visibleInstances++;
+        drawOrder.push_back({ DistanceSquared(instance.worldBounds.GetCenter(), camera), pair.first, &instance });
+    }
+
+    if (!reflection) {
+        g_visibleInstances = visibleInstances;
+        g_culledInstances = culledInstances;
+    }
+
+    // Reduced detail for reflections; the size rules read it per particle.
+    // Reflections never touch the main view's cached vertices.
+    g_renderer->SetViewDetail(detail);
+    g_renderer->SetVertexReuse(g_vertexReuse && !reflection);
+
+    // Queues are drawn in BlendMode order: alpha-blended effects first,
+    // back to front, then the order-independent premultiplied and additive
+    // ones on top without any sorting
+    if (g_useParticlePool) {
+        // Group instances by queue, then by template so each forms one contiguous range
+        std::sort(drawOrder.begin(), drawOrder.end(), [](const DrawEntry& a, const DrawEntry& b) {
+            if (a.instance->blend != b.instance->blend) {
+                return a.instance->blend < b.instance->blend;
+            }
+            return a.instance->templateIndex < b.instance->templateIndex;
+        });
+
+        for (auto& sources : g_poolSources) {
+            sources.clear();
+        }
+        bool anySorted = false;
+        for (const DrawEntry& entry : drawOrder) {
+            ParticleSystemInstance& instance = *entry.instance;
+
+            ParticlePool::Source source;
+            source.particles = &GetVisibleParticles(*instance.simulation);
+            source.aliveCount = GetVisibleAliveCount(*instance.simulation);
+            source.position = instance.position;
+            source.scale = instance.scale * instance.sizeCompensation;
+            source.alphaScale = instance.alphaCompensation;
+            source.tint = instance.color;
+            source.blend = instance.blend;
+            source.sortMode = instance.sortMode;
+            source.renderMode = instance.renderMode;
+            source.shape = &g_renderer->GetParticleShape(instance.hullVertices);
+            source.templateIndex = instance.templateIndex;
+            source.packet = &instance.packet;
+            source.version = instance.simulation->version;
+            g_poolSources[static_cast<int>(instance.blend)].push_back(source);
+
+            anySorted = anySorted || (instance.blend == BlendMode::Alpha &&
+                                      instance.sortMode != ParticleSystemSortMode::None);
+        }
+
+        // One vertex stream per queue; only the alpha-blended queue is sorted,
+        // and only when one of its effects asks for it
+        const CameraData quadCamera = CameraData::FromViewMatrix(viewMatrix, cameraPos);
+        ParticlePool* pools = reflection ? g_reflectionPools : g_particlePools;
+        g_renderer->BeginFrame(viewMatrix, projMatrix, cameraPos);
+        for (int queue = 0; queue < static_cast<int>(BlendMode::Count); ++queue) {
+            ParticlePool& pool = pools[queue];
+            pool.Fill(g_poolSources[queue], &g_renderer->GetScreenSizeFilter(), &g_workerPool);
+            g_frameRenderStats.packetsReused += static_cast<int>(pool.GetPacketsReused());
+
+            if (queue == static_cast<int>(BlendMode::Alpha) && anySorted) {
+                pool.SortBackToFront(camera, &g_workerPool);
+            }
+            pool.OrientQuads(quadCamera, &g_workerPool);
+            g_renderer->RenderPool(pool, viewMatrix, projMatrix, cameraPos, static_cast<BlendMode>(queue));
+        }
+        g_renderer->EndFrame();
+        AddViewStats();
+        return;
+    }
+
+    // Alpha-blended instances back to front so overlapping effects blend
+    // correctly; the other queues grouped by template for longer batches
+    std::sort(drawOrder.begin(), drawOrder.end(), [](const DrawEntry& a, const DrawEntry& b) {
+        if (a.instance->blend != b.instance->blend) {
+            return a.instance->blend < b.instance->blend;
+        }
+        if (a.instance->blend == BlendMode::Alpha) {
+            return a.distanceSq > b.distanceSq;
+        }
+        return a.instance->templateIndex < b.instance->templateIndex;
+    });
+
+    // Render all visible instances with one state save and one vertex stream
+    g_renderer->BeginFrame(viewMatrix, projMatrix, cameraPos);
+    for (const DrawEntry& entry : drawOrder) {
+        ParticleSystemInstance& instance = *entry.instance;
+
+        const SharedSimulation& simulation = *instance.simulation;
+        int aliveCount = GetVisibleAliveCount(simulation);
 
         // Log each instance being rendered
         if (callCount % 60 == 1) {
             char buf[512];
             sprintf(buf, "[RenderParticles] Instance %d: pos=(%.1f,%.1f,%.1f) scale=%.1f alive=%d",
-                    pair.first, instance.position.x, instance.position.y, instance.position.z,
+                    entry.id, instance.position.x, instance.position.y, instance.position.z,
                     instance.scale, aliveCount);
             LogToFile(buf);
         }
@@ -655,9 +1900,21 @@ void RenderParticles(const float* viewMatrix, const float* projMatrix, const flo
             continue;  // Skip instances with no alive particles
         }
 
+        // Order-independent blending never needs the particle sort
+        const std::vector<uint32_t>* particleOrder = nullptr;
+        if (instance.blend == BlendMode::Alpha && instance.sortMode != ParticleSystemSortMode::None) {
+            SortInstanceParticles(instance, camera);
+            particleOrder = &instance.sortOrder;
+        }
+
         float emitterPos[3] = { instance.position.x, instance.position.y, instance.position.z };
-        g_renderer->Render(*instance.simulator, viewMatrix, projMatrix, cameraPos, emitterPos, instance.scale);
+        g_renderer->Render(GetVisibleParticles(simulation), aliveCount, viewMatrix, projMatrix, cameraPos, emitterPos,
+                           instance.scale * instance.sizeCompensation, instance.alphaCompensation,
+                           instance.color, instance.blend, particleOrder, instance.renderMode,
+                           instance.hullVertices);
     }
+    g_renderer->EndFrame();
+    AddViewStats();
 }
 
 // ============================================================================
@@ -690,6 +1947,10 @@ static void OnDeviceCaptured(IDirect3DDevice9* device) {
             LogToFile(error);
             return;
         }
+        g_renderer->SetWorkerPool(&g_workerPool);
+        g_renderer->SetSubPixelThreshold(g_subPixelThreshold);
+        g_renderer->SetVertexReuseThreshold(g_vertexReuseMove, g_vertexReuseAngle);
+        g_renderer->SetPointSpriteSize(g_pointSpriteSize);
         LogToFile("[OnDeviceCaptured] Particle renderer initialized successfully!");
     }
 
@@ -704,6 +1965,14 @@ bool InitializeParticleSystem() {
         g_loader = std::make_unique<ParticleLoader>();
     }
 
+    // Leave a core each for the game and render threads
+    int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    g_workerPool.Initialize(std::max(0, std::min(3, hardwareThreads - 2)));
+
+    if (g_pipelinedUpdate) {
+        g_pipeline.Initialize();
+    }
+
     // Initialize D3D9 hook
     if (!g_d3dHook) {
         g_d3dHook = std::make_unique<D3D9Hook>();
@@ -732,13 +2001,20 @@ bool InitializeParticleSystem() {
 void ShutdownParticleSystem() {
     std::cout << "[Particle System] Shutting down..." << std::endl;
 
+    // Nothing may be simulating what is about to be freed
+    g_pipeline.Shutdown();
+
     // Clear all active instances
     g_activeInstances.clear();
+    g_instanceHash.Clear();
+    g_simulations.clear();
+    g_openSimulations.clear();
 
     // Clear loaded systems
     g_loadedSystems.clear();
 
     // Shutdown components
+    g_workerPool.Shutdown();
     g_renderer.reset();
     g_dxContext.reset();
     g_d3dHook.reset();
@@ -1013,12 +2289,75 @@ void RegisterLuaAPI(ILuaBase* lua) {
     lua->PushCFunction(LUA_Spawn);
     lua->SetField(-2, "Spawn");
 
+    lua->PushCFunction(LUA_Kill);
+    lua->SetField(-2, "Kill");
+
+    lua->PushCFunction(LUA_KillInRadius);
+    lua->SetField(-2, "KillInRadius");
+
+    lua->PushCFunction(LUA_SetPosition);
+    lua->SetField(-2, "SetPosition");
+
+    lua->PushCFunction(LUA_FindInRadius);
+    lua->SetField(-2, "FindInRadius");
+
+    lua->PushCFunction(LUA_FindInBox);
+    lua->SetField(-2, "FindInBox");
+
     lua->PushCFunction(LUA_GetTotalParticleCount);
     lua->SetField(-2, "GetTotalParticleCount");
 
     lua->PushCFunction(LUA_InitGPU);
     lua->SetField(-2, "InitGPU");
 
+    lua->PushCFunction(LUA_SetBudget);
+    lua->SetField(-2, "SetBudget");
+
+    lua->PushCFunction(LUA_GetBudget);
+    lua->SetField(-2, "GetBudget");
+
+    lua->PushCFunction(LUA_SetPriority);
+    lua->SetField(-2, "SetPriority");
+
+    lua->PushCFunction(LUA_GetBudgetStats);
+    lua->SetField(-2, "GetBudgetStats");
+
+    lua->PushCFunction(LUA_SetCullDistance);
+    lua->SetField(-2, "SetCullDistance");
+
+    lua->PushCFunction(LUA_GetStats);
+    lua->SetField(-2, "GetStats");
+
+    lua->PushCFunction(LUA_SetSubPixelThreshold);
+    lua->SetField(-2, "SetSubPixelThreshold");
+
+    lua->PushCFunction(LUA_SetReflectionDetail);
+    lua->SetField(-2, "SetReflectionDetail");
+
+    lua->PushCFunction(LUA_SetVertexReuse);
+    lua->SetField(-2, "SetVertexReuse");
+
+    lua->PushCFunction(LUA_SetPointSpriteSize);
+    lua->SetField(-2, "SetPointSpriteSize");
+
+    lua->PushCFunction(LUA_SetUseParticlePool);
+    lua->SetField(-2, "SetUseParticlePool");
+
+    lua->PushCFunction(LUA_SetShareWindow);
+    lua->SetField(-2, "SetShareWindow");
+
+    lua->PushCFunction(LUA_SetUpdateBudget);
+    lua->SetField(-2, "SetUpdateBudget");
+
+    lua->PushCFunction(LUA_SetWorkerThreads);
+    lua->SetField(-2, "SetWorkerThreads");
+
+    lua->PushCFunction(LUA_SetPipelinedUpdate);
+    lua->SetField(-2, "SetPipelinedUpdate");
+
+    lua->PushCFunction(LUA_GetBounds);
+    lua->SetField(-2, "GetBounds");
+
     lua->PushCFunction(LUA_Update);
     lua->SetField(-2, "Update");
 
@@ -0,0 +1,262 @@
+#include "particle_bounds.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace GPUParticles {
+
+// Same constant the simulator uses for gravity
+static const float kGravity = 9.81f;
+
+// ============================================================================
+// BoundingBox
+// ============================================================================
+
+Vector3 BoundingBox::GetCenter() const {
+    return Vector3((mins.x + maxs.x) * 0.5f,
+                   (mins.y + maxs.y) * 0.5f,
+                   (mins.z + maxs.z) * 0.5f);
+}
+
+float BoundingBox::GetRadiusFromOrigin() const {
+    float x = std::max(std::fabs(mins.x), std::fabs(maxs.x));
+    float y = std::max(std::fabs(mins.y), std::fabs(maxs.y));
+    float z = std::max(std::fabs(mins.z), std::fabs(maxs.z));
+    return std::sqrt(x * x + y * y + z * z);
+}
+
+BoundingBox BoundingBox::Offset(const Vector3& offset, float margin) const {
+    return BoundingBox(
+        Vector3(mins.x + offset.x - margin, mins.y + offset.y - margin, mins.z + offset.z - margin),
+        Vector3(maxs.x + offset.x + margin, maxs.y + offset.y + margin, maxs.z + offset.z + margin));
+}
+
+// ============================================================================
+// BoundsAccumulator
+// ============================================================================
+
+void BoundsAccumulator::Reset() {
+#if GPUPARTICLES_SSE
+    m_min = _mm_set1_ps(FLT_MAX);
+    m_max = _mm_set1_ps(-FLT_MAX);
+#else
+    for (int i = 0; i < 4; ++i) {
+        m_min[i] = FLT_MAX;
+        m_max[i] = -FLT_MAX;
+    }
+#endif
+}
+
+void BoundsAccumulator::Merge(const BoundsAccumulator& other) {
+#if GPUPARTICLES_SSE
+    m_min = _mm_min_ps(m_min, other.m_min);
+    m_max = _mm_max_ps(m_max, other.m_max);
+#else
+    for (int i = 0; i < 4; ++i) {
+        m_min[i] = std::min(m_min[i], other.m_min[i]);
+        m_max[i] = std::max(m_max[i], other.m_max[i]);
+    }
+#endif
+}
+
+bool BoundsAccumulator::IsEmpty() const {
+    BoundingBox box = GetBox();
+    return box.mins.x > box.maxs.x;
+}
+
+BoundingBox BoundsAccumulator::GetBox() const {
+#if GPUPARTICLES_SSE
+    float mn[4], mx[4];
+    _mm_storeu_ps(mn, m_min);
+    _mm_storeu_ps(mx, m_max);
+#else
+    const float* mn = m_min;
+    const float* mx = m_max;
+#endif
+    return BoundingBox(Vector3(mn[0], mn[1], mn[2]), Vector3(mx[0], mx[1], mx[2]));
+}
+
+float BoundsAccumulator::GetMaxSize() const {
+#if GPUPARTICLES_SSE
+    float mx[4];
+    _mm_storeu_ps(mx, m_max);
+    return std::max(0.0f, mx[3]);
+#else
+    return std::max(0.0f, m_max[3]);
+#endif
+}
+
+// ============================================================================
+// EffectBounds
+// ============================================================================
+
+namespace {
+
+struct Interval {
+    float lo, hi;
+};
+
+// Product of two intervals
+Interval Multiply(const Interval& a, const Interval& b) {
+    float p0 = a.lo * b.lo, p1 = a.lo * b.hi, p2 = a.hi * b.lo, p3 = a.hi * b.hi;
+    return { std::min(std::min(p0, p1), std::min(p2, p3)),
+             std::max(std::max(p0, p1), std::max(p2, p3)) };
+}
+
+// Interval widened to contain zero (particles start at zero displacement)
+Interval WithZero(const Interval& a) {
+    return { std::min(0.0f, a.lo), std::max(0.0f, a.hi) };
+}
+
+Interval CurveRange(const MinMaxCurve& curve) {
+    return { curve.GetMinValue(), curve.GetMaxValue() };
+}
+
+} // namespace
+
+EffectBounds EffectBounds::Compute(const ParticleSystemData& data) {
+    const float lifetime = std::max(0.0f, data.main.startLifetime.GetMaxValue());
+    const ShapeModule& shape = data.shape;
+
+    // Shape extents and emission direction ranges (mirrors the simulator)
+    Interval extent[3] = { {0, 0}, {0, 0}, {0, 0} };
+    Interval direction[3] = { {0, 0}, {0, 0}, {1, 1} };
+
+    if (shape.enabled) {
+        float r = std::fabs(shape.radius);
+
+        switch (shape.shapeType) {
+            case ParticleSystemShapeType::Cone: {
+                float angle = std::max(0.0f, std::min(180.0f, shape.angle)) * (3.14159f / 180.0f);
+                float spread = std::sin(std::min(angle, 3.14159f * 0.5f));
+                extent[0] = { -r, r };
+                extent[1] = { -r, r };
+                direction[0] = { -spread, spread };
+                direction[1] = { -spread, spread };
+                direction[2] = { std::cos(angle), 1.0f };
+                break;
+            }
+
+            case ParticleSystemShapeType::Sphere:
+                for (int axis = 0; axis < 3; ++axis) {
+                    extent[axis] = { -r, r };
+                    direction[axis] = { -1.0f, 1.0f };
+                }
+                break;
+
+            case ParticleSystemShapeType::Box: {
+                const float half[3] = { 0.5f * std::fabs(shape.scale.x),
+                                        0.5f * std::fabs(shape.scale.y),
+                                        0.5f * std::fabs(shape.scale.z) };
+                for (int axis = 0; axis < 3; ++axis) {
+                    extent[axis] = { -half[axis], half[axis] };
+                }
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        extent[0].lo += shape.position.x; extent[0].hi += shape.position.x;
+        extent[1].lo += shape.position.y; extent[1].hi += shape.position.y;
+        extent[2].lo += shape.position.z; extent[2].hi += shape.position.z;
+    }
+
+    // Displacement over the longest lifetime
+    Interval displacement[3];
+    const VelocityOverLifetimeModule& vol = data.velocityOverLifetime;
+
+    if (vol.enabled && vol.space == ParticleSystemSimulationSpace::Local) {
+        // Velocity over lifetime overwrites the velocity every step
+        const MinMaxCurve* curves[3] = { &vol.x, &vol.y, &vol.z };
+        for (int axis = 0; axis < 3; ++axis) {
+            displacement[axis] = WithZero(Multiply(CurveRange(*curves[axis]), { lifetime, lifetime }));
+        }
+    } else {
+        Interval speed = CurveRange(data.main.startSpeed);
+        Interval travel = { speed.lo * lifetime, speed.hi * lifetime };
+
+        // Constant acceleration a moves a particle by at most a * T^2 / 2
+        Interval accel[3] = { {0, 0}, {0, 0}, {0, 0} };
+        Interval gravity = CurveRange(data.main.gravityModifier);
+        accel[2] = { -kGravity * gravity.hi, -kGravity * gravity.lo };
+
+        if (data.forceOverLifetime.enabled) {
+            const MinMaxCurve* curves[3] = { &data.forceOverLifetime.x,
+                                             &data.forceOverLifetime.y,
+                                             &data.forceOverLifetime.z };
+            for (int axis = 0; axis < 3; ++axis) {
+                Interval force = CurveRange(*curves[axis]);
+                accel[axis].lo += force.lo;
+                accel[axis].hi += force.hi;
+            }
+        }
+
+        const float halfT2 = 0.5f * lifetime * lifetime;
+        for (int axis = 0; axis < 3; ++axis) {
+            Interval move = WithZero(Multiply(direction[axis], travel));
+            Interval fall = WithZero({ accel[axis].lo * halfT2, accel[axis].hi * halfT2 });
+            displacement[axis] = { move.lo + fall.lo, move.hi + fall.hi };
+        }
+    }
+
+    EffectBounds bounds;
+    bounds.box = BoundingBox(
+        Vector3(extent[0].lo + displacement[0].lo,
+                extent[1].lo + displacement[1].lo,
+                extent[2].lo + displacement[2].lo),
+        Vector3(extent[0].hi + displacement[0].hi,
+                extent[1].hi + displacement[1].hi,
+                extent[2].hi + displacement[2].hi));
+
+    // Billboards extend +-size around the particle center
+    float sizeMultiplier = 1.0f;
+    if (data.sizeOverLifetime.enabled) {
+        Interval range = CurveRange(data.sizeOverLifetime.size);
+        sizeMultiplier = std::max(std::fabs(range.lo), std::fabs(range.hi));
+    }
+    Interval startSize = CurveRange(data.main.startSize);
+    bounds.maxParticleSize = std::max(std::fabs(startSize.lo), std::fabs(startSize.hi)) * sizeMultiplier;
+
+    return bounds;
+}
+
+// ============================================================================
+// Frustum
+// ============================================================================
+
+void Frustum::ExtractFromMatrix(const float* m) {
+    // Planes are w +- column k, where column k is (m[k], m[4+k], m[8+k], m[12+k])
+    auto combine = [m](float sign, int k) {
+        Plane p;
+        p.a = m[3] + sign * m[k];
+        p.b = m[7] + sign * m[4 + k];
+        p.c = m[11] + sign * m[8 + k];
+        p.d = m[15] + sign * m[12 + k];
+        return p;
+    };
+
+    m_planes[0] = combine(1.0f, 0);    // Left
+    m_planes[1] = combine(-1.0f, 0);   // Right
+    m_planes[2] = combine(1.0f, 1);    // Bottom
+    m_planes[3] = combine(-1.0f, 1);   // Top
+    m_planes[4] = { m[2], m[6], m[10], m[14] };  // Near (D3D depth starts at 0)
+    m_planes[5] = combine(-1.0f, 2);   // Far
+}
+
+bool Frustum::IntersectsBox(const BoundingBox& box) const {
+    for (const Plane& p : m_planes) {
+        // Corner furthest along the plane normal
+        float x = (p.a >= 0.0f) ? box.maxs.x : box.mins.x;
+        float y = (p.b >= 0.0f) ? box.maxs.y : box.mins.y;
+        float z = (p.c >= 0.0f) ? box.maxs.z : box.mins.z;
+
+        if (p.a * x + p.b * y + p.c * z + p.d < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace GPUParticles
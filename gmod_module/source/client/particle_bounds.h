@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../particle_data.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GPUPARTICLES_SSE 1
+#include <xmmintrin.h>
+#else
+#define GPUPARTICLES_SSE 0
+#endif
+
+namespace GPUParticles {
+
+/**
+ * @brief Axis-aligned bounding box
+ */
+struct BoundingBox {
+    Vector3 mins;
+    Vector3 maxs;
+
+    BoundingBox() : mins(0, 0, 0), maxs(0, 0, 0) {}
+    BoundingBox(const Vector3& mn, const Vector3& mx) : mins(mn), maxs(mx) {}
+
+    Vector3 GetCenter() const;
+
+    /**
+     * @brief Radius of the sphere around the origin that contains the box
+     */
+    float GetRadiusFromOrigin() const;
+
+    /**
+     * @brief Copy of the box moved by an offset and grown by a margin
+     */
+    BoundingBox Offset(const Vector3& offset, float margin) const;
+};
+
+/**
+ * @brief Conservative bounds of an effect's particle positions
+ *
+ * Computed once at load time from the shape extents, start speed,
+ * lifetime, gravity and force/velocity modules. The box is in emitter
+ * space and covers particle centers only; maxParticleSize must be added
+ * (times the instance scale) to cover the rendered quads.
+ */
+struct EffectBounds {
+    BoundingBox box;
+    float maxParticleSize;
+
+    EffectBounds() : maxParticleSize(0.0f) {}
+
+    static EffectBounds Compute(const ParticleSystemData& data);
+};
+
+/**
+ * @brief Running min/max of particle positions and sizes
+ *
+ * Fed once per particle from the simulation loop, so tight bounds come
+ * for free without a second pass. Min/max is exact and order independent:
+ * partial accumulators from chunked updates merge to the same result in
+ * any order.
+ */
+class BoundsAccumulator {
+public:
+    BoundsAccumulator() { Reset(); }
+
+    void Reset();
+    void Add(const Vector3& position, float size);
+    void Merge(const BoundsAccumulator& other);
+
+    /**
+     * @brief True if nothing was added since the last reset
+     */
+    bool IsEmpty() const;
+
+    /**
+     * @brief Box around the particle centers
+     */
+    BoundingBox GetBox() const;
+
+    /**
+     * @brief Largest particle size added
+     */
+    float GetMaxSize() const;
+
+private:
+#if GPUPARTICLES_SSE
+    // Lanes are x, y, z, size
+    __m128 m_min;
+    __m128 m_max;
+#else
+    float m_min[4];
+    float m_max[4];
+#endif
+};
+
+inline void BoundsAccumulator::Add(const Vector3& position, float size) {
+#if GPUPARTICLES_SSE
+    __m128 v = _mm_set_ps(size, position.z, position.y, position.x);
+    m_min = _mm_min_ps(m_min, v);
+    m_max = _mm_max_ps(m_max, v);
+#else
+    const float v[4] = { position.x, position.y, position.z, size };
+    for (int i = 0; i < 4; ++i) {
+        m_min[i] = (v[i] < m_min[i]) ? v[i] : m_min[i];
+        m_max[i] = (v[i] > m_max[i]) ? v[i] : m_max[i];
+    }
+#endif
+}
+
+/**
+ * @brief View frustum for visibility tests
+ */
+class Frustum {
+public:
+    /**
+     * @brief Extract the six planes from a row-vector view-projection matrix
+     * @param viewProj 4x4 matrix (row-major, clip = pos * viewProj, D3D depth 0-1)
+     */
+    void ExtractFromMatrix(const float* viewProj);
+
+    /**
+     * @brief Test a box against the frustum
+     * @return False only if the box is completely outside
+     */
+    bool IntersectsBox(const BoundingBox& box) const;
+
+private:
+    struct Plane {
+        float a, b, c, d;
+    };
+
+    Plane m_planes[6];
+};
+
+} // namespace GPUParticles
@@ -0,0 +1,146 @@
+#include "particle_budget.h"
+#include <algorithm>
+#include <cmath>
+
+namespace GPUParticles {
+
+// Instances never drop below this fraction of their detail from distance alone
+static const float kMinLODFactor = 0.05f;
+
+// Limits on how much a thinned-out effect is enlarged / made more opaque
+static const float kMaxSizeCompensation = 2.0f;
+static const float kMaxAlphaCompensation = 2.0f;
+
+ParticleBudgetManager::ParticleBudgetManager()
+    : m_budget(20000)
+    , m_tanHalfFov(std::tan(75.0f * 0.5f * 3.14159f / 180.0f))
+    , m_fullDetailScreenSize(0.1f)
+    , m_lastDemand(0)
+    , m_lastAllocated(0)
+    , m_lastCulled(0)
+{
+}
+
+void ParticleBudgetManager::SetBudget(int maxParticles) {
+    m_budget = std::max(0, maxParticles);
+}
+
+void ParticleBudgetManager::SetFieldOfView(float fovDegrees) {
+    fovDegrees = std::max(1.0f, std::min(179.0f, fovDegrees));
+    m_tanHalfFov = std::tan(fovDegrees * 0.5f * 3.14159f / 180.0f);
+}
+
+void ParticleBudgetManager::SetFullDetailScreenSize(float fraction) {
+    m_fullDetailScreenSize = std::max(0.001f, fraction);
+}
+
+float ParticleBudgetManager::ComputeLODFactor(const BudgetRequest& request) const {
+    if (request.radius <= 0.0f || request.distance <= request.radius) {
+        return 1.0f;
+    }
+
+    // Radius of the effect as a fraction of the half-screen
+    float screenSize = request.radius / (request.distance * m_tanHalfFov);
+    float lod = screenSize / m_fullDetailScreenSize;
+
+    return std::max(kMinLODFactor, std::min(1.0f, lod));
+}
+
+void ParticleBudgetManager::Allocate(const std::vector<BudgetRequest>& requests,
+                                     std::vector<BudgetAllocation>& allocations) {
+    const size_t count = requests.size();
+    allocations.assign(count, BudgetAllocation());
+    m_demand.assign(count, 0.0f);
+    m_weight.assign(count, 0.0f);
+
+    // Demand and weight of each instance after distance/screen size LOD
+    float totalDemand = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        const BudgetRequest& request = requests[i];
+        float lod = ComputeLODFactor(request);
+
+        m_demand[i] = std::max(0, request.maxParticles) * lod;
+        m_weight[i] = std::max(0.0f, request.priority) * lod;
+        totalDemand += m_demand[i];
+    }
+
+    // Within budget every instance gets its full demand
+    std::vector<float>& share = m_share;
+    share = m_demand;
+
+    if (totalDemand > static_cast<float>(m_budget)) {
+        // Over budget: water-fill the budget by weight. Instances whose
+        // weighted share exceeds their demand are satisfied first and the
+        // leftover is redistributed among the rest.
+        std::vector<float>& need = m_demand;
+        std::fill(share.begin(), share.end(), 0.0f);
+
+        float remaining = static_cast<float>(m_budget);
+        for (size_t pass = 0; pass < count && remaining > 0.5f; ++pass) {
+            float weightSum = 0.0f;
+            for (size_t i = 0; i < count; ++i) {
+                if (need[i] > 0.0f) {
+                    weightSum += m_weight[i];
+                }
+            }
+            if (weightSum <= 0.0f) {
+                break;
+            }
+
+            bool saturated = false;
+            for (size_t i = 0; i < count; ++i) {
+                if (need[i] > 0.0f && remaining * m_weight[i] / weightSum >= need[i]) {
+                    share[i] += need[i];
+                    remaining -= need[i];
+                    need[i] = 0.0f;
+                    saturated = true;
+                }
+            }
+
+            if (!saturated) {
+                for (size_t i = 0; i < count; ++i) {
+                    if (need[i] > 0.0f) {
+                        share[i] += remaining * m_weight[i] / weightSum;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // Convert shares to caps (flooring keeps the sum within budget)
+    m_lastDemand = static_cast<int>(totalDemand);
+    m_lastAllocated = 0;
+    m_lastCulled = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const BudgetRequest& request = requests[i];
+        BudgetAllocation& allocation = allocations[i];
+
+        allocation.particleCap = static_cast<int>(share[i]);
+        m_lastAllocated += allocation.particleCap;
+
+        if (request.maxParticles <= 0) {
+            continue;
+        }
+
+        if (allocation.particleCap == 0) {
+            allocation.emissionScale = 0.0f;
+            m_lastCulled++;
+            continue;
+        }
+
+        float scale = std::min(1.0f, static_cast<float>(allocation.particleCap) / request.maxParticles);
+        allocation.emissionScale = scale;
+
+        if (scale < 1.0f) {
+            // Fewer particles: grow them to cover the same area, then use
+            // alpha for whatever coverage the size clamp couldn't recover
+            allocation.sizeCompensation = std::min(1.0f / std::sqrt(scale), kMaxSizeCompensation);
+            float coverage = scale * allocation.sizeCompensation * allocation.sizeCompensation;
+            allocation.alphaCompensation = std::min(1.0f / coverage, kMaxAlphaCompensation);
+        }
+    }
+}
+
+} // namespace GPUParticles
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Per-instance input to the budget allocation
+ */
+struct BudgetRequest {
+    int maxParticles;    // Authored particle limit of the effect
+    float priority;      // Relative importance (1 = normal)
+    float distance;      // Distance from the camera in world units
+    float radius;        // Approximate world-space radius of the effect
+
+    BudgetRequest() : maxParticles(0), priority(1.0f), distance(0.0f), radius(0.0f) {}
+};
+
+/**
+ * @brief Per-instance result of the budget allocation
+ */
+struct BudgetAllocation {
+    float emissionScale;      // Fraction of authored emission to keep
+    int particleCap;          // Hard limit on alive particles
+    float sizeCompensation;   // Size multiplier to keep visual coverage
+    float alphaCompensation;  // Alpha multiplier for coverage size can't recover
+
+    BudgetAllocation() : emissionScale(1.0f), particleCap(0),
+                         sizeCompensation(1.0f), alphaCompensation(1.0f) {}
+};
+
+/**
+ * @brief Global particle budget with priority and distance based LOD
+ *
+ * Each frame every active instance is weighted by its priority and by
+ * its projected screen size. The total particle count is capped at the
+ * budget: instances share it in proportion to their weight, and the
+ * emission they lose is compensated with larger, more opaque particles
+ * so the effect keeps roughly the same visual density.
+ */
+class ParticleBudgetManager {
+public:
+    ParticleBudgetManager();
+
+    /**
+     * @brief Set the maximum number of particles alive across all instances
+     */
+    void SetBudget(int maxParticles);
+    int GetBudget() const { return m_budget; }
+
+    /**
+     * @brief Set the camera field of view used for screen size estimates
+     * @param fovDegrees Horizontal field of view in degrees
+     */
+    void SetFieldOfView(float fovDegrees);
+
+    /**
+     * @brief Screen fraction at which an effect is simulated at full detail
+     * @param fraction Effect radius as a fraction of the half-screen (0-1)
+     */
+    void SetFullDetailScreenSize(float fraction);
+
+    /**
+     * @brief Compute the allocation of every instance for this frame
+     * @param requests One entry per instance
+     * @param allocations Output, resized to match requests
+     */
+    void Allocate(const std::vector<BudgetRequest>& requests,
+                  std::vector<BudgetAllocation>& allocations);
+
+    // Statistics from the last allocation
+    int GetLastDemand() const { return m_lastDemand; }
+    int GetLastAllocated() const { return m_lastAllocated; }
+    int GetLastCulledCount() const { return m_lastCulled; }
+
+private:
+    float ComputeLODFactor(const BudgetRequest& request) const;
+
+    int m_budget;
+    float m_tanHalfFov;
+    float m_fullDetailScreenSize;
+
+    // Scratch buffers reused between frames
+    std::vector<float> m_demand;
+    std::vector<float> m_weight;
+    std::vector<float> m_share;
+
+    int m_lastDemand;
+    int m_lastAllocated;
+    int m_lastCulled;
+};
+
+} // namespace GPUParticles
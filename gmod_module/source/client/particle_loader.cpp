@@ -1,7 +1,10 @@
 #include "particle_loader.h"
+#include "compiled_effect.h"
 #include <nlohmann/json.hpp>
+#include <cstring>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <iostream>
 
 using json = nlohmann::json;
@@ -13,33 +16,61 @@ namespace GPUParticles {
 // ============================================================================
 
 std::unique_ptr<ParticleSystemData> ParticleLoader::LoadFromFile(const std::string& filepath) {
-    try {
-        std::cout << "[ParticleLoader] Attempting to open: " << filepath << std::endl;
+    std::cout << "[ParticleLoader] Attempting to open: " << filepath << std::endl;
 
-        std::ifstream file(filepath);
-        if (!file.is_open()) {
-            m_lastError = "Failed to open file: " + filepath;
-            std::cerr << "[ParticleLoader] File does not exist or cannot be opened" << std::endl;
-            return nullptr;
-        }
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        m_lastError = "Failed to open file: " + filepath;
+        std::cerr << "[ParticleLoader] File does not exist or cannot be opened" << std::endl;
+        return nullptr;
+    }
 
-        std::cout << "[ParticleLoader] File opened successfully, parsing JSON..." << std::endl;
+    // One read into a word-aligned buffer, so a compiled effect is used in place
+    const std::streamoff size = file.tellg();
+    std::vector<uint32_t> buffer((static_cast<size_t>(size) + 3) / 4);
+    file.seekg(0);
+    if (size < 0 || !file.read(reinterpret_cast<char*>(buffer.data()), size)) {
+        m_lastError = "Failed to read file: " + filepath;
+        std::cerr << "[ParticleLoader] " << m_lastError << std::endl;
+        return nullptr;
+    }
 
-        json j;
-        file >> j;
+    if (CompiledEffect::IsCompiled(buffer.data(), static_cast<size_t>(size))) {
+        return LoadCompiled(buffer.data(), static_cast<size_t>(size));
+    }
+    return LoadFromString(std::string(reinterpret_cast<const char*>(buffer.data()), static_cast<size_t>(size)));
+}
 
-        std::cout << "[ParticleLoader] JSON parsed successfully" << std::endl;
+std::unique_ptr<ParticleSystemData> ParticleLoader::LoadCompiled(const void* data, size_t size) {
+    // Lua strings and other callers' buffers need not be aligned for the records
+    std::vector<uint32_t> aligned;
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+        aligned.resize((size + 3) / 4);
+        std::memcpy(aligned.data(), data, size);
+        data = aligned.data();
+    }
 
-        return LoadFromString(j.dump());
+    CompiledEffectView view;
+    std::string error;
+    std::unique_ptr<ParticleSystemData> system;
+    if (view.Open(data, size, error)) {
+        system = view.ToSystemData(error);
     }
-    catch (const std::exception& e) {
-        m_lastError = std::string("JSON parse error: ") + e.what();
-        std::cerr << "[ParticleLoader] Exception: " << e.what() << std::endl;
+    if (!system) {
+        m_lastError = "Compiled effect error: " + error;
+        std::cerr << "[ParticleLoader] " << m_lastError << std::endl;
         return nullptr;
     }
+
+    m_lastError.clear();
+    return system;
 }
 
 std::unique_ptr<ParticleSystemData> ParticleLoader::LoadFromString(const std::string& jsonString) {
+    if (CompiledEffect::IsCompiled(jsonString.data(), jsonString.size())) {
+        return LoadCompiled(jsonString.data(), jsonString.size());
+    }
+
     try {
         json j = json::parse(jsonString);
 
@@ -524,6 +555,7 @@ void ParticleLoader::ParseRendererModule(RendererModule& module, const json& j)
     module.lengthScale = j.value("lengthScale", 2.0f);
     module.normalDirection = j.value("normalDirection", 1.0f);
     module.sortingOrder = j.value("sortingOrder", 0);
+    module.hullVertices = j.value("hullVertices", 0);
 
     if (j.contains("renderMode")) {
         module.renderMode = ParseRenderMode(j["renderMode"].get<std::string>());
@@ -8,7 +8,8 @@
 namespace GPUParticles {
 
 /**
- * @brief Loads particle system data from .gpart JSON files
+ * @brief Loads particle system data from .gpart JSON files or compiled
+ *        .gpartc files (see CompiledEffect), told apart by content
  */
 class ParticleLoader {
 public:
@@ -24,11 +25,19 @@ public:
 
     /**
      * @brief Load a particle system from a JSON string
-     * @param jsonString JSON string containing particle data
+     * @param jsonString JSON string containing particle data, or the bytes of a compiled effect
      * @return Particle system data, or nullptr on failure
      */
     std::unique_ptr<ParticleSystemData> LoadFromString(const std::string& jsonString);
 
+    /**
+     * @brief Load a particle system from a compiled effect in memory
+     * @param data File image written by gpartc (copied first if not 4-byte aligned)
+     * @param size Size in bytes
+     * @return Particle system data, or nullptr on failure
+     */
+    std::unique_ptr<ParticleSystemData> LoadCompiled(const void* data, size_t size);
+
     /**
      * @brief Get the last error message
      */
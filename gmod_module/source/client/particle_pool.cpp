@@ -0,0 +1,561 @@
+#include "particle_pool.h"
+#include <algorithm>
+
+namespace GPUParticles {
+
+namespace {
+
+// m_unitRange entries that are not a source range index
+const uint32_t kSingleUnit = 0xFFFFFFFFu;
+const uint32_t kInsideUnit = 0xFFFFFFFEu;
+
+bool IsAgeSort(ParticleSystemSortMode mode) {
+    return mode == ParticleSystemSortMode::OldestInFront || mode == ParticleSystemSortMode::YoungestInFront;
+}
+
+} // namespace
+
+ParticlePool::ParticlePool()
+    : m_packetsReused(0)
+    , m_verticesPerParticle(4)
+    , m_shapes(1)
+{
+}
+
+void ParticlePool::Clear() {
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_size.clear();
+    m_rotation.clear();
+    m_color.clear();
+    m_age.clear();
+    m_velocity.clear();
+    m_oriented.clear();
+    m_axisX.clear();
+    m_axisY.clear();
+    m_ranges.clear();
+    m_sourceRanges.clear();
+    m_points.clear();
+    m_verticesPerParticle = 4;
+    m_shapes.assign(1, ParticleShape());
+    m_shapeSources.clear();
+    m_shapeIndex.clear();
+
+    // Unsorted until SortBackToFront runs again (m_units keeps the guess)
+    m_order.clear();
+}
+
+void ParticlePool::Fill(const std::vector<Source>& sources, const ScreenSizeFilter* sizeFilter, WorkerPool* workers) {
+    Clear();
+
+    // Exclusive prefix sum of alive counts gives every instance its slots
+    const uint32_t sourceCount = static_cast<uint32_t>(sources.size());
+    m_offsets.resize(sourceCount + 1);
+    m_offsets[0] = 0;
+    m_sourceShapes.assign(sourceCount, 0);
+    m_written.assign(sourceCount, 0);
+    m_pointsWritten.assign(sourceCount, 0);
+    m_sourceStats.assign(sourceCount, ScreenSizeStats());
+    m_sourceReused.assign(sourceCount, 0);
+    bool anyOriented = false;
+    bool anyAgeSorted = false;
+    for (uint32_t i = 0; i < sourceCount; ++i) {
+        const Source& source = sources[i];
+        const uint32_t alive = static_cast<uint32_t>(std::max(0, source.aliveCount));
+        m_offsets[i + 1] = m_offsets[i] + alive;
+
+        if (alive == 0) {
+            continue;
+        }
+
+        // Effects share their renderer-owned shapes, so a handful of
+        // pointers cover the whole pool
+        auto known = std::find(m_shapeSources.begin(), m_shapeSources.end(), source.shape);
+        if (known == m_shapeSources.end()) {
+            m_shapeSources.push_back(source.shape);
+            known = m_shapeSources.end() - 1;
+        }
+        m_sourceShapes[i] = static_cast<uint8_t>(known - m_shapeSources.begin());
+        anyOriented = anyOriented || !source.renderMode.IsCameraFacing();
+        anyAgeSorted = anyAgeSorted || IsAgeSort(source.sortMode);
+    }
+
+    if (!m_shapeSources.empty()) {
+        m_shapes.clear();
+        for (const ParticleShape* shape : m_shapeSources) {
+            m_shapes.push_back(shape ? *shape : ParticleShape());
+            m_verticesPerParticle = std::max(m_verticesPerParticle,
+                                             ParticleShape::GetStreamVertexCount(m_shapes.back().vertexCount));
+        }
+        for (ParticleShape& shape : m_shapes) {
+            shape = shape.PaddedTo(m_verticesPerParticle);
+        }
+    }
+
+    const uint32_t total = m_offsets[sourceCount];
+    m_x.resize(total);
+    m_y.resize(total);
+    m_z.resize(total);
+    m_size.resize(total);
+    m_rotation.resize(total);
+    m_color.resize(total);
+    if (anyOriented) {
+        m_velocity.resize(total);
+    }
+    if (anyAgeSorted) {
+        m_age.resize(total);
+    }
+    if (m_shapes.size() > 1) {
+        m_shapeIndex.resize(total);
+    }
+    if (sizeFilter && sizeFilter->GetPointSpriteSize() > 0.0f) {
+        m_points.resize(total);
+    }
+
+    auto writeRange = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const Source& source = sources[i];
+            if (!source.packet) {
+                m_written[i] = WriteInstance(source, m_sourceShapes[i], sizeFilter, m_sourceStats[i],
+                                             m_offsets[i], m_offsets[i + 1], m_pointsWritten[i]);
+                continue;
+            }
+
+            // Each packet belongs to one instance, so no two tasks build the same one
+            if (source.packet->IsCurrent(source)) {
+                m_sourceReused[i] = 1;
+            } else {
+                source.packet->Build(source);
+            }
+            m_written[i] = WritePacket(source, m_sourceShapes[i], sizeFilter, m_sourceStats[i],
+                                       m_offsets[i], m_offsets[i + 1], m_pointsWritten[i]);
+        }
+    };
+
+    if (workers) {
+        // A handful of instances per task keeps small effects from
+        // costing more in hand-off than in copying
+        workers->ParallelFor(sourceCount, 4, writeRange);
+    } else {
+        writeRange(0, sourceCount);
+    }
+
+    Compact(sources);
+
+    m_sizeStats = ScreenSizeStats();
+    for (const ScreenSizeStats& stats : m_sourceStats) {
+        m_sizeStats.Add(stats);
+    }
+    m_packetsReused = static_cast<uint32_t>(std::count(m_sourceReused.begin(), m_sourceReused.end(), 1));
+}
+
+void ParticlePool::Compact(const std::vector<Source>& sources) {
+    // Close the gaps left by thinned particles (and by alive counts that
+    // overstate the alive flags). Ranges only move down, so copying front
+    // to back never overwrites what is still to be moved.
+    const uint32_t sourceCount = static_cast<uint32_t>(sources.size());
+    uint32_t total = 0;
+    uint32_t pointTotal = 0;
+
+    for (uint32_t i = 0; i < sourceCount; ++i) {
+        const uint32_t begin = m_offsets[i];
+        const uint32_t count = m_written[i];
+
+        if (m_pointsWritten[i] > 0 && begin != pointTotal) {
+            std::copy(m_points.begin() + begin, m_points.begin() + begin + m_pointsWritten[i],
+                      m_points.begin() + pointTotal);
+        }
+        pointTotal += m_pointsWritten[i];
+
+        if (begin != total && count > 0) {
+            auto move = [&](auto& values) {
+                if (!values.empty()) {
+                    std::copy(values.begin() + begin, values.begin() + begin + count, values.begin() + total);
+                }
+            };
+            move(m_x);
+            move(m_y);
+            move(m_z);
+            move(m_size);
+            move(m_rotation);
+            move(m_color);
+            move(m_age);
+            move(m_velocity);
+            move(m_shapeIndex);
+        }
+
+        m_offsets[i] = total;
+        if (count > 0) {
+            const Source& source = sources[i];
+            if (!m_ranges.empty() && m_ranges.back().templateIndex == source.templateIndex) {
+                m_ranges.back().count += count;
+            } else {
+                m_ranges.push_back({ source.templateIndex, total, count, source.renderMode });
+            }
+            m_sourceRanges.push_back({ total, count, source.packet, m_sourceReused[i] != 0,
+                                       !source.renderMode.IsCameraFacing(), source.sortMode, source.position });
+        }
+        total += count;
+    }
+    m_offsets[sourceCount] = total;
+
+    m_x.resize(total);
+    m_y.resize(total);
+    m_z.resize(total);
+    m_size.resize(total);
+    m_rotation.resize(total);
+    m_color.resize(total);
+    if (!m_age.empty()) {
+        m_age.resize(total);
+    }
+    if (!m_velocity.empty()) {
+        m_velocity.resize(total);
+    }
+    if (!m_shapeIndex.empty()) {
+        m_shapeIndex.resize(total);
+    }
+    m_points.resize(pointTotal);
+}
+
+uint32_t ParticlePool::WriteInstance(const Source& source,
+                                     uint8_t shape,
+                                     const ScreenSizeFilter* sizeFilter,
+                                     ScreenSizeStats& stats,
+                                     uint32_t offset,
+                                     uint32_t end,
+                                     uint32_t& pointsWritten) {
+    const Vector3& position = source.position;
+    const Vector3f emitter(position.x, position.y, position.z);
+    const Color& tint = source.tint;
+    const std::vector<Particle>& particles = *source.particles;
+    uint32_t slot = offset;
+    uint32_t pointSlot = offset;
+
+    if (!m_shapeIndex.empty()) {
+        std::fill(m_shapeIndex.begin() + offset, m_shapeIndex.begin() + end, shape);
+    }
+
+    for (uint32_t j = 0; j < particles.size() && slot < end; ++j) {
+        const Particle& p = particles[j];
+        if (!p.alive) {
+            continue;
+        }
+
+        const Vector3f center(p.position.x + position.x, p.position.y + position.y, p.position.z + position.z);
+        float size = p.size * source.scale;
+        float alphaScale = source.alphaScale;
+        const uint32_t key = sizeFilter ? ScreenSizeFilter::GetParticleKey(j, p.lifetime, emitter) : 0;
+        if (sizeFilter &&
+            !sizeFilter->Apply(source.renderMode, center, key, p.color.a * tint.a, size, alphaScale, stats)) {
+            continue;
+        }
+
+        const uint32_t color = PackParticleColor(p.color, tint, alphaScale, source.blend);
+        if (sizeFilter && WritePoint(source, *sizeFilter, center, size, color, key, stats, pointSlot)) {
+            continue;
+        }
+
+        m_x[slot] = center.x;
+        m_y[slot] = center.y;
+        m_z[slot] = center.z;
+        m_size[slot] = size;
+        m_rotation[slot] = p.rotation;
+        m_color[slot] = color;
+        if (!m_age.empty()) {
+            m_age[slot] = p.age;
+        }
+        if (!m_velocity.empty()) {
+            const Vector3f& velocityScale = source.renderMode.velocityScale;
+            m_velocity[slot] = Vector3f(p.velocity.x * velocityScale.x,
+                                        p.velocity.y * velocityScale.y,
+                                        p.velocity.z * velocityScale.z);
+        }
+        slot++;
+    }
+
+    pointsWritten = pointSlot - offset;
+    return slot - offset;
+}
+
+uint32_t ParticlePool::WritePacket(const Source& source,
+                                   uint8_t shape,
+                                   const ScreenSizeFilter* sizeFilter,
+                                   ScreenSizeStats& stats,
+                                   uint32_t offset,
+                                   uint32_t end,
+                                   uint32_t& pointsWritten) {
+    const ParticlePacket& packet = *source.packet;
+    const uint32_t count = std::min(packet.GetCount(), end - offset);
+    const bool copyVelocity = !m_velocity.empty() && !packet.velocity.empty();
+    const bool copyAge = !m_age.empty() && !packet.age.empty();
+    uint32_t slot = offset;
+    uint32_t pointSlot = offset;
+
+    if (!m_shapeIndex.empty()) {
+        std::fill(m_shapeIndex.begin() + offset, m_shapeIndex.begin() + end, shape);
+    }
+
+    for (uint32_t k = 0; k < count; ++k) {
+        const Vector3f center(packet.x[k], packet.y[k], packet.z[k]);
+        float size = packet.size[k];
+        float alphaScale = 1.0f;
+        if (sizeFilter &&
+            !sizeFilter->Apply(source.renderMode, center, packet.key[k], packet.opacity[k], size, alphaScale, stats)) {
+            continue;
+        }
+
+        const uint32_t color = (alphaScale == 1.0f) ? packet.color[k]
+                                                    : ScaleParticleAlpha(packet.color[k], alphaScale, packet.blend);
+        if (sizeFilter && WritePoint(source, *sizeFilter, center, size, color, packet.key[k], stats, pointSlot)) {
+            continue;
+        }
+
+        m_x[slot] = center.x;
+        m_y[slot] = center.y;
+        m_z[slot] = center.z;
+        m_size[slot] = size;
+        m_rotation[slot] = packet.rotation[k];
+        m_color[slot] = color;
+        if (copyAge) {
+            m_age[slot] = packet.age[k];
+        }
+        if (copyVelocity) {
+            m_velocity[slot] = packet.velocity[k];
+        }
+        slot++;
+    }
+
+    pointsWritten = pointSlot - offset;
+    return slot - offset;
+}
+
+bool ParticlePool::WritePoint(const Source& source,
+                              const ScreenSizeFilter& sizeFilter,
+                              const Vector3f& center,
+                              float size,
+                              uint32_t color,
+                              uint32_t key,
+                              ScreenSizeStats& stats,
+                              uint32_t& pointSlot) {
+    float pixels = 0.0f;
+    if (m_points.empty() || !sizeFilter.IsPointSprite(source.renderMode, center, size, pixels)) {
+        return false;
+    }
+
+    if (RenderPacketBuilder::PackPointSprite(center, color, pixels, source.blend, key, m_points[pointSlot])) {
+        pointSlot++;
+        stats.pointSprites++;
+    } else {
+        stats.pointCulled++;
+    }
+    return true;
+}
+
+void ParticlePool::OrientQuads(const CameraData& camera, WorkerPool* workers) {
+    if (m_velocity.empty()) {
+        return;
+    }
+
+    const uint32_t count = GetCount();
+    m_oriented.assign(count, 0);
+    m_axisX.resize(count);
+    m_axisY.resize(count);
+
+    for (const TemplateRange& range : m_ranges) {
+        if (range.renderMode.IsCameraFacing()) {
+            continue;
+        }
+
+        auto orientRange = [&](uint32_t begin, uint32_t end) {
+            OrientedQuadBatch batch;
+            for (uint32_t start = range.begin + begin; start < range.begin + end; start += OrientedQuadBatch::kCapacity) {
+                const uint32_t batchCount = std::min(OrientedQuadBatch::kCapacity, range.begin + end - start);
+
+                for (uint32_t k = 0; k < batchCount; ++k) {
+                    const uint32_t i = start + k;
+                    batch.x[k] = m_x[i];
+                    batch.y[k] = m_y[i];
+                    batch.z[k] = m_z[i];
+                    batch.vx[k] = m_velocity[i].x;
+                    batch.vy[k] = m_velocity[i].y;
+                    batch.vz[k] = m_velocity[i].z;
+                    batch.size[k] = m_size[i];
+                    batch.rotation[k] = m_rotation[i];
+                }
+
+                RenderPacketBuilder::OrientQuads(range.renderMode, camera, batch, batchCount);
+
+                for (uint32_t k = 0; k < batchCount; ++k) {
+                    const uint32_t i = start + k;
+                    m_axisX[i] = Vector3f(batch.axisXx[k], batch.axisXy[k], batch.axisXz[k]);
+                    m_axisY[i] = Vector3f(batch.axisYx[k], batch.axisYy[k], batch.axisYz[k]);
+                    m_oriented[i] = 1;
+                }
+            }
+        };
+
+        if (workers) {
+            workers->ParallelFor(range.count, RenderPacketBuilder::kMinParticlesPerTask, orientRange);
+        } else {
+            orientRange(0, range.count);
+        }
+    }
+}
+
+void ParticlePool::SortBackToFront(const Vector3& cameraPos, WorkerPool* workers) {
+    const uint32_t count = GetCount();
+
+    m_keys.resize(count);
+    auto computeKeys = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            float dx = m_x[i] - cameraPos.x;
+            float dy = m_y[i] - cameraPos.y;
+            float dz = m_z[i] - cameraPos.z;
+            m_keys[i] = ParticleSorter::DescendingKey(dx * dx + dy * dy + dz * dz);
+        }
+    };
+
+    if (workers) {
+        workers->ParallelFor(count, RenderPacketBuilder::kMinParticlesPerTask, computeKeys);
+    } else {
+        computeKeys(0, count);
+    }
+
+    // An age-sorted range becomes one unit, keyed by its emitter's depth
+    // and named by its first particle
+    uint32_t unitCount = count;
+    m_unitLayout.assign(1, count);
+    m_unitRange.clear();
+    if (!m_age.empty()) {
+        m_unitRange.assign(count, kSingleUnit);
+        for (uint32_t r = 0; r < m_sourceRanges.size(); ++r) {
+            const SourceRange& range = m_sourceRanges[r];
+            if (!IsAgeSort(range.sortMode) || range.count == 0) {
+                continue;
+            }
+
+            std::fill(m_unitRange.begin() + range.begin, m_unitRange.begin() + range.begin + range.count, kInsideUnit);
+            m_unitRange[range.begin] = r;
+            float dx = range.emitter.x - cameraPos.x;
+            float dy = range.emitter.y - cameraPos.y;
+            float dz = range.emitter.z - cameraPos.z;
+            m_keys[range.begin] = ParticleSorter::DescendingKey(dx * dx + dy * dy + dz * dz);
+
+            unitCount -= range.count - 1;
+            m_unitLayout.push_back(range.begin);
+            m_unitLayout.push_back(range.count);
+        }
+    }
+
+    // Unit names are only stable while the per-instance counts are, so a
+    // layout change restarts from storage order
+    if (m_units.size() != unitCount || m_unitLayout != m_previousLayout) {
+        m_units.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            if (m_unitRange.empty() || m_unitRange[i] != kInsideUnit) {
+                m_units.push_back(i);
+            }
+        }
+    }
+    m_previousLayout.swap(m_unitLayout);
+
+    m_sorter.Sort(m_keys.data(), m_units, workers);
+
+    if (m_unitRange.empty()) {
+        m_order = m_units;
+        return;
+    }
+
+    // Expand each age-sorted unit into its particles, oldest or youngest last
+    m_order.clear();
+    m_ageKeys.resize(count);
+    for (uint32_t unit : m_units) {
+        const uint32_t r = m_unitRange[unit];
+        if (r == kSingleUnit) {
+            m_order.push_back(unit);
+            continue;
+        }
+
+        const SourceRange& range = m_sourceRanges[r];
+        m_rangeOrder.resize(range.count);
+        for (uint32_t k = 0; k < range.count; ++k) {
+            const uint32_t i = range.begin + k;
+            m_rangeOrder[k] = i;
+            m_ageKeys[i] = (range.sortMode == ParticleSystemSortMode::OldestInFront)
+                               ? ParticleSorter::FloatKey(m_age[i])
+                               : ParticleSorter::DescendingKey(m_age[i]);
+        }
+        m_rangeSorter.Sort(m_ageKeys.data(), m_rangeOrder);
+        m_order.insert(m_order.end(), m_rangeOrder.begin(), m_rangeOrder.end());
+    }
+}
+
+// ============================================================================
+// ParticlePacket
+// ============================================================================
+
+bool ParticlePacket::IsCurrent(const ParticlePool::Source& source) const {
+    const Vector3f& velocityScale = source.renderMode.velocityScale;
+    return version != 0 && version == source.version &&
+           position.x == source.position.x && position.y == source.position.y && position.z == source.position.z &&
+           scale == source.scale && alphaScale == source.alphaScale &&
+           tint.r == source.tint.r && tint.g == source.tint.g && tint.b == source.tint.b && tint.a == source.tint.a &&
+           blend == source.blend && sortMode == source.sortMode &&
+           velocityScale.x == this->velocityScale.x && velocityScale.y == this->velocityScale.y &&
+           velocityScale.z == this->velocityScale.z;
+}
+
+void ParticlePacket::Build(const ParticlePool::Source& source) {
+    version = source.version;
+    position = source.position;
+    scale = source.scale;
+    alphaScale = source.alphaScale;
+    tint = source.tint;
+    blend = source.blend;
+    sortMode = source.sortMode;
+    velocityScale = source.renderMode.velocityScale;
+    vertexCache.Invalidate();
+
+    x.clear();
+    y.clear();
+    z.clear();
+    size.clear();
+    rotation.clear();
+    color.clear();
+    opacity.clear();
+    key.clear();
+    velocity.clear();
+    age.clear();
+
+    const bool withVelocity = !source.renderMode.IsCameraFacing();
+    const bool withAge = IsAgeSort(sortMode);
+    const Vector3f emitter(position.x, position.y, position.z);
+    const std::vector<Particle>& particles = *source.particles;
+
+    for (uint32_t j = 0; j < particles.size(); ++j) {
+        const Particle& p = particles[j];
+        if (!p.alive) {
+            continue;
+        }
+
+        x.push_back(p.position.x + position.x);
+        y.push_back(p.position.y + position.y);
+        z.push_back(p.position.z + position.z);
+        size.push_back(p.size * scale);
+        rotation.push_back(p.rotation);
+        color.push_back(PackParticleColor(p.color, tint, alphaScale, blend));
+        opacity.push_back(p.color.a * tint.a * alphaScale);
+        key.push_back(ScreenSizeFilter::GetParticleKey(j, p.lifetime, emitter));
+        if (withVelocity) {
+            velocity.push_back(Vector3f(p.velocity.x * velocityScale.x,
+                                        p.velocity.y * velocityScale.y,
+                                        p.velocity.z * velocityScale.z));
+        }
+        if (withAge) {
+            age.push_back(p.age);
+        }
+    }
+}
+
+} // namespace GPUParticles
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "cpu_particle_simulator.h"
+#include "particle_sort.h"
+#include "render_packet.h"
+#include "worker_pool.h"
+#include <cstdint>
+#include <vector>
+
+namespace GPUParticles {
+
+struct ParticlePacket;
+
+/**
+ * @brief World-space particles of every drawn instance in one SoA pool
+ *
+ * Filled each frame from the visible instances, grouped by effect
+ * template, with each instance's particles in one contiguous range
+ * (GetSourceRanges) rather than a per-particle instance tag. The
+ * renderer then builds one vertex stream from the whole pool, sorted back
+ * to front once globally, instead of one Render call per instance.
+ */
+class ParticlePool {
+public:
+    /**
+     * @brief Contiguous range of particles from one effect template
+     */
+    struct TemplateRange {
+        int templateIndex;
+        uint32_t begin;
+        uint32_t count;
+        RenderModeParams renderMode;
+    };
+
+    /**
+     * @brief Particles of one source after Fill, in storage order
+     */
+    struct SourceRange {
+        uint32_t begin;
+        uint32_t count;
+        ParticlePacket* packet;  // Null for sources filled without one
+        bool packetReused;       // The packet was current, so the instance is unchanged since it was built
+        bool oriented;           // Drawn with camera-dependent quad axes
+        ParticleSystemSortMode sortMode;
+        Vector3 emitter;         // Depth of the whole range when it is sorted by age
+    };
+
+    /**
+     * @brief One instance to copy into the pool
+     */
+    struct Source {
+        const std::vector<Particle>* particles;  // Simulator slots or a snapshot of them
+        int aliveCount;
+        Vector3 position;
+        float scale;
+        float alphaScale;
+        Color tint;
+        BlendMode blend;
+        RenderModeParams renderMode;
+        ParticleSystemSortMode sortMode;  // Order of its particles when the pool is sorted
+        const ParticleShape* shape;  // Outline of the effect; null for the full quad
+        int templateIndex;
+        ParticlePacket* packet;      // Copy through this per-instance cache; null to read the particles
+        uint64_t version;            // Version of the particles, to tell whether the packet is current
+    };
+
+    ParticlePool();
+
+    void Clear();
+
+    /**
+     * @brief Replace the pool contents with the alive particles of many instances
+     *
+     * Each instance gets its slot range from a prefix sum of alive counts,
+     * so the copies are independent and run on the workers when given.
+     * Sources of one template should be consecutive to group them.
+     * Every particle is drawn with as many vertices as the largest shape
+     * needs; smaller shapes are padded (see ParticleShape::PaddedTo).
+     * With a size filter, particles it thins out are left out of the pool
+     * and those it classifies as point sprites go to GetPointSprites
+     * instead (see ScreenSizeFilter::SetPointSpriteSize).
+     * Sources with a packet rebuild it when it is not current and copy
+     * from it, so later views of the same version skip the packing.
+     */
+    void Fill(const std::vector<Source>& sources,
+              const ScreenSizeFilter* sizeFilter = nullptr,
+              WorkerPool* workers = nullptr);
+
+    /**
+     * @brief Order particles back to front from the camera
+     *
+     * Particles of Distance (and None) sources are sorted individually.
+     * A source sorted by age (OldestInFront, YoungestInFront) is drawn as
+     * one block at the depth of its emitter, its particles ordered by age
+     * within it, like the per-instance path draws it. Starts from the
+     * previous frame's order when the pool layout is unchanged, which is
+     * usually nearly sorted for a steady camera.
+     */
+    void SortBackToFront(const Vector3& cameraPos, WorkerPool* workers = nullptr);
+
+    /**
+     * @brief Compute the quad axes of particles from non-camera-facing effects
+     *
+     * Runs per template range, where the render mode is uniform, so each
+     * range goes through the vectorized RenderPacketBuilder::OrientQuads.
+     * Must follow Fill whenever the pool has oriented particles.
+     */
+    void OrientQuads(const CameraData& camera, WorkerPool* workers = nullptr);
+
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_x.size()); }
+    const ScreenSizeStats& GetScreenSizeStats() const { return m_sizeStats; }  // From the last Fill
+    uint32_t GetPacketsReused() const { return m_packetsReused; }             // From the last Fill
+    const std::vector<TemplateRange>& GetTemplateRanges() const { return m_ranges; }
+    const std::vector<SourceRange>& GetSourceRanges() const { return m_sourceRanges; }
+
+    // Particles drawn as point sprites, in storage order and never sorted;
+    // they are far and small enough that the quads can be drawn over them
+    const std::vector<PointSpriteVertex>& GetPointSprites() const { return m_points; }
+
+    // Draw order from the last sort (pool indices)
+    const std::vector<uint32_t>& GetOrder() const { return m_order; }
+
+    // Particle attributes
+    const std::vector<float>& GetX() const { return m_x; }
+    const std::vector<float>& GetY() const { return m_y; }
+    const std::vector<float>& GetZ() const { return m_z; }
+    const std::vector<float>& GetSize() const { return m_size; }
+    const std::vector<float>& GetRotation() const { return m_rotation; }
+    const std::vector<uint32_t>& GetColor() const { return m_color; }  // A8R8G8B8
+
+    // Oriented quads; empty when every particle is a camera-facing billboard
+    const std::vector<uint8_t>& GetOriented() const { return m_oriented; }
+    const std::vector<Vector3f>& GetAxisX() const { return m_axisX; }
+    const std::vector<Vector3f>& GetAxisY() const { return m_axisY; }
+
+    // Outlines, padded to GetVerticesPerParticle corners; the shape index
+    // is empty when every particle uses the first shape
+    uint32_t GetVerticesPerParticle() const { return m_verticesPerParticle; }
+    const std::vector<ParticleShape>& GetShapes() const { return m_shapes; }
+    const std::vector<uint8_t>& GetShapeIndex() const { return m_shapeIndex; }
+    const ParticleShape& GetShape(uint32_t i) const {
+        return m_shapes[m_shapeIndex.empty() ? 0 : m_shapeIndex[i]];
+    }
+
+private:
+    // Copy one instance into [offset, end); returns the quads written and
+    // counts the point sprites written to the same range of m_points
+    uint32_t WriteInstance(const Source& source,
+                           uint8_t shape,
+                           const ScreenSizeFilter* sizeFilter,
+                           ScreenSizeStats& stats,
+                           uint32_t offset,
+                           uint32_t end,
+                           uint32_t& pointsWritten);
+
+    // Same from a current packet
+    uint32_t WritePacket(const Source& source,
+                         uint8_t shape,
+                         const ScreenSizeFilter* sizeFilter,
+                         ScreenSizeStats& stats,
+                         uint32_t offset,
+                         uint32_t end,
+                         uint32_t& pointsWritten);
+
+    // Pack a particle the filter draws as a point sprite into m_points;
+    // false leaves it to the quads
+    bool WritePoint(const Source& source,
+                    const ScreenSizeFilter& sizeFilter,
+                    const Vector3f& center,
+                    float size,
+                    uint32_t color,
+                    uint32_t key,
+                    ScreenSizeStats& stats,
+                    uint32_t& pointSlot);
+
+    // Move every instance's written particles together and build the ranges
+    void Compact(const std::vector<Source>& sources);
+
+    std::vector<float> m_x, m_y, m_z;
+    std::vector<float> m_size;
+    std::vector<float> m_rotation;
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_age;           // Only sized while some source sorts by age
+
+    // Only sized while some range is not camera-facing
+    std::vector<Vector3f> m_velocity;   // Scaled by the effect's velocityScale
+    std::vector<uint8_t> m_oriented;
+    std::vector<Vector3f> m_axisX;
+    std::vector<Vector3f> m_axisY;
+
+    std::vector<TemplateRange> m_ranges;
+    std::vector<SourceRange> m_sourceRanges;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_written;  // Per source, at most its alive count
+
+    // Point sprites, written to the same slot range as the quads and compacted alike
+    std::vector<PointSpriteVertex> m_points;
+    std::vector<uint32_t> m_pointsWritten;
+
+    std::vector<ScreenSizeStats> m_sourceStats;  // Per source, so workers never share counters
+    ScreenSizeStats m_sizeStats;
+    std::vector<uint8_t> m_sourceReused;          // Per source, packet was already current
+    uint32_t m_packetsReused;
+
+    uint32_t m_verticesPerParticle;
+    std::vector<ParticleShape> m_shapes;
+    std::vector<const ParticleShape*> m_shapeSources;  // Source pointer of each shape
+    std::vector<uint8_t> m_sourceShapes;               // Shape index of each source
+    std::vector<uint8_t> m_shapeIndex;                 // Only sized while shapes differ
+
+    // Sort state. Units are single particles or whole age-sorted ranges
+    // (named by their first particle); the last unit order is kept as the
+    // next frame's starting guess while the layout it was built for holds.
+    ParticleSorter m_sorter;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_units;
+    std::vector<uint32_t> m_unitLayout;   // Pool size, then begin/count of every age range
+    std::vector<uint32_t> m_previousLayout;
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_unitRange;    // Per particle: source range index, kSingleUnit or kInsideUnit
+    ParticleSorter m_rangeSorter;
+    std::vector<uint32_t> m_ageKeys;
+    std::vector<uint32_t> m_rangeOrder;
+};
+
+/**
+ * @brief Camera-independent pool data of one instance, reused across views
+ *
+ * GMod can render the world several times a frame (water reflections,
+ * mirrors, RT cameras). World positions, packed colors and thinning keys
+ * only change with the simulation and the instance transform, so they are
+ * built once per version and every view copies them, applying only the
+ * camera-dependent size rules. Texture coordinates come from the shared
+ * ParticleShape and need no per-particle state.
+ */
+struct ParticlePacket {
+    uint64_t version;        // Source version it was built from (0 = never built)
+
+    // Transform it was built with; a change rebuilds it within a version
+    ParticleSystemSortMode sortMode;
+    Vector3 position;
+    float scale;
+    float alphaScale;
+    Color tint;
+    BlendMode blend;
+    Vector3f velocityScale;
+
+    std::vector<float> x, y, z;
+    std::vector<float> size;
+    std::vector<float> rotation;
+    std::vector<uint32_t> color;    // A8R8G8B8, before the size rules adjust alpha
+    std::vector<float> opacity;     // Particle alpha times tint and alpha scale
+    std::vector<uint32_t> key;      // ScreenSizeFilter::GetParticleKey
+    std::vector<Vector3f> velocity; // Scaled; only for effects that are not camera-facing
+    std::vector<float> age;         // Only for effects sorted by age
+
+    // Vertices of the last view that drew these particles; Build invalidates them
+    VertexCache vertexCache;
+
+    ParticlePacket() : version(0), sortMode(ParticleSystemSortMode::None), scale(0.0f), alphaScale(0.0f),
+                       blend(BlendMode::Alpha) {}
+
+    uint32_t GetCount() const { return static_cast<uint32_t>(x.size()); }
+
+    bool IsCurrent(const ParticlePool::Source& source) const;
+
+    /**
+     * @brief Gather the alive particles of a source (and drop the cached vertices)
+     */
+    void Build(const ParticlePool::Source& source);
+};
+
+} // namespace GPUParticles
@@ -0,0 +1,197 @@
+#include "particle_sort.h"
+#include <algorithm>
+#include <cstring>
+
+namespace GPUParticles {
+
+namespace {
+
+// Two 11-bit digits cover the 22-bit keys
+constexpr uint32_t kRadixBits = 11;
+constexpr uint32_t kBuckets = 1u << kRadixBits;
+constexpr uint32_t kPasses = (ParticleSorter::kKeyBits + kRadixBits - 1) / kRadixBits;
+
+// Last frame's order is repaired instead of re-sorted while at most one
+// neighbour pair in this many is out of order, and gives up once the
+// insertion sort has moved each index this many places on average
+constexpr uint32_t kCoherentPairsPerDescent = 64;
+constexpr uint32_t kMaxInsertionMovesPerItem = 8;
+
+// Radix passes only go wide when every task has a worthwhile share
+constexpr uint32_t kMinKeysPerTask = 16384;
+
+} // namespace
+
+uint32_t ParticleSorter::FloatKey(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    // Flip so unsigned order matches float order, then keep the top bits
+    bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    return bits >> (32 - kKeyBits);
+}
+
+void ParticleSorter::Sort(const uint32_t* keys, std::vector<uint32_t>& order, WorkerPool* workers) {
+    const uint32_t count = static_cast<uint32_t>(order.size());
+    if (count < 2) {
+        m_lastPath = Path::None;
+        return;
+    }
+
+    uint32_t descents = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        if (keys[order[i - 1]] > keys[order[i]]) {
+            descents++;
+        }
+    }
+
+    if (descents == 0) {
+        m_lastPath = Path::None;
+        return;
+    }
+
+    if (descents <= count / kCoherentPairsPerDescent && InsertionSort(keys, order)) {
+        m_lastPath = Path::Insertion;
+        return;
+    }
+
+    RadixSort(keys, order, workers);
+    m_lastPath = Path::Radix;
+}
+
+bool ParticleSorter::InsertionSort(const uint32_t* keys, std::vector<uint32_t>& order) {
+    const uint32_t count = static_cast<uint32_t>(order.size());
+    const uint64_t budget = static_cast<uint64_t>(count) * kMaxInsertionMovesPerItem;
+    uint64_t moves = 0;
+
+    for (uint32_t i = 1; i < count; ++i) {
+        const uint32_t value = order[i];
+        const uint32_t key = keys[value];
+
+        uint32_t j = i;
+        while (j > 0 && keys[order[j - 1]] > key) {
+            order[j] = order[j - 1];
+            --j;
+
+            // Far from sorted after all: leave a valid permutation for the radix sort
+            if (++moves > budget) {
+                order[j] = value;
+                return false;
+            }
+        }
+        order[j] = value;
+    }
+
+    return true;
+}
+
+void ParticleSorter::RadixSort(const uint32_t* keys, std::vector<uint32_t>& order, WorkerPool* workers) {
+    const uint32_t count = static_cast<uint32_t>(order.size());
+
+    m_keys.resize(count);
+    m_values.resize(count);
+    m_keysTemp.resize(count);
+    m_valuesTemp.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        m_values[i] = order[i];
+        m_keys[i] = keys[order[i]];
+    }
+
+    uint32_t tasks = 1;
+    if (workers && workers->GetWorkerCount() > 0) {
+        tasks = std::max(1u, std::min(static_cast<uint32_t>(workers->GetWorkerCount()) + 1, count / kMinKeysPerTask));
+    }
+    m_histograms.resize(static_cast<size_t>(tasks) * kBuckets);
+
+    // Fixed task ranges so the counting and scatter steps see the same split
+    auto taskBegin = [count, tasks](uint32_t task) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(count) * task / tasks);
+    };
+    auto runTasks = [&](const std::function<void(uint32_t)>& task) {
+        if (tasks == 1) {
+            task(0);
+            return;
+        }
+        workers->ParallelFor(tasks, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t t = begin; t < end; ++t) {
+                task(t);
+            }
+        });
+    };
+
+    for (uint32_t pass = 0; pass < kPasses; ++pass) {
+        const uint32_t shift = pass * kRadixBits;
+
+        runTasks([&](uint32_t task) {
+            uint32_t* histogram = &m_histograms[static_cast<size_t>(task) * kBuckets];
+            std::fill(histogram, histogram + kBuckets, 0u);
+            for (uint32_t i = taskBegin(task), end = taskBegin(task + 1); i < end; ++i) {
+                histogram[(m_keys[i] >> shift) & (kBuckets - 1)]++;
+            }
+        });
+
+        // Bucket-major, task-minor offsets keep the sort stable
+        uint32_t sum = 0;
+        bool singleBucket = false;
+        for (uint32_t bucket = 0; bucket < kBuckets; ++bucket) {
+            const uint32_t bucketStart = sum;
+            for (uint32_t task = 0; task < tasks; ++task) {
+                uint32_t& slot = m_histograms[static_cast<size_t>(task) * kBuckets + bucket];
+                const uint32_t n = slot;
+                slot = sum;
+                sum += n;
+            }
+            if (sum - bucketStart == count) {
+                singleBucket = true;
+            }
+        }
+
+        // Every key has the same digit: this pass would not move anything
+        if (singleBucket) {
+            continue;
+        }
+
+        runTasks([&](uint32_t task) {
+            uint32_t* offsets = &m_histograms[static_cast<size_t>(task) * kBuckets];
+            for (uint32_t i = taskBegin(task), end = taskBegin(task + 1); i < end; ++i) {
+                const uint32_t dest = offsets[(m_keys[i] >> shift) & (kBuckets - 1)]++;
+                m_keysTemp[dest] = m_keys[i];
+                m_valuesTemp[dest] = m_values[i];
+            }
+        });
+
+        m_keys.swap(m_keysTemp);
+        m_values.swap(m_valuesTemp);
+    }
+
+    std::copy(m_values.begin(), m_values.end(), order.begin());
+}
+
+void ParticleSorter::TrackAlive(const std::vector<Particle>& particles,
+                                std::vector<uint32_t>& order,
+                                bool newAtFront) {
+    const uint32_t slots = static_cast<uint32_t>(particles.size());
+    m_tracked.assign(slots, 0);
+
+    // Survivors keep their relative order
+    size_t kept = 0;
+    for (uint32_t slot : order) {
+        if (slot < slots && particles[slot].alive && !m_tracked[slot]) {
+            m_tracked[slot] = 1;
+            order[kept++] = slot;
+        }
+    }
+    order.resize(kept);
+
+    m_added.clear();
+    for (uint32_t slot = 0; slot < slots; ++slot) {
+        if (particles[slot].alive && !m_tracked[slot]) {
+            m_added.push_back(slot);
+        }
+    }
+
+    order.insert(newAtFront ? order.begin() : order.end(), m_added.begin(), m_added.end());
+}
+
+} // namespace GPUParticles
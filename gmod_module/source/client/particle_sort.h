@@ -0,0 +1,75 @@
+#pragma once
+
+#include "cpu_particle_simulator.h"
+#include "worker_pool.h"
+#include <cstdint>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Sorts particle indices by 32-bit keys
+ *
+ * Keys are quantized to kKeyBits so a full sort is a two-pass LSD radix
+ * sort of key/index pairs, split across the workers for large counts.
+ * The order from the previous frame is tried first: with a steady camera
+ * it is almost always nearly sorted, and a bounded insertion sort fixes
+ * it in close to linear time. An already sorted order costs one scan.
+ */
+class ParticleSorter {
+public:
+    static constexpr uint32_t kKeyBits = 22;
+    static constexpr uint32_t kKeyMask = (1u << kKeyBits) - 1;
+
+    /**
+     * @brief Order-preserving quantized key of a float (ascending)
+     */
+    static uint32_t FloatKey(float value);
+
+    /**
+     * @brief Key that sorts larger values first
+     */
+    static uint32_t DescendingKey(float value) { return kKeyMask - FloatKey(value); }
+
+    /**
+     * @brief Sort indices so keys[order[i]] is ascending (stable)
+     * @param keys Key of every index that appears in order
+     * @param order Indices to sort; its previous contents are the starting guess
+     * @param workers Threads for the radix passes (nullptr = calling thread)
+     */
+    void Sort(const uint32_t* keys, std::vector<uint32_t>& order, WorkerPool* workers = nullptr);
+
+    /**
+     * @brief Update an order of particle slots after a simulation step
+     *
+     * Slots that died are dropped and newly alive slots are added, so the
+     * survivors keep last frame's relative order for the next Sort.
+     * @param newAtFront Put new particles first instead of last
+     */
+    void TrackAlive(const std::vector<Particle>& particles, std::vector<uint32_t>& order, bool newAtFront);
+
+    // How the last Sort finished
+    enum class Path {
+        None,        // Nothing to do (empty or already sorted)
+        Insertion,   // Last frame's order, locally repaired
+        Radix        // Full sort
+    };
+    Path GetLastPath() const { return m_lastPath; }
+
+private:
+    bool InsertionSort(const uint32_t* keys, std::vector<uint32_t>& order);
+    void RadixSort(const uint32_t* keys, std::vector<uint32_t>& order, WorkerPool* workers);
+
+    Path m_lastPath = Path::None;
+
+    // Radix scratch, reused between frames
+    std::vector<uint32_t> m_keys, m_keysTemp;
+    std::vector<uint32_t> m_values, m_valuesTemp;
+    std::vector<uint32_t> m_histograms;  // One histogram per task
+
+    // TrackAlive scratch
+    std::vector<uint8_t> m_tracked;
+    std::vector<uint32_t> m_added;
+};
+
+} // namespace GPUParticles
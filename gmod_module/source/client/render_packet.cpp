@@ -0,0 +1,1059 @@
+#include "render_packet.h"
+#include "particle_bounds.h"
+#include "particle_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+namespace GPUParticles {
+
+uint32_t GetVertexStride(VertexFormat format) {
+    return (format == VertexFormat::Compact) ? sizeof(CompactParticleVertex) : sizeof(ParticleVertex);
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0) {
+        // Too small for a normal half: flush to signed zero (particle sizes
+        // and angles never need subnormals)
+        return sign;
+    }
+    if (exponent >= 31) {
+        // Overflow and NaN/Inf clamp to the largest finite half
+        return static_cast<uint16_t>(sign | 0x7bff);
+    }
+
+    // Round to nearest; a carry out of the mantissa bumps the exponent
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | std::min<uint32_t>(half, 0x7bff));
+}
+
+uint32_t PackColorARGB(float r, float g, float b, float a) {
+    auto channel = [](float v) {
+        return static_cast<uint32_t>(std::max(0.0f, std::min(1.0f, v)) * 255.0f + 0.5f);
+    };
+    return (channel(a) << 24) | (channel(r) << 16) | (channel(g) << 8) | channel(b);
+}
+
+BlendMode ClassifyBlendMode(const std::string& material) {
+    // Lower-case words, split at separators and lower-to-upper case changes
+    std::vector<std::string> words(1);
+    char previous = 0;
+    for (char c : material) {
+        const bool alnum = std::isalnum(static_cast<unsigned char>(c)) != 0;
+        const bool wordStart = std::isupper(static_cast<unsigned char>(c)) &&
+                               std::islower(static_cast<unsigned char>(previous));
+        if ((!alnum || wordStart) && !words.back().empty()) {
+            words.emplace_back();
+        }
+        if (alnum) {
+            words.back() += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        previous = c;
+    }
+
+    auto startsWith = [](const std::string& word, const char* prefix) {
+        return word.compare(0, std::strlen(prefix), prefix) == 0;
+    };
+
+    for (const std::string& word : words) {
+        if (startsWith(word, "premul")) {
+            return BlendMode::Premultiplied;
+        }
+    }
+    for (const std::string& word : words) {
+        if (startsWith(word, "add")) {
+            return BlendMode::Additive;
+        }
+    }
+    return BlendMode::Alpha;
+}
+
+uint32_t PackParticleColor(const Color& color, const Color& tint, float alphaScale, BlendMode blend) {
+    const float a = color.a * tint.a * alphaScale;
+    const float k = (blend == BlendMode::Premultiplied) ? std::max(0.0f, std::min(1.0f, a)) : 1.0f;
+    return PackColorARGB(color.r * tint.r * k, color.g * tint.g * k, color.b * tint.b * k, a);
+}
+
+uint32_t ScaleParticleAlpha(uint32_t color, float alphaScale, BlendMode blend) {
+    auto channel = [color](int shift) { return static_cast<float>((color >> shift) & 0xFF) * (1.0f / 255.0f); };
+
+    const float a = channel(24);
+    const float scaled = std::max(0.0f, std::min(1.0f, a * alphaScale));
+    const float k = (blend == BlendMode::Premultiplied) ? (a > 0.0f ? scaled / a : 0.0f) : 1.0f;
+    return PackColorARGB(channel(16) * k, channel(8) * k, channel(0) * k, scaled);
+}
+
+CameraData CameraData::FromViewMatrix(const float* viewMatrix, const float* cameraPos) {
+    // Row-vector convention: the camera axes are the first columns
+    Matrix4x4 view = Matrix4x4::FromArray(viewMatrix);
+
+    CameraData camera;
+    camera.position = Vector3f(cameraPos[0], cameraPos[1], cameraPos[2]);
+    camera.right = Vector3f(view[0][0], view[1][0], view[2][0]);
+    camera.up = Vector3f(view[0][1], view[1][1], view[2][1]);
+    camera.forward = Vector3f(view[0][2], view[1][2], view[2][2]);
+    return camera;
+}
+
+// ============================================================================
+// VertexCache
+// ============================================================================
+
+bool VertexCache::CanReuse(VertexFormat viewFormat,
+                           uint32_t viewVerticesPerParticle,
+                           uint32_t viewParticleCount,
+                           const CameraData& viewCamera,
+                           float maxCameraMove,
+                           float minAxisDot) const {
+    if (!valid || format != viewFormat || verticesPerParticle != viewVerticesPerParticle ||
+        particleCount != viewParticleCount) {
+        return false;
+    }
+
+    return IsCameraClose(viewCamera, camera, maxCameraMove, minAxisDot, orientationDependent);
+}
+
+bool VertexCache::IsCameraClose(const CameraData& a,
+                                const CameraData& b,
+                                float maxCameraMove,
+                                float minAxisDot,
+                                bool checkOrientation) {
+    // The size rules project from the camera position
+    const float dx = a.position.x - b.position.x;
+    const float dy = a.position.y - b.position.y;
+    const float dz = a.position.z - b.position.z;
+    if (dx * dx + dy * dy + dz * dz > maxCameraMove * maxCameraMove) {
+        return false;
+    }
+
+    if (!checkOrientation) {
+        return true;
+    }
+
+    auto dot = [](const Vector3f& u, const Vector3f& v) { return u.x * v.x + u.y * v.y + u.z * v.z; };
+    return dot(a.forward, b.forward) >= minAxisDot && dot(a.up, b.up) >= minAxisDot;
+}
+
+// ============================================================================
+// ScreenSizeFilter
+// ============================================================================
+
+namespace {
+
+// Closer than this the projected size is meaningless; left untouched
+const float kMinFilterDepth = 1e-3f;
+
+// Same limits as the budget manager's compensation for thinned effects
+const float kMaxDetailSizeCompensation = 2.0f;
+const float kMaxDetailAlphaCompensation = 2.0f;
+
+uint32_t FloatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+ScreenSizeFilter::ScreenSizeFilter()
+    : m_projScale(0.0f)
+    , m_viewportHeight(0.0f)
+    , m_minPixelSize(1.0f)
+    , m_detail(1.0f)
+    , m_pointSpriteSize(0.0f)
+{
+}
+
+void ScreenSizeFilter::SetView(const CameraData& camera, const float* projMatrix, float viewportHeight) {
+    m_cameraPosition = camera.position;
+    m_cameraForward = camera.forward;
+    m_viewportHeight = viewportHeight;
+
+    // A particle of half-extent h at depth d spans h * proj[1][1] / d of
+    // the viewport height (its 2h width over clip space's 2 units)
+    m_projScale = (viewportHeight > 0.0f) ? std::fabs(Matrix4x4::FromArray(projMatrix)[1][1]) : 0.0f;
+}
+
+uint32_t ScreenSizeFilter::GetParticleKey(uint32_t slot, float lifetime, const Vector3f& emitter) {
+    // Murmur3 finalizer over the slot, the particle's lifetime and the
+    // emitter, all constant while the particle lives
+    uint32_t h = slot * 0x9E3779B9u ^ FloatBits(lifetime) ^ (FloatBits(emitter.x) * 0x85EBCA6Bu) ^
+                 (FloatBits(emitter.y) * 0xC2B2AE35u) ^ FloatBits(emitter.z);
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+bool ScreenSizeFilter::Apply(const RenderModeParams& params,
+                             const Vector3f& center,
+                             uint32_t key,
+                             float opacity,
+                             float& size,
+                             float& alphaScale,
+                             ScreenSizeStats& stats) const {
+    if (m_detail < 1.0f) {
+        // Rehashed so this decision is independent of the sub-pixel one
+        // below, which uses the key's high bits directly
+        if (static_cast<float>((key * 0x2545F491u) >> 8) * (1.0f / 16777216.0f) >= m_detail) {
+            stats.detailCulled++;
+            return false;
+        }
+
+        const float sizeCompensation = std::min(1.0f / std::sqrt(m_detail), kMaxDetailSizeCompensation);
+        const float coverage = m_detail * sizeCompensation * sizeCompensation;
+        size *= sizeCompensation;
+        alphaScale *= std::min(1.0f / coverage, kMaxDetailAlphaCompensation);
+    }
+
+    const float depth = std::fabs((center.x - m_cameraPosition.x) * m_cameraForward.x +
+                                  (center.y - m_cameraPosition.y) * m_cameraForward.y +
+                                  (center.z - m_cameraPosition.z) * m_cameraForward.z);
+    if (!IsEnabled() || depth < kMinFilterDepth) {
+        return true;
+    }
+
+    // Unity's limits, as fractions of the viewport height
+    float screenSize = size * m_projScale / depth;
+    if (params.maxScreenSize > 0.0f && screenSize > params.maxScreenSize) {
+        size *= params.maxScreenSize / screenSize;
+        screenSize = params.maxScreenSize;
+        stats.clampedMax++;
+    } else if (screenSize < params.minScreenSize && screenSize > 0.0f) {
+        size *= params.minScreenSize / screenSize;
+        screenSize = params.minScreenSize;
+        stats.clampedMin++;
+    }
+
+    const float pixels = screenSize * m_viewportHeight;
+    if (pixels >= m_minPixelSize) {
+        return true;
+    }
+
+    // Draw at the threshold size; the area ratio is the coverage to keep
+    const float coverage = (pixels / m_minPixelSize) * (pixels / m_minPixelSize);
+    const float alpha = opacity * alphaScale * coverage;
+    if (alpha >= kMinSubPixelAlpha) {
+        size *= m_minPixelSize / pixels;
+        alphaScale *= coverage;
+        stats.subPixelKept++;
+        return true;
+    }
+
+    // Too faint to blend: keep the fraction that carries the same coverage
+    // at the lowest usable alpha
+    const float keep = alpha / kMinSubPixelAlpha;
+    if (static_cast<float>(key >> 8) * (1.0f / 16777216.0f) >= keep) {
+        stats.subPixelCulled++;
+        return false;
+    }
+
+    size *= m_minPixelSize / pixels;
+    alphaScale *= coverage / keep;
+    stats.subPixelKept++;
+    return true;
+}
+
+float ScreenSizeFilter::GetPixelSize(const Vector3f& center, float size) const {
+    const float depth = std::fabs((center.x - m_cameraPosition.x) * m_cameraForward.x +
+                                  (center.y - m_cameraPosition.y) * m_cameraForward.y +
+                                  (center.z - m_cameraPosition.z) * m_cameraForward.z);
+    if (!IsEnabled() || depth < kMinFilterDepth) {
+        return 0.0f;
+    }
+    return size * m_projScale / depth * m_viewportHeight;
+}
+
+bool ScreenSizeFilter::IsPointSprite(const RenderModeParams& params,
+                                     const Vector3f& center,
+                                     float size,
+                                     float& pixels) const {
+    // Stretched and world-aligned quads would lose their shape as points
+    if (m_pointSpriteSize <= 0.0f || !params.IsCameraFacing()) {
+        return false;
+    }
+
+    pixels = GetPixelSize(center, size);
+    return pixels > 0.0f && pixels < m_pointSpriteSize;
+}
+
+// ============================================================================
+// ParticleShape
+// ============================================================================
+
+ParticleShape::ParticleShape() : vertexCount(4) {
+    // Corner order shared by both formats and BuildFanIndices:
+    // bottom-left, bottom-right, top-right, top-left
+    corners[0] = Vector2f(-1, -1);
+    corners[1] = Vector2f(1, -1);
+    corners[2] = Vector2f(1, 1);
+    corners[3] = Vector2f(-1, 1);
+    for (uint32_t c = 4; c < kMaxVertices; ++c) {
+        corners[c] = corners[3];
+    }
+}
+
+ParticleShape ParticleShape::FromHull(const AlphaHull& hull) {
+    if (hull.vertexCount < 3) {
+        return ParticleShape();
+    }
+
+    // Texture coordinates (0-1, down) to corner offsets (-1..1, up)
+    ParticleShape shape;
+    shape.vertexCount = static_cast<uint32_t>(hull.vertexCount);
+    for (uint32_t c = 0; c < kMaxVertices; ++c) {
+        const uint32_t h = std::min(c, shape.vertexCount - 1);
+        shape.corners[c] = Vector2f(hull.u[h] * 2.0f - 1.0f, 1.0f - hull.v[h] * 2.0f);
+    }
+    return shape;
+}
+
+ParticleShape ParticleShape::PaddedTo(uint32_t count) const {
+    // Corners past vertexCount already repeat the last one
+    ParticleShape padded = *this;
+    padded.vertexCount = std::max(vertexCount, std::min(count, kMaxVertices));
+    return padded;
+}
+
+namespace {
+
+int16_t PackCorner(float offset) {
+    return static_cast<int16_t>(std::lround(offset * CompactParticleVertex::kCornerScale));
+}
+
+} // namespace
+
+void RenderPacketBuilder::WriteBillboard(ParticleVertex* out,
+                                         const Vector3f& center,
+                                         uint32_t color,
+                                         float size,
+                                         float rotation,
+                                         const ParticleShape& shape) {
+    const Vector2f sizeRot(size, rotation);
+
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        out[c] = {center, color, sizeRot, shape.corners[c]};
+    }
+}
+
+void RenderPacketBuilder::WriteBillboard(CompactParticleVertex* out,
+                                         const Vector3f& center,
+                                         uint32_t color,
+                                         float size,
+                                         float rotation,
+                                         const ParticleShape& shape) {
+    const uint16_t halfSize = FloatToHalf(size);
+    const uint16_t halfRotation = FloatToHalf(rotation);
+
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        CompactParticleVertex& v = out[c];
+        v.position = center;
+        v.color = color;
+        v.size = halfSize;
+        v.rotation = halfRotation;
+        v.cornerX = PackCorner(shape.corners[c].x);
+        v.cornerY = PackCorner(shape.corners[c].y);
+    }
+}
+
+bool RenderPacketBuilder::PackPointSprite(const Vector3f& center,
+                                          uint32_t color,
+                                          float pixels,
+                                          BlendMode blend,
+                                          uint32_t key,
+                                          PointSpriteVertex& out) {
+    auto channel = [color](int shift) { return static_cast<float>((color >> shift) & 0xFF) * (1.0f / 255.0f); };
+
+    const float alpha = channel(24);
+    float width = pixels * std::sqrt(alpha);
+    if (width < 1.0f) {
+        // Rehashed so this decision is independent of the sub-pixel and
+        // detail thinning, which already ran on the same key
+        const float keep = width * width;
+        if (static_cast<float>((key * 0x6C8E9CF5u) >> 8) * (1.0f / 16777216.0f) >= keep) {
+            return false;
+        }
+        width = 1.0f;
+    }
+
+    // Drawn opaque, so premultiplied colors are divided back
+    const float k = (blend == BlendMode::Premultiplied && alpha > 0.0f) ? 1.0f / alpha : 1.0f;
+    const float widthByte = std::min(width, PointSpriteVertex::kMaxPixels) * PointSpriteVertex::kSizeScale;
+
+    out.position = center;
+    out.color = (PackColorARGB(channel(16) * k, channel(8) * k, channel(0) * k, 0.0f) & 0x00FFFFFFu) |
+                (static_cast<uint32_t>(std::lround(widthByte)) << 24);
+    return true;
+}
+
+Vector3f RenderPacketBuilder::ExpandCorner(const Vector3f& center,
+                                           float size,
+                                           float rotation,
+                                           float cornerX,
+                                           float cornerY,
+                                           const CameraData& camera) {
+    // Rotate the corner in the billboard plane, then scale and place it
+    // along the camera axes
+    const float s = std::sin(rotation);
+    const float c = std::cos(rotation);
+    const float x = (cornerX * c - cornerY * s) * size;
+    const float y = (cornerX * s + cornerY * c) * size;
+
+    return Vector3f(center.x + camera.right.x * x + camera.up.x * y,
+                    center.y + camera.right.y * x + camera.up.y * y,
+                    center.z + camera.right.z * x + camera.up.z * y);
+}
+
+namespace {
+
+// Below this squared length a stretch direction is treated as zero
+const float kMinStretchLengthSq = 1e-8f;
+
+// In-plane axes of the modes that do not depend on the particle
+void GetPlaneAxes(ParticleSystemRenderMode mode, const CameraData& camera, Vector3f& right, Vector3f& up) {
+    if (mode == ParticleSystemRenderMode::HorizontalBillboard) {
+        right = Vector3f(1, 0, 0);
+        up = Vector3f(0, 1, 0);
+    } else if (mode == ParticleSystemRenderMode::VerticalBillboard) {
+        // Camera right flattened onto the ground plane, world up
+        const float length = std::sqrt(camera.right.x * camera.right.x + camera.right.y * camera.right.y);
+        right = (length > 1e-6f) ? Vector3f(camera.right.x / length, camera.right.y / length, 0)
+                                 : Vector3f(1, 0, 0);
+        up = Vector3f(0, 0, 1);
+    } else {
+        right = camera.right;
+        up = camera.up;
+    }
+}
+
+} // namespace
+
+void RenderPacketBuilder::ComputeQuadAxes(const RenderModeParams& params,
+                                          const Vector3f& center,
+                                          const Vector3f& velocity,
+                                          float size,
+                                          float rotation,
+                                          const CameraData& camera,
+                                          Vector3f& axisX,
+                                          Vector3f& axisY) {
+    if (params.mode == ParticleSystemRenderMode::Stretch) {
+        const float speedSq = velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z;
+        const float speed = std::sqrt(speedSq);
+
+        // Width runs across the velocity, perpendicular to the view ray
+        const Vector3f toCamera(camera.position.x - center.x,
+                                camera.position.y - center.y,
+                                camera.position.z - center.z);
+        const Vector3f across(velocity.y * toCamera.z - velocity.z * toCamera.y,
+                              velocity.z * toCamera.x - velocity.x * toCamera.z,
+                              velocity.x * toCamera.y - velocity.y * toCamera.x);
+        const float acrossSq = across.x * across.x + across.y * across.y + across.z * across.z;
+
+        if (speedSq > kMinStretchLengthSq && acrossSq > kMinStretchLengthSq) {
+            const float width = size / std::sqrt(acrossSq);
+            const float length = (size * params.lengthScale + 0.5f * speed) / speed;
+            axisX = Vector3f(across.x * width, across.y * width, across.z * width);
+            axisY = Vector3f(velocity.x * length, velocity.y * length, velocity.z * length);
+        } else {
+            axisX = Vector3f(camera.right.x * size, camera.right.y * size, camera.right.z * size);
+            axisY = Vector3f(camera.up.x * size, camera.up.y * size, camera.up.z * size);
+        }
+        return;
+    }
+
+    Vector3f right, up;
+    GetPlaneAxes(params.mode, camera, right, up);
+
+    // Same rotation as ExpandCorner: corner (cx, cy) at right x + up y
+    const float s = std::sin(rotation) * size;
+    const float c = std::cos(rotation) * size;
+    axisX = Vector3f(right.x * c + up.x * s, right.y * c + up.y * s, right.z * c + up.z * s);
+    axisY = Vector3f(up.x * c - right.x * s, up.y * c - right.y * s, up.z * c - right.z * s);
+}
+
+void RenderPacketBuilder::WriteOrientedQuad(ParticleVertex* out,
+                                            const Vector3f& center,
+                                            const Vector3f& axisX,
+                                            const Vector3f& axisY,
+                                            uint32_t color,
+                                            const ParticleShape& shape) {
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        const float cx = shape.corners[c].x;
+        const float cy = shape.corners[c].y;
+        const Vector3f corner(center.x + axisX.x * cx + axisY.x * cy,
+                              center.y + axisX.y * cx + axisY.y * cy,
+                              center.z + axisX.z * cx + axisY.z * cy);
+        out[c] = {corner, color, Vector2f(0, 0), Vector2f(cx, cy)};
+    }
+}
+
+void RenderPacketBuilder::WriteOrientedQuad(CompactParticleVertex* out,
+                                            const Vector3f& center,
+                                            const Vector3f& axisX,
+                                            const Vector3f& axisY,
+                                            uint32_t color,
+                                            const ParticleShape& shape) {
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        const float cx = shape.corners[c].x;
+        const float cy = shape.corners[c].y;
+
+        CompactParticleVertex& v = out[c];
+        v.position = Vector3f(center.x + axisX.x * cx + axisY.x * cy,
+                              center.y + axisX.y * cx + axisY.y * cy,
+                              center.z + axisX.z * cx + axisY.z * cy);
+        v.color = color;
+        v.size = 0;       // Half float zero
+        v.rotation = 0;
+        v.cornerX = PackCorner(cx);
+        v.cornerY = PackCorner(cy);
+    }
+}
+
+void RenderPacketBuilder::WriteExpandedQuad(ParticleVertex* out,
+                                            const Vector3f& center,
+                                            const Vector3f& axisX,
+                                            const Vector3f& axisY,
+                                            uint32_t color,
+                                            const ParticleShape& shape) {
+    WriteOrientedQuad(out, center, axisX, axisY, color, shape);
+
+    // Corner (-1..1, up) to texture coordinates (0-1, down)
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        out[c].corner = Vector2f(out[c].corner.x * 0.5f + 0.5f, 0.5f - out[c].corner.y * 0.5f);
+    }
+}
+
+// ============================================================================
+// CPU billboard expansion
+// ============================================================================
+
+namespace {
+
+// Scratch arrays for one expansion batch
+struct ExpandBatch {
+    float x[RenderPacketBuilder::kExpandBatchSize];
+    float y[RenderPacketBuilder::kExpandBatchSize];
+    float z[RenderPacketBuilder::kExpandBatchSize];
+    float size[RenderPacketBuilder::kExpandBatchSize];
+    float rotation[RenderPacketBuilder::kExpandBatchSize];
+    uint32_t color[RenderPacketBuilder::kExpandBatchSize];
+};
+
+#if GPUPARTICLES_SSE
+// sin and cos of four angles. Reduced to [-pi, pi], folded to [0, pi/2]
+// and evaluated with Taylor polynomials (error below 4e-6).
+inline void SinCos4(__m128 angle, __m128& sinOut, __m128& cosOut) {
+    const __m128 twoPi = _mm_set1_ps(6.28318531f);
+    const __m128 pi = _mm_set1_ps(3.14159265f);
+    const __m128 halfPi = _mm_set1_ps(1.57079633f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    __m128 turns = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(0.159154943f))));
+    __m128 x = _mm_sub_ps(angle, _mm_mul_ps(turns, twoPi));
+
+    __m128 sign = _mm_and_ps(x, signMask);
+    __m128 ax = _mm_andnot_ps(signMask, x);
+    __m128 back = _mm_cmpgt_ps(ax, halfPi);
+    __m128 a = _mm_min_ps(ax, _mm_sub_ps(pi, ax));
+    __m128 a2 = _mm_mul_ps(a, a);
+
+    // sin(a) = a(1 - a^2/6 (1 - a^2/20 (1 - a^2/42 (1 - a^2/72))))
+    __m128 sp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(a2, _mm_set1_ps(1.0f / 72.0f)));
+    sp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 42.0f)), sp));
+    sp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 20.0f)), sp));
+    sp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 6.0f)), sp));
+    sinOut = _mm_or_ps(_mm_mul_ps(a, sp), sign);
+
+    // cos(a) = 1 - a^2/2 (1 - a^2/12 (1 - a^2/30 (1 - a^2/56 (1 - a^2/90))))
+    __m128 cp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(a2, _mm_set1_ps(1.0f / 90.0f)));
+    cp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 56.0f)), cp));
+    cp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 30.0f)), cp));
+    cp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(1.0f / 12.0f)), cp));
+    cp = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_mul_ps(a2, _mm_set1_ps(0.5f)), cp));
+
+    // cos(pi - a) = -cos(a)
+    cosOut = _mm_xor_ps(cp, _mm_and_ps(back, signMask));
+}
+#endif
+
+} // namespace
+
+void RenderPacketBuilder::ExpandQuads(const float* x, const float* y, const float* z,
+                                      const float* size, const float* rotation, const uint32_t* color,
+                                      uint32_t count,
+                                      const CameraData& camera,
+                                      ParticleVertex* out,
+                                      const ParticleShape& shape) {
+    // Rotated and scaled in-plane axes: corner (cx, cy) lands at
+    // c + axisX cx + axisY cy, with axisX = right cos + up sin and
+    // axisY = up cos - right sin (both times size)
+    float axx[4], axy[4], axz[4], ayx[4], ayy[4], ayz[4];
+
+    // Corner offsets to texture coordinates once per call
+    Vector2f uv[ParticleShape::kMaxVertices];
+    for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+        uv[c] = Vector2f(shape.corners[c].x * 0.5f + 0.5f, 0.5f - shape.corners[c].y * 0.5f);
+    }
+
+    for (uint32_t i = 0; i < count; i += 4) {
+        const uint32_t lanes = std::min(4u, count - i);
+
+#if GPUPARTICLES_SSE
+        if (lanes == 4) {
+            __m128 s, c;
+            SinCos4(_mm_loadu_ps(rotation + i), s, c);
+
+            __m128 sz = _mm_loadu_ps(size + i);
+            s = _mm_mul_ps(s, sz);
+            c = _mm_mul_ps(c, sz);
+
+            _mm_storeu_ps(axx, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(camera.right.x), c), _mm_mul_ps(_mm_set1_ps(camera.up.x), s)));
+            _mm_storeu_ps(axy, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(camera.right.y), c), _mm_mul_ps(_mm_set1_ps(camera.up.y), s)));
+            _mm_storeu_ps(axz, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(camera.right.z), c), _mm_mul_ps(_mm_set1_ps(camera.up.z), s)));
+            _mm_storeu_ps(ayx, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(camera.up.x), c), _mm_mul_ps(_mm_set1_ps(camera.right.x), s)));
+            _mm_storeu_ps(ayy, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(camera.up.y), c), _mm_mul_ps(_mm_set1_ps(camera.right.y), s)));
+            _mm_storeu_ps(ayz, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(camera.up.z), c), _mm_mul_ps(_mm_set1_ps(camera.right.z), s)));
+        } else
+#endif
+        {
+            for (uint32_t k = 0; k < lanes; ++k) {
+                const float s = std::sin(rotation[i + k]) * size[i + k];
+                const float c = std::cos(rotation[i + k]) * size[i + k];
+
+                axx[k] = camera.right.x * c + camera.up.x * s;
+                axy[k] = camera.right.y * c + camera.up.y * s;
+                axz[k] = camera.right.z * c + camera.up.z * s;
+                ayx[k] = camera.up.x * c - camera.right.x * s;
+                ayy[k] = camera.up.y * c - camera.right.y * s;
+                ayz[k] = camera.up.z * c - camera.right.z * s;
+            }
+        }
+
+        for (uint32_t k = 0; k < lanes; ++k) {
+            const uint32_t j = i + k;
+            const Vector2f sizeRot(size[j], rotation[j]);
+
+            for (uint32_t c = 0; c < shape.vertexCount; ++c) {
+                const float cx = shape.corners[c].x;
+                const float cy = shape.corners[c].y;
+                out[c] = {Vector3f(x[j] + axx[k] * cx + ayx[k] * cy,
+                                   y[j] + axy[k] * cx + ayy[k] * cy,
+                                   z[j] + axz[k] * cx + ayz[k] * cy),
+                          color[j], sizeRot, uv[c]};
+            }
+            out += shape.vertexCount;
+        }
+    }
+}
+
+void RenderPacketBuilder::OrientQuads(const RenderModeParams& params,
+                                      const CameraData& camera,
+                                      OrientedQuadBatch& b,
+                                      uint32_t count) {
+    const bool stretch = params.mode == ParticleSystemRenderMode::Stretch;
+    uint32_t i = 0;
+
+#if GPUPARTICLES_SSE
+    if (stretch) {
+        const __m128 minLengthSq = _mm_set1_ps(kMinStretchLengthSq);
+        const __m128 lengthScale = _mm_set1_ps(params.lengthScale);
+        const __m128 half = _mm_set1_ps(0.5f);
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 vx = _mm_loadu_ps(b.vx + i);
+            __m128 vy = _mm_loadu_ps(b.vy + i);
+            __m128 vz = _mm_loadu_ps(b.vz + i);
+            __m128 size = _mm_loadu_ps(b.size + i);
+
+            __m128 tx = _mm_sub_ps(_mm_set1_ps(camera.position.x), _mm_loadu_ps(b.x + i));
+            __m128 ty = _mm_sub_ps(_mm_set1_ps(camera.position.y), _mm_loadu_ps(b.y + i));
+            __m128 tz = _mm_sub_ps(_mm_set1_ps(camera.position.z), _mm_loadu_ps(b.z + i));
+
+            // across = velocity x toCamera
+            __m128 ax = _mm_sub_ps(_mm_mul_ps(vy, tz), _mm_mul_ps(vz, ty));
+            __m128 ay = _mm_sub_ps(_mm_mul_ps(vz, tx), _mm_mul_ps(vx, tz));
+            __m128 az = _mm_sub_ps(_mm_mul_ps(vx, ty), _mm_mul_ps(vy, tx));
+
+            __m128 speedSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+            __m128 acrossSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az));
+            __m128 valid = _mm_and_ps(_mm_cmpgt_ps(speedSq, minLengthSq), _mm_cmpgt_ps(acrossSq, minLengthSq));
+
+            // Invalid lanes divide by one and are replaced below
+            __m128 speed = _mm_sqrt_ps(_mm_or_ps(_mm_and_ps(valid, speedSq), _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+            __m128 acrossLength = _mm_sqrt_ps(_mm_or_ps(_mm_and_ps(valid, acrossSq), _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+            __m128 width = _mm_div_ps(size, acrossLength);
+            __m128 length = _mm_div_ps(_mm_add_ps(_mm_mul_ps(size, lengthScale), _mm_mul_ps(half, speed)), speed);
+
+            auto select = [valid](__m128 a, __m128 b) {
+                return _mm_or_ps(_mm_and_ps(valid, a), _mm_andnot_ps(valid, b));
+            };
+            _mm_storeu_ps(b.axisXx + i, select(_mm_mul_ps(ax, width), _mm_mul_ps(_mm_set1_ps(camera.right.x), size)));
+            _mm_storeu_ps(b.axisXy + i, select(_mm_mul_ps(ay, width), _mm_mul_ps(_mm_set1_ps(camera.right.y), size)));
+            _mm_storeu_ps(b.axisXz + i, select(_mm_mul_ps(az, width), _mm_mul_ps(_mm_set1_ps(camera.right.z), size)));
+            _mm_storeu_ps(b.axisYx + i, select(_mm_mul_ps(vx, length), _mm_mul_ps(_mm_set1_ps(camera.up.x), size)));
+            _mm_storeu_ps(b.axisYy + i, select(_mm_mul_ps(vy, length), _mm_mul_ps(_mm_set1_ps(camera.up.y), size)));
+            _mm_storeu_ps(b.axisYz + i, select(_mm_mul_ps(vz, length), _mm_mul_ps(_mm_set1_ps(camera.up.z), size)));
+        }
+    } else {
+        Vector3f right, up;
+        GetPlaneAxes(params.mode, camera, right, up);
+
+        for (; i + 4 <= count; i += 4) {
+            __m128 s, c;
+            SinCos4(_mm_loadu_ps(b.rotation + i), s, c);
+
+            __m128 size = _mm_loadu_ps(b.size + i);
+            s = _mm_mul_ps(s, size);
+            c = _mm_mul_ps(c, size);
+
+            _mm_storeu_ps(b.axisXx + i, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(right.x), c), _mm_mul_ps(_mm_set1_ps(up.x), s)));
+            _mm_storeu_ps(b.axisXy + i, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(right.y), c), _mm_mul_ps(_mm_set1_ps(up.y), s)));
+            _mm_storeu_ps(b.axisXz + i, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(right.z), c), _mm_mul_ps(_mm_set1_ps(up.z), s)));
+            _mm_storeu_ps(b.axisYx + i, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(up.x), c), _mm_mul_ps(_mm_set1_ps(right.x), s)));
+            _mm_storeu_ps(b.axisYy + i, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(up.y), c), _mm_mul_ps(_mm_set1_ps(right.y), s)));
+            _mm_storeu_ps(b.axisYz + i, _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(up.z), c), _mm_mul_ps(_mm_set1_ps(right.z), s)));
+        }
+    }
+#else
+    (void)stretch;
+#endif
+
+    for (; i < count; ++i) {
+        Vector3f axisX, axisY;
+        ComputeQuadAxes(params, Vector3f(b.x[i], b.y[i], b.z[i]), Vector3f(b.vx[i], b.vy[i], b.vz[i]),
+                        b.size[i], b.rotation[i], camera, axisX, axisY);
+        b.axisXx[i] = axisX.x;
+        b.axisXy[i] = axisX.y;
+        b.axisXz[i] = axisX.z;
+        b.axisYx[i] = axisY.x;
+        b.axisYy[i] = axisY.y;
+        b.axisYz[i] = axisY.z;
+    }
+}
+
+namespace {
+
+// World-space center, size and alpha multiplier of one instance particle
+// after the screen-size rules; false if it is thinned out
+bool PlaceInstanceParticle(const InstanceTransform& transform,
+                           const ParticleView& view,
+                           size_t i,
+                           Vector3f& center,
+                           float& size,
+                           float& alphaScale) {
+    const Particle& p = view.GetDrawParticle(i);
+
+    // Particle positions are relative to the emitter
+    center = Vector3f(p.position.x + transform.position.x,
+                      p.position.y + transform.position.y,
+                      p.position.z + transform.position.z);
+    size = p.size * transform.scale;
+    alphaScale = transform.alphaScale;
+
+    if (!transform.sizeFilter) {
+        return true;
+    }
+    const uint32_t key = ScreenSizeFilter::GetParticleKey(view.GetDrawSlot(i), p.lifetime, transform.position);
+    return transform.sizeFilter->Apply(transform.renderMode, center, key, p.color.a * transform.tint.a,
+                                       size, alphaScale, *transform.sizeStats);
+}
+
+} // namespace
+
+uint32_t RenderPacketBuilder::BuildInstanceExpanded(const ParticleView& view,
+                                                    const InstanceTransform& transform,
+                                                    const CameraData& camera,
+                                                    ParticleVertex* out,
+                                                    uint32_t maxParticles) {
+    const Color& tint = transform.tint;
+    const ParticleShape& shape = transform.shape;
+    ExpandBatch batch;
+    uint32_t pending = 0;
+    uint32_t written = 0;
+
+    for (size_t i = 0; i < view.GetDrawCount() && written + pending < maxParticles; ++i) {
+        const Particle& p = view.GetDrawParticle(i);
+        Vector3f center;
+        float size, alphaScale;
+        if (!p.alive || !PlaceInstanceParticle(transform, view, i, center, size, alphaScale)) {
+            continue;
+        }
+
+        batch.x[pending] = center.x;
+        batch.y[pending] = center.y;
+        batch.z[pending] = center.z;
+        batch.size[pending] = size;
+        batch.rotation[pending] = p.rotation;
+        batch.color[pending] = PackParticleColor(p.color, tint, alphaScale, transform.blend);
+
+        if (++pending == kExpandBatchSize) {
+            ExpandQuads(batch.x, batch.y, batch.z, batch.size, batch.rotation, batch.color,
+                        pending, camera, &out[written * shape.vertexCount], shape);
+            written += pending;
+            pending = 0;
+        }
+    }
+
+    ExpandQuads(batch.x, batch.y, batch.z, batch.size, batch.rotation, batch.color,
+                pending, camera, &out[written * shape.vertexCount], shape);
+    return written + pending;
+}
+
+uint32_t RenderPacketBuilder::BuildInstanceOriented(const ParticleView& view,
+                                                    const InstanceTransform& transform,
+                                                    const CameraData& camera,
+                                                    VertexFormat format,
+                                                    void* out,
+                                                    uint32_t maxParticles) {
+    const RenderModeParams& params = transform.renderMode;
+    const Vector3f& velocityScale = params.velocityScale;
+    const ParticleShape& shape = transform.shape;
+    const uint32_t quadBytes = shape.vertexCount * GetVertexStride(format);
+    uint8_t* dest = static_cast<uint8_t*>(out);
+
+    OrientedQuadBatch batch;
+    uint32_t pending = 0;
+    uint32_t written = 0;
+
+    auto flush = [&]() {
+        OrientQuads(params, camera, batch, pending);
+
+        for (uint32_t k = 0; k < pending; ++k) {
+            const Vector3f center(batch.x[k], batch.y[k], batch.z[k]);
+            const Vector3f axisX(batch.axisXx[k], batch.axisXy[k], batch.axisXz[k]);
+            const Vector3f axisY(batch.axisYx[k], batch.axisYy[k], batch.axisYz[k]);
+            void* quad = dest + static_cast<size_t>(written + k) * quadBytes;
+
+            if (format == VertexFormat::Expanded) {
+                WriteExpandedQuad(static_cast<ParticleVertex*>(quad), center, axisX, axisY, batch.color[k], shape);
+            } else if (format == VertexFormat::Compact) {
+                WriteOrientedQuad(static_cast<CompactParticleVertex*>(quad), center, axisX, axisY, batch.color[k], shape);
+            } else {
+                WriteOrientedQuad(static_cast<ParticleVertex*>(quad), center, axisX, axisY, batch.color[k], shape);
+            }
+        }
+
+        written += pending;
+        pending = 0;
+    };
+
+    for (size_t i = 0; i < view.GetDrawCount() && written + pending < maxParticles; ++i) {
+        const Particle& p = view.GetDrawParticle(i);
+        Vector3f center;
+        float size, alphaScale;
+        if (!p.alive || !PlaceInstanceParticle(transform, view, i, center, size, alphaScale)) {
+            continue;
+        }
+
+        batch.x[pending] = center.x;
+        batch.y[pending] = center.y;
+        batch.z[pending] = center.z;
+        batch.vx[pending] = p.velocity.x * velocityScale.x;
+        batch.vy[pending] = p.velocity.y * velocityScale.y;
+        batch.vz[pending] = p.velocity.z * velocityScale.z;
+        batch.size[pending] = size;
+        batch.rotation[pending] = p.rotation;
+        batch.color[pending] = PackParticleColor(p.color, transform.tint, alphaScale, transform.blend);
+
+        if (++pending == OrientedQuadBatch::kCapacity) {
+            flush();
+        }
+    }
+
+    flush();
+    return written;
+}
+
+void RenderPacketBuilder::BuildPoolExpanded(const ParticlePool& pool,
+                                            uint32_t first,
+                                            uint32_t count,
+                                            const CameraData& camera,
+                                            ParticleVertex* out) {
+    const std::vector<uint32_t>& order = pool.GetOrder();
+    const std::vector<uint8_t>& oriented = pool.GetOriented();
+    const std::vector<uint8_t>& shapeIndex = pool.GetShapeIndex();
+    const uint32_t stride = pool.GetVerticesPerParticle();
+
+    // Billboards are expanded in batches with the first shape; oriented
+    // quads and billboards of other shapes then overwrite their slots
+    auto writeOriented = [&]() {
+        if (oriented.empty() && shapeIndex.empty()) {
+            return;
+        }
+        for (uint32_t k = 0; k < count; ++k) {
+            const uint32_t i = order.empty() ? first + k : order[first + k];
+            const Vector3f center(pool.GetX()[i], pool.GetY()[i], pool.GetZ()[i]);
+
+            if (!oriented.empty() && oriented[i]) {
+                WriteExpandedQuad(&out[k * stride], center, pool.GetAxisX()[i], pool.GetAxisY()[i],
+                                  pool.GetColor()[i], pool.GetShape(i));
+            } else if (!shapeIndex.empty() && shapeIndex[i] != 0) {
+                Vector3f axisX, axisY;
+                ComputeQuadAxes(RenderModeParams(), center, Vector3f(0, 0, 0),
+                                pool.GetSize()[i], pool.GetRotation()[i], camera, axisX, axisY);
+                WriteExpandedQuad(&out[k * stride], center, axisX, axisY, pool.GetColor()[i], pool.GetShape(i));
+            }
+        }
+    };
+
+    const ParticleShape& shape = pool.GetShapes()[0];
+
+    // Storage order is already contiguous: expand in place
+    if (order.empty()) {
+        ExpandQuads(&pool.GetX()[first], &pool.GetY()[first], &pool.GetZ()[first],
+                    &pool.GetSize()[first], &pool.GetRotation()[first], &pool.GetColor()[first],
+                    count, camera, out, shape);
+        writeOriented();
+        return;
+    }
+
+    // Sorted: gather each batch in draw order first
+    ExpandBatch batch;
+    for (uint32_t start = 0; start < count; start += kExpandBatchSize) {
+        const uint32_t batchCount = std::min(kExpandBatchSize, count - start);
+
+        for (uint32_t k = 0; k < batchCount; ++k) {
+            const uint32_t i = order[first + start + k];
+            batch.x[k] = pool.GetX()[i];
+            batch.y[k] = pool.GetY()[i];
+            batch.z[k] = pool.GetZ()[i];
+            batch.size[k] = pool.GetSize()[i];
+            batch.rotation[k] = pool.GetRotation()[i];
+            batch.color[k] = pool.GetColor()[i];
+        }
+
+        ExpandQuads(batch.x, batch.y, batch.z, batch.size, batch.rotation, batch.color,
+                    batchCount, camera, &out[start * stride], shape);
+    }
+    writeOriented();
+}
+
+void RenderPacketBuilder::BuildFanIndices(uint16_t* out, uint32_t particleCount, uint32_t verticesPerParticle) {
+    for (uint32_t q = 0; q < particleCount; ++q) {
+        const uint16_t base = static_cast<uint16_t>(q * verticesPerParticle);
+
+        // Fan around the first corner; for quads: bottom-left, bottom-right,
+        // top-right, then bottom-left, top-right, top-left
+        for (uint32_t t = 0; t + 2 < verticesPerParticle; ++t) {
+            out[0] = base;
+            out[1] = static_cast<uint16_t>(base + t + 1);
+            out[2] = static_cast<uint16_t>(base + t + 2);
+            out += 3;
+        }
+    }
+}
+
+template <typename Vertex>
+uint32_t RenderPacketBuilder::BuildInstanceVertices(const ParticleView& view,
+                                                    const InstanceTransform& transform,
+                                                    Vertex* out,
+                                                    uint32_t maxParticles) {
+    const Color& tint = transform.tint;
+    uint32_t written = 0;
+
+    for (size_t i = 0; i < view.GetDrawCount() && written < maxParticles; ++i) {
+        const Particle& p = view.GetDrawParticle(i);
+        Vector3f center;
+        float size, alphaScale;
+        if (!p.alive || !PlaceInstanceParticle(transform, view, i, center, size, alphaScale)) {
+            continue;
+        }
+
+        uint32_t color = PackParticleColor(p.color, tint, alphaScale, transform.blend);
+
+        WriteBillboard(&out[written * transform.shape.vertexCount], center, color,
+                       size, p.rotation, transform.shape);
+        written++;
+    }
+
+    return written;
+}
+
+template <typename Vertex>
+void RenderPacketBuilder::BuildPoolVertices(const ParticlePool& pool,
+                                            uint32_t first,
+                                            uint32_t count,
+                                            Vertex* out) {
+    const std::vector<uint32_t>& order = pool.GetOrder();
+    const std::vector<float>& px = pool.GetX();
+    const std::vector<float>& py = pool.GetY();
+    const std::vector<float>& pz = pool.GetZ();
+    const std::vector<float>& size = pool.GetSize();
+    const std::vector<float>& rotation = pool.GetRotation();
+    const std::vector<uint32_t>& colors = pool.GetColor();
+    const std::vector<uint8_t>& oriented = pool.GetOriented();
+    const uint32_t stride = pool.GetVerticesPerParticle();
+
+    for (uint32_t k = 0; k < count; ++k) {
+        // Unsorted pools are drawn in storage order
+        uint32_t i = order.empty() ? first + k : order[first + k];
+
+        if (!oriented.empty() && oriented[i]) {
+            WriteOrientedQuad(&out[k * stride], Vector3f(px[i], py[i], pz[i]),
+                              pool.GetAxisX()[i], pool.GetAxisY()[i], colors[i], pool.GetShape(i));
+            continue;
+        }
+        WriteBillboard(&out[k * stride], Vector3f(px[i], py[i], pz[i]), colors[i],
+                       size[i], rotation[i], pool.GetShape(i));
+    }
+}
+
+uint32_t RenderPacketBuilder::BuildInstance(const ParticleView& view,
+                                            const InstanceTransform& transform,
+                                            const CameraData& camera,
+                                            VertexFormat format,
+                                            void* out,
+                                            uint32_t maxParticles) {
+    if (!transform.renderMode.IsCameraFacing()) {
+        return BuildInstanceOriented(view, transform, camera, format, out, maxParticles);
+    }
+    if (format == VertexFormat::Expanded) {
+        return BuildInstanceExpanded(view, transform, camera, static_cast<ParticleVertex*>(out), maxParticles);
+    }
+    if (format == VertexFormat::Compact) {
+        return BuildInstanceVertices(view, transform, static_cast<CompactParticleVertex*>(out), maxParticles);
+    }
+    return BuildInstanceVertices(view, transform, static_cast<ParticleVertex*>(out), maxParticles);
+}
+
+void RenderPacketBuilder::BuildPool(const ParticlePool& pool,
+                                    uint32_t first,
+                                    uint32_t count,
+                                    const CameraData& camera,
+                                    VertexFormat format,
+                                    void* out,
+                                    WorkerPool* workers) {
+    if (workers && workers->GetWorkerCount() > 0 && count >= 2 * kMinParticlesPerTask) {
+        // Slice k of the draw order fills slice k of the buffer; only the
+        // caller touches the device
+        const uint32_t vertexBytes = pool.GetVerticesPerParticle() * GetVertexStride(format);
+        workers->ParallelFor(count, kMinParticlesPerTask, [&](uint32_t begin, uint32_t end) {
+            BuildPool(pool, first + begin, end - begin, camera, format,
+                      static_cast<uint8_t*>(out) + static_cast<size_t>(begin) * vertexBytes);
+        });
+        return;
+    }
+
+    if (format == VertexFormat::Expanded) {
+        BuildPoolExpanded(pool, first, count, camera, static_cast<ParticleVertex*>(out));
+    } else if (format == VertexFormat::Compact) {
+        BuildPoolVertices(pool, first, count, static_cast<CompactParticleVertex*>(out));
+    } else {
+        BuildPoolVertices(pool, first, count, static_cast<ParticleVertex*>(out));
+    }
+}
+
+} // namespace GPUParticles
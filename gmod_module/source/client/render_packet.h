@@ -0,0 +1,705 @@
+#pragma once
+
+#include "alpha_hull.h"
+#include "cpu_particle_simulator.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GPUParticles {
+
+class ParticlePool;
+
+// Simple vector structures to replace D3DX types
+struct Vector3f {
+    float x, y, z;
+    Vector3f() : x(0), y(0), z(0) {}
+    Vector3f(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+};
+
+struct Vector2f {
+    float x, y;
+    Vector2f() : x(0), y(0) {}
+    Vector2f(float _x, float _y) : x(_x), y(_y) {}
+};
+
+// Simple 4x4 matrix structure to replace D3DXMATRIX
+struct Matrix4x4 {
+    float m[4][4];
+
+    Matrix4x4() {
+        // Identity matrix
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                m[i][j] = (i == j) ? 1.0f : 0.0f;
+            }
+        }
+    }
+
+    // Access operator
+    float* operator[](int row) { return m[row]; }
+    const float* operator[](int row) const { return m[row]; }
+
+    // Multiply two matrices
+    static Matrix4x4 Multiply(const Matrix4x4& a, const Matrix4x4& b) {
+        Matrix4x4 result;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                result.m[i][j] = 0;
+                for (int k = 0; k < 4; k++) {
+                    result.m[i][j] += a.m[i][k] * b.m[k][j];
+                }
+            }
+        }
+        return result;
+    }
+
+    // Create from float array (row-major)
+    static Matrix4x4 FromArray(const float* arr) {
+        Matrix4x4 result;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                result.m[i][j] = arr[i * 4 + j];
+            }
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Vertex format for particle rendering
+ */
+struct ParticleVertex {
+    Vector3f position;       // Particle center
+    uint32_t color;          // A8R8G8B8 (same layout as D3DCOLOR)
+    Vector2f sizeRot;        // x=size, y=rotation (radians)
+    Vector2f corner;         // Corner offset (-1 to 1), see ParticleShape
+};
+
+/**
+ * @brief Quantized vertex format, 24 bytes instead of 32
+ *
+ * Size and rotation are half floats and the corner is a pair of 16-bit
+ * normalized integers. Needs D3DDECLTYPE_FLOAT16_2 and SHORT2N support.
+ */
+struct CompactParticleVertex {
+    Vector3f position;       // Particle center
+    uint32_t color;          // A8R8G8B8
+    uint16_t size;           // Half float
+    uint16_t rotation;       // Half float
+    int16_t cornerX;         // Corner offset times kCornerScale
+    int16_t cornerY;
+
+    static constexpr float kCornerScale = 32767.0f;
+};
+
+static_assert(sizeof(ParticleVertex) == 32, "ParticleVertex must match its vertex declaration");
+static_assert(sizeof(CompactParticleVertex) == 24, "CompactParticleVertex must match its vertex declaration");
+
+/**
+ * @brief One point sprite, for particles only a few pixels wide
+ *
+ * Drawn as D3DPT_POINTLIST with one vertex per particle instead of a
+ * billboard of four. The alpha byte carries the sprite's width (the
+ * vertex shader writes it to PSIZE), so the particle's own alpha is
+ * folded into its area; see RenderPacketBuilder::PackPointSprite.
+ */
+struct PointSpriteVertex {
+    Vector3f position;       // Particle center
+    uint32_t color;          // R8G8B8, alpha = width in pixels times kSizeScale
+
+    static constexpr float kSizeScale = 16.0f;
+    static constexpr float kMaxPixels = 255.0f / kSizeScale;
+};
+
+static_assert(sizeof(PointSpriteVertex) == 16, "PointSpriteVertex must match its vertex declaration");
+
+/**
+ * @brief Vertex layout written by RenderPacketBuilder
+ */
+enum class VertexFormat {
+    Standard,   // ParticleVertex
+    Compact,    // CompactParticleVertex
+    Expanded    // ParticleVertex with final corner positions and 0-1 UVs (CPU billboarding)
+};
+
+/**
+ * @brief Size in bytes of one vertex of a format
+ */
+uint32_t GetVertexStride(VertexFormat format);
+
+/**
+ * @brief Convert to IEEE half float (round to nearest, clamped to the half range)
+ */
+uint16_t FloatToHalf(float value);
+
+/**
+ * @brief Pack a color into A8R8G8B8 (channels clamped to 0-1)
+ */
+uint32_t PackColorARGB(float r, float g, float b, float a);
+
+/**
+ * @brief How particle colors combine with the framebuffer
+ *
+ * Only Alpha depends on draw order; the other modes are drawn unsorted
+ * and batched freely across instances.
+ */
+enum class BlendMode {
+    Alpha,          // SRCALPHA / INVSRCALPHA
+    Premultiplied,  // ONE / INVSRCALPHA, vertex color premultiplied by alpha
+    Additive,       // SRCALPHA / ONE
+    Count
+};
+
+/**
+ * @brief Blend mode of an effect from its exported material name
+ *
+ * Words such as "Additive" or "Add" ("Sparks_Add", "ParticleAddSmooth")
+ * select Additive, "Premultiply" selects Premultiplied, anything else is
+ * alpha blended.
+ */
+BlendMode ClassifyBlendMode(const std::string& material);
+
+/**
+ * @brief Particle color times the instance tint and alpha, packed for a blend mode
+ */
+uint32_t PackParticleColor(const Color& color, const Color& tint, float alphaScale, BlendMode blend);
+
+/**
+ * @brief Scale the alpha of a color packed by PackParticleColor
+ *
+ * Premultiplied colors scale their color channels to match, so a packed
+ * color can be adjusted per view without the particle it came from.
+ */
+uint32_t ScaleParticleAlpha(uint32_t color, float alphaScale, BlendMode blend);
+
+/**
+ * @brief Camera vectors needed to build billboards
+ */
+struct CameraData {
+    Vector3f position;
+    Vector3f right;
+    Vector3f up;
+    Vector3f forward;
+
+    /**
+     * @brief Extract the camera basis from a row-major view matrix
+     */
+    static CameraData FromViewMatrix(const float* viewMatrix, const float* cameraPos);
+};
+
+/**
+ * @brief Read-only view of one simulation's particle storage
+ *
+ * Drawn in storage order, or in the given order of slot indices when the
+ * effect sorts its particles.
+ */
+struct ParticleView {
+    const Particle* particles;
+    size_t count;          // Pool size, including dead slots
+    const uint32_t* order; // Slots in draw order, or nullptr
+    size_t orderCount;
+
+    ParticleView() : particles(nullptr), count(0), order(nullptr), orderCount(0) {}
+    ParticleView(const std::vector<Particle>& storage)
+        : particles(storage.data()), count(storage.size()), order(nullptr), orderCount(0) {}
+    ParticleView(const std::vector<Particle>& storage, const std::vector<uint32_t>& drawOrder)
+        : particles(storage.data()), count(storage.size()),
+          order(drawOrder.data()), orderCount(drawOrder.size()) {}
+
+    size_t GetDrawCount() const { return order ? orderCount : count; }
+    uint32_t GetDrawSlot(size_t i) const { return order ? order[i] : static_cast<uint32_t>(i); }
+    const Particle& GetDrawParticle(size_t i) const { return particles[GetDrawSlot(i)]; }
+};
+
+/**
+ * @brief Quad orientation of an effect (from its RendererModule)
+ */
+struct RenderModeParams {
+    ParticleSystemRenderMode mode;
+    Vector3f velocityScale;    // Stretch: per-axis velocity multiplier for the extra length
+    float lengthScale;         // Stretch: half-length in multiples of the half-width
+    float minScreenSize;       // Particle size limits as fractions of the viewport height
+    float maxScreenSize;       // (0 = no upper limit)
+
+    RenderModeParams()
+        : mode(ParticleSystemRenderMode::Billboard), lengthScale(2.0f),
+          minScreenSize(0.0f), maxScreenSize(0.5f) {}
+    explicit RenderModeParams(const RendererModule& renderer)
+        : mode(renderer.renderMode),
+          velocityScale(renderer.velocityScale.x, renderer.velocityScale.y, renderer.velocityScale.z),
+          lengthScale(renderer.lengthScale),
+          minScreenSize(renderer.minParticleSize),
+          maxScreenSize(renderer.maxParticleSize) {}
+
+    // Billboard, and Mesh until meshes are supported
+    bool IsCameraFacing() const {
+        return mode == ParticleSystemRenderMode::Billboard || mode == ParticleSystemRenderMode::Mesh;
+    }
+};
+
+/**
+ * @brief Particles changed or removed by each ScreenSizeFilter rule
+ */
+struct ScreenSizeStats {
+    uint32_t clampedMax;      // Shrunk to the effect's maxParticleSize
+    uint32_t clampedMin;      // Grown to the effect's minParticleSize
+    uint32_t subPixelKept;    // Grown to the pixel threshold, alpha lowered to match
+    uint32_t subPixelCulled;  // Thinned out below the pixel threshold
+    uint32_t detailCulled;    // Thinned out by a reduced view detail
+    uint32_t pointSprites;    // Drawn as point sprites
+    uint32_t pointCulled;     // Thinned out while folding alpha into point sprite size
+
+    ScreenSizeStats() : clampedMax(0), clampedMin(0), subPixelKept(0), subPixelCulled(0), detailCulled(0),
+                        pointSprites(0), pointCulled(0) {}
+
+    void Add(const ScreenSizeStats& other) {
+        clampedMax += other.clampedMax;
+        clampedMin += other.clampedMin;
+        subPixelKept += other.subPixelKept;
+        subPixelCulled += other.subPixelCulled;
+        detailCulled += other.detailCulled;
+        pointSprites += other.pointSprites;
+        pointCulled += other.pointCulled;
+    }
+};
+
+/**
+ * @brief Per-particle projected size rules applied while building vertices
+ *
+ * Applies the effect's min/maxParticleSize like Unity, then handles
+ * particles smaller than a pixel threshold: they are drawn at the
+ * threshold size with their alpha lowered by the area ratio, so the
+ * coverage they add to the frame stays the same. Where that alpha would
+ * be too faint to survive 8-bit blending, only a matching fraction of
+ * them is kept, at a visible alpha; the choice is a hash of the particle,
+ * so the same ones survive from frame to frame.
+ */
+class ScreenSizeFilter {
+public:
+    // Lowest alpha a compensated particle is drawn with before thinning
+    static constexpr float kMinSubPixelAlpha = 1.0f / 16.0f;
+
+    ScreenSizeFilter();
+
+    /**
+     * @brief Project with this camera for the following frames
+     * @param projMatrix Projection matrix (element [1][1] is the vertical scale)
+     * @param viewportHeight Render target height in pixels
+     */
+    void SetView(const CameraData& camera, const float* projMatrix, float viewportHeight);
+
+    /**
+     * @brief Particles narrower than this many pixels are merged (0 = off)
+     */
+    void SetMinPixelSize(float pixels) { m_minPixelSize = pixels; }
+    float GetMinPixelSize() const { return m_minPixelSize; }
+
+    /**
+     * @brief Fraction of particles drawn in this view (1 = all)
+     *
+     * For secondary views such as reflections. The kept particles grow and
+     * brighten within the budget manager's limits to cover for the others.
+     */
+    void SetDetail(float fraction) { m_detail = std::max(0.0f, std::min(1.0f, fraction)); }
+    float GetDetail() const { return m_detail; }
+
+    /**
+     * @brief Camera-facing particles narrower than this many pixels become point sprites (0 = never)
+     *
+     * Decided after the size rules, so it compares the width the particle
+     * would be drawn with. Capped at PointSpriteVertex::kMaxPixels.
+     */
+    void SetPointSpriteSize(float pixels) {
+        m_pointSpriteSize = std::max(0.0f, std::min(PointSpriteVertex::kMaxPixels, pixels));
+    }
+    float GetPointSpriteSize() const { return m_pointSpriteSize; }
+
+    bool IsEnabled() const { return m_projScale > 0.0f; }
+
+    /**
+     * @brief Projected width of a particle in pixels (0 when it cannot be projected)
+     * @param size Half-extent in world units
+     */
+    float GetPixelSize(const Vector3f& center, float size) const;
+
+    /**
+     * @brief Whether a particle that passed Apply is drawn as a point sprite
+     * @param size Half-extent as adjusted by Apply
+     * @param pixels Its projected width, when it is
+     */
+    bool IsPointSprite(const RenderModeParams& params, const Vector3f& center, float size, float& pixels) const;
+
+    /**
+     * @brief Stable per-particle key for the thinning decision
+     */
+    static uint32_t GetParticleKey(uint32_t slot, float lifetime, const Vector3f& emitter);
+
+    /**
+     * @brief Apply the size rules to one particle
+     * @param size Half-extent in world units, adjusted in place
+     * @param opacity Particle alpha before alphaScale (decides when to thin)
+     * @param alphaScale Alpha multiplier, adjusted in place
+     * @return False if the particle is thinned out
+     */
+    bool Apply(const RenderModeParams& params,
+               const Vector3f& center,
+               uint32_t key,
+               float opacity,
+               float& size,
+               float& alphaScale,
+               ScreenSizeStats& stats) const;
+
+private:
+    Vector3f m_cameraPosition;
+    Vector3f m_cameraForward;
+    float m_projScale;       // Viewport-height fraction of a unit half-extent particle at unit depth
+    float m_viewportHeight;
+    float m_minPixelSize;
+    float m_detail;
+    float m_pointSpriteSize;
+};
+
+/**
+ * @brief Structure-of-arrays scratch for oriented quad generation
+ *
+ * Gathered particles go in, OrientQuads fills the two half-extent axes.
+ */
+struct OrientedQuadBatch {
+    static constexpr uint32_t kCapacity = 256;
+
+    float x[kCapacity], y[kCapacity], z[kCapacity];        // World-space centers
+    float vx[kCapacity], vy[kCapacity], vz[kCapacity];     // Scaled velocity (Stretch only)
+    float size[kCapacity];
+    float rotation[kCapacity];
+    uint32_t color[kCapacity];
+
+    // Corner (cx, cy) is at center + cx * axisX + cy * axisY
+    float axisXx[kCapacity], axisXy[kCapacity], axisXz[kCapacity];
+    float axisYx[kCapacity], axisYy[kCapacity], axisYz[kCapacity];
+};
+
+/**
+ * @brief Convex outline every particle of an effect is drawn with
+ *
+ * Corners are offsets in the -1..1 space of the billboard quad (y up), so
+ * the billboard shader and ExpandCorner place them like quad corners and
+ * the texture coordinates follow. Drawn as a triangle fan. Corners may
+ * repeat: the extra triangles are empty, which lets outlines of different
+ * sizes share one stream (see PaddedTo).
+ */
+struct ParticleShape {
+    static constexpr uint32_t kMaxVertices = AlphaHull::kMaxVertices;
+
+    uint32_t vertexCount;
+    Vector2f corners[kMaxVertices];
+
+    /**
+     * @brief The full quad (bottom-left, bottom-right, top-right, top-left)
+     */
+    ParticleShape();
+
+    /**
+     * @brief Outline from a texture-space hull
+     */
+    static ParticleShape FromHull(const AlphaHull& hull);
+
+    /**
+     * @brief Same outline with its last corner repeated up to count corners
+     */
+    ParticleShape PaddedTo(uint32_t count) const;
+
+    /**
+     * @brief Corners per particle of a stream that draws shapes of up to this many
+     *
+     * Rounded up to an even count of at least 4, so the index buffer only
+     * needs fans of 4, 6 and 8 corners.
+     */
+    static uint32_t GetStreamVertexCount(uint32_t vertexCount) {
+        return std::max(4u, vertexCount + (vertexCount & 1u));
+    }
+};
+
+/**
+ * @brief Where and how one instance draws a particle view
+ */
+struct InstanceTransform {
+    Vector3f position;     // Emitter position in world space
+    float scale;           // Particle size multiplier
+    float alphaScale;      // Alpha multiplier (budget compensation)
+    Color tint;            // Color multiplier
+    BlendMode blend;       // Premultiplied needs premultiplied vertex colors
+    RenderModeParams renderMode;
+    ParticleShape shape;   // Padded to the vertices per particle of the stream
+    const ScreenSizeFilter* sizeFilter;  // Optional
+    ScreenSizeStats* sizeStats;          // Where sizeFilter counts; required with it
+
+    InstanceTransform() : scale(1.0f), alphaScale(1.0f), tint(1, 1, 1, 1), blend(BlendMode::Alpha),
+                          sizeFilter(nullptr), sizeStats(nullptr) {}
+};
+
+/**
+ * @brief Vertices one instance was last drawn with, kept for reuse
+ *
+ * Valid while the particles they were built from are unchanged. Camera
+ * billboards expanded on the CPU also depend on the view direction; with
+ * shader-side billboarding only the screen-size rules depend on the
+ * camera, through its position.
+ */
+struct VertexCache {
+    std::vector<uint8_t> vertices;
+    uint32_t particleCount;
+    uint32_t verticesPerParticle;
+    VertexFormat format;
+    bool orientationDependent;  // Built with camera-oriented corners
+    CameraData camera;          // View they were built for
+    uint32_t generation;        // Renderer settings they were built with
+    bool valid;
+
+    VertexCache() : particleCount(0), verticesPerParticle(0), format(VertexFormat::Standard),
+                    orientationDependent(false), generation(0), valid(false) {}
+
+    void Invalidate() { valid = false; }
+
+    /**
+     * @brief Whether a view can draw these vertices instead of building its own
+     * @param maxCameraMove Camera distance from the cached view allowed, in world units
+     * @param minAxisDot Cosine of the largest camera rotation allowed when orientation matters
+     */
+    bool CanReuse(VertexFormat viewFormat,
+                  uint32_t viewVerticesPerParticle,
+                  uint32_t viewParticleCount,
+                  const CameraData& viewCamera,
+                  float maxCameraMove,
+                  float minAxisDot) const;
+
+    /**
+     * @brief Whether two views are within the reuse limits of each other
+     */
+    static bool IsCameraClose(const CameraData& a,
+                              const CameraData& b,
+                              float maxCameraMove,
+                              float minAxisDot,
+                              bool checkOrientation);
+};
+
+/**
+ * @brief Platform-neutral billboard vertex generation
+ *
+ * Turns particles into quads written to a caller-provided vertex array.
+ * Every corner carries the particle center, size, rotation and its
+ * corner offset; the vertex shader does the camera-facing expansion
+ * (ExpandCorner is the same math on the CPU). Has no graphics API
+ * dependency, so the DX9 renderer, an OpenGL path or a headless tool can
+ * all share it.
+ */
+class RenderPacketBuilder {
+public:
+    // One indexed triangle fan per particle, kMaxVertices corners at most
+    static uint32_t GetIndicesPerParticle(uint32_t verticesPerParticle) {
+        return 3 * (verticesPerParticle - 2);
+    }
+
+    // Particles addressable by 16-bit indices in one draw
+    static uint32_t GetMaxParticlesPerDraw(uint32_t verticesPerParticle) {
+        return 65536 / verticesPerParticle;
+    }
+
+    // Particles gathered per CPU expansion batch
+    static constexpr uint32_t kExpandBatchSize = 256;
+
+    // Smallest range of particles handed to a worker thread
+    static constexpr uint32_t kMinParticlesPerTask = 2048;
+
+    /**
+     * @brief Write billboards for the alive particles of one instance
+     * @param camera Used by VertexFormat::Expanded and oriented render modes
+     * @param format Layout of the vertices in out
+     * @param out Vertex array with room for maxParticles * transform.shape.vertexCount vertices
+     * @return Number of particles written
+     */
+    static uint32_t BuildInstance(const ParticleView& view,
+                                  const InstanceTransform& transform,
+                                  const CameraData& camera,
+                                  VertexFormat format,
+                                  void* out,
+                                  uint32_t maxParticles);
+
+    /**
+     * @brief Write billboards for a range of a pool in its sorted order
+     * @param first Position in the draw order to start at
+     * @param count Number of particles to write
+     * @param camera Used by VertexFormat::Expanded and oriented render modes
+     * @param format Layout of the vertices in out
+     * @param out Vertex array with room for count * pool.GetVerticesPerParticle() vertices
+     * @param workers Optional; large ranges are split into disjoint slices of out
+     */
+    static void BuildPool(const ParticlePool& pool,
+                          uint32_t first,
+                          uint32_t count,
+                          const CameraData& camera,
+                          VertexFormat format,
+                          void* out,
+                          WorkerPool* workers = nullptr);
+
+    /**
+     * @brief Write the triangle fan pattern for consecutive particles
+     * @param out Index array with room for particleCount * GetIndicesPerParticle() entries
+     * @param particleCount Number of particles (at most GetMaxParticlesPerDraw())
+     */
+    static void BuildFanIndices(uint16_t* out, uint32_t particleCount, uint32_t verticesPerParticle);
+
+    /**
+     * @brief Write the corners of one particle
+     */
+    static void WriteBillboard(ParticleVertex* out,
+                               const Vector3f& center,
+                               uint32_t color,
+                               float size,
+                               float rotation,
+                               const ParticleShape& shape = ParticleShape());
+    static void WriteBillboard(CompactParticleVertex* out,
+                               const Vector3f& center,
+                               uint32_t color,
+                               float size,
+                               float rotation,
+                               const ParticleShape& shape = ParticleShape());
+
+    /**
+     * @brief Pack a particle drawn as a point sprite
+     *
+     * The sprite's alpha byte holds its width, so it is drawn opaque and
+     * its alpha goes into the area instead: sqrt(alpha) times as wide,
+     * which keeps the coverage it adds to the frame. Below one pixel it is
+     * drawn one pixel wide and kept with the probability of its remaining
+     * coverage, chosen by its key like the sub-pixel thinning.
+     *
+     * @param color Packed by PackParticleColor for blend (premultiplied colors are divided back)
+     * @param pixels Projected width (ScreenSizeFilter::GetPixelSize)
+     * @param key ScreenSizeFilter::GetParticleKey
+     * @return False if the particle is thinned out
+     */
+    static bool PackPointSprite(const Vector3f& center,
+                                uint32_t color,
+                                float pixels,
+                                BlendMode blend,
+                                uint32_t key,
+                                PointSpriteVertex& out);
+
+    /**
+     * @brief World position of one corner, as the billboard vertex shader computes it
+     * @param cornerX Corner offset along the camera right axis (-1 to 1)
+     * @param cornerY Corner offset along the camera up axis (-1 to 1)
+     */
+    static Vector3f ExpandCorner(const Vector3f& center,
+                                 float size,
+                                 float rotation,
+                                 float cornerX,
+                                 float cornerY,
+                                 const CameraData& camera);
+
+    /**
+     * @brief Half-extent axes of one quad (scalar reference for OrientQuads)
+     *
+     * Billboard gives the rotated camera axes (ExpandCorner), horizontal
+     * billboards lie in the world XY plane, vertical billboards stand
+     * along world Z and turn to the camera, and stretched quads run axisY
+     * along the velocity, longer with speed, and face the camera around
+     * it. Stretch ignores rotation and falls back to a billboard when the
+     * particle is still or moves straight along the view ray.
+     *
+     * @param velocity Velocity already multiplied by velocityScale
+     */
+    static void ComputeQuadAxes(const RenderModeParams& params,
+                                const Vector3f& center,
+                                const Vector3f& velocity,
+                                float size,
+                                float rotation,
+                                const CameraData& camera,
+                                Vector3f& axisX,
+                                Vector3f& axisY);
+
+    /**
+     * @brief ComputeQuadAxes for a whole batch, four particles at a time with SSE
+     */
+    static void OrientQuads(const RenderModeParams& params,
+                            const CameraData& camera,
+                            OrientedQuadBatch& batch,
+                            uint32_t count);
+
+    /**
+     * @brief Write the corners of a particle with precomputed axes
+     *
+     * The shader formats get the final corner with a zero size, so the
+     * billboard shader passes it through and quads of every mode share
+     * one stream. The Expanded variant writes 0-1 UVs instead of corners.
+     */
+    static void WriteOrientedQuad(ParticleVertex* out,
+                                  const Vector3f& center,
+                                  const Vector3f& axisX,
+                                  const Vector3f& axisY,
+                                  uint32_t color,
+                                  const ParticleShape& shape = ParticleShape());
+    static void WriteOrientedQuad(CompactParticleVertex* out,
+                                  const Vector3f& center,
+                                  const Vector3f& axisX,
+                                  const Vector3f& axisY,
+                                  uint32_t color,
+                                  const ParticleShape& shape = ParticleShape());
+    static void WriteExpandedQuad(ParticleVertex* out,
+                                  const Vector3f& center,
+                                  const Vector3f& axisX,
+                                  const Vector3f& axisY,
+                                  uint32_t color,
+                                  const ParticleShape& shape = ParticleShape());
+
+    /**
+     * @brief Expand rotated billboards on the CPU (VertexFormat::Expanded)
+     *
+     * Takes particles as separate arrays and does four at a time with SSE,
+     * including a batched sin/cos for the rotation. Vertices are written
+     * in order, so out can point straight into a locked buffer.
+     *
+     * @param out Vertex array with room for count * shape.vertexCount vertices
+     */
+    static void ExpandQuads(const float* x, const float* y, const float* z,
+                            const float* size, const float* rotation, const uint32_t* color,
+                            uint32_t count,
+                            const CameraData& camera,
+                            ParticleVertex* out,
+                            const ParticleShape& shape = ParticleShape());
+
+private:
+    static uint32_t BuildInstanceOriented(const ParticleView& view,
+                                          const InstanceTransform& transform,
+                                          const CameraData& camera,
+                                          VertexFormat format,
+                                          void* out,
+                                          uint32_t maxParticles);
+    static uint32_t BuildInstanceExpanded(const ParticleView& view,
+                                          const InstanceTransform& transform,
+                                          const CameraData& camera,
+                                          ParticleVertex* out,
+                                          uint32_t maxParticles);
+    static void BuildPoolExpanded(const ParticlePool& pool,
+                                  uint32_t first,
+                                  uint32_t count,
+                                  const CameraData& camera,
+                                  ParticleVertex* out);
+
+    template <typename Vertex>
+    static uint32_t BuildInstanceVertices(const ParticleView& view,
+                                          const InstanceTransform& transform,
+                                          Vertex* out,
+                                          uint32_t maxParticles);
+
+    template <typename Vertex>
+    static void BuildPoolVertices(const ParticlePool& pool,
+                                  uint32_t first,
+                                  uint32_t count,
+                                  Vertex* out);
+};
+
+} // namespace GPUParticles
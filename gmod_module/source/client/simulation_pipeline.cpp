@@ -0,0 +1,102 @@
+#include "simulation_pipeline.h"
+#include <chrono>
+
+namespace GPUParticles {
+
+// ============================================================================
+// ParticleSnapshot
+// ============================================================================
+
+void ParticleSnapshot::CopyFrom(const CPUParticleSimulator& simulator) {
+    const std::vector<Particle>& source = simulator.GetParticles();
+    particles.assign(source.begin(), source.end());
+    aliveCount = simulator.GetAliveCount();
+    bounds = simulator.GetBounds();
+}
+
+// ============================================================================
+// SimulationPipeline
+// ============================================================================
+
+SimulationPipeline::SimulationPipeline()
+    : m_busy(false)
+    , m_stopping(false)
+{
+}
+
+SimulationPipeline::~SimulationPipeline() {
+    Shutdown();
+}
+
+void SimulationPipeline::Initialize() {
+    Shutdown();
+
+    m_stopping = false;
+    m_thread = std::thread(&SimulationPipeline::ThreadLoop, this);
+}
+
+void SimulationPipeline::Shutdown() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void SimulationPipeline::Kick(std::function<void()> job) {
+    Wait();
+
+    if (!m_thread.joinable()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = std::move(job);
+        m_busy = true;
+    }
+    m_wake.notify_all();
+}
+
+int SimulationPipeline::Wait() {
+    auto start = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_busy) {
+        return 0;
+    }
+    m_done.wait(lock, [this] { return !m_busy; });
+
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void SimulationPipeline::ThreadLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stopping || m_busy; });
+        if (!m_busy) {
+            return;  // Stopping with nothing left to run
+        }
+
+        std::function<void()> job = std::move(m_job);
+        m_job = nullptr;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        m_busy = false;
+        m_done.notify_all();
+    }
+}
+
+} // namespace GPUParticles
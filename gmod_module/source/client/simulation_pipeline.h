@@ -0,0 +1,126 @@
+#pragma once
+
+#include "cpu_particle_simulator.h"
+#include "particle_bounds.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Particles and bounds of a simulation frozen after an update
+ */
+struct ParticleSnapshot {
+    std::vector<Particle> particles;
+    int aliveCount = 0;
+    BoundsAccumulator bounds;
+
+    /**
+     * @brief Copy the simulator's current state (reuses the capacity)
+     */
+    void CopyFrom(const CPUParticleSimulator& simulator);
+};
+
+/**
+ * @brief Lock-free triple buffer between one writer and one reader
+ *
+ * The writer fills its private buffer and publishes it by swapping it
+ * with the shared middle one; the reader swaps the middle one in when
+ * something newer was published. Neither side ever blocks, and the
+ * reader's buffer stays untouched until its next Acquire.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_middle(1), m_write(0), m_read(2) {}
+
+    T& GetWriteBuffer() { return m_buffers[m_write]; }
+
+    /**
+     * @brief Hand the write buffer to the reader
+     */
+    void Publish() {
+        uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_write | kFresh), std::memory_order_acq_rel);
+        m_write = previous & kIndexMask;
+    }
+
+    /**
+     * @brief Take the newest published buffer, if any
+     * @return True if the read buffer changed
+     */
+    bool Acquire() {
+        if (!(m_middle.load(std::memory_order_relaxed) & kFresh)) {
+            return false;
+        }
+        uint8_t previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & kIndexMask;
+        return true;
+    }
+
+    const T& GetReadBuffer() const { return m_buffers[m_read]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFresh = 0x4;  // Middle was published since the last Acquire
+
+    T m_buffers[3];
+    std::atomic<uint8_t> m_middle;  // Index of the shared buffer | kFresh
+    uint8_t m_write;                // Owned by the writer
+    uint8_t m_read;                 // Owned by the reader
+};
+
+/**
+ * @brief Runs one simulation job at a time on a dedicated thread
+ *
+ * Kick hands a job over and returns at once, so the game thread goes on
+ * to render while the next frame simulates. Wait is the only point where
+ * the two threads synchronize; results are exchanged through snapshots.
+ * Without a thread (not initialized) jobs run inline in Kick.
+ */
+class SimulationPipeline {
+public:
+    SimulationPipeline();
+    ~SimulationPipeline();
+
+    /**
+     * @brief Start the simulation thread
+     */
+    void Initialize();
+
+    /**
+     * @brief Finish the running job and join the thread
+     */
+    void Shutdown();
+
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    /**
+     * @brief Start a job after the previous one has finished
+     */
+    void Kick(std::function<void()> job);
+
+    /**
+     * @brief Block until the current job (if any) is done
+     * @return Microseconds spent waiting
+     */
+    int Wait();
+
+private:
+    void ThreadLoop();
+
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::function<void()> m_job;
+    bool m_busy;
+    bool m_stopping;
+};
+
+} // namespace GPUParticles
@@ -0,0 +1,83 @@
+#include "update_scheduler.h"
+#include <algorithm>
+
+namespace GPUParticles {
+
+// Longest update interval in frames
+static const int kMaxUpdateInterval = 8;
+
+UpdateScheduler::UpdateScheduler()
+    : m_frameBudget(2000)
+    , m_fullRateDistance(1500.0f)
+    , m_frame(0)
+    , m_lastUpdated(0)
+    , m_lastDeferred(0)
+    , m_lastElapsed(0)
+{
+}
+
+void UpdateScheduler::SetFrameBudget(int microseconds) {
+    m_frameBudget = std::max(0, microseconds);
+}
+
+void UpdateScheduler::SetFullRateDistance(float distance) {
+    m_fullRateDistance = std::max(1.0f, distance);
+}
+
+int UpdateScheduler::GetUpdateInterval(const ScheduleRequest& request) const {
+    // Higher priority pushes the interval bands further out
+    float distance = request.distance / std::max(0.01f, request.priority);
+
+    int interval = 1;
+    float band = m_fullRateDistance;
+    while (distance > band && interval < kMaxUpdateInterval) {
+        interval *= 2;
+        band *= 2.0f;
+    }
+    return interval;
+}
+
+void UpdateScheduler::BeginFrame(const std::vector<ScheduleRequest>& requests, std::vector<size_t>& order) {
+    m_frameStart = std::chrono::steady_clock::now();
+    m_frame++;
+
+    order.clear();
+    m_urgency.assign(requests.size(), 0.0f);
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const ScheduleRequest& request = requests[i];
+        int interval = GetUpdateInterval(request);
+
+        // Deferred instances stay due until they get their update
+        bool due = request.deferredFrames > 0 ||
+                   (m_frame + static_cast<unsigned int>(request.phase)) % interval == 0;
+        if (!due) {
+            continue;
+        }
+
+        m_urgency[i] = std::max(0.01f, request.priority) * (1 + request.deferredFrames);
+        order.push_back(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return m_urgency[a] > m_urgency[b];
+    });
+}
+
+bool UpdateScheduler::HasTimeLeft() const {
+    if (m_frameBudget <= 0) {
+        return true;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - m_frameStart;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() < m_frameBudget;
+}
+
+void UpdateScheduler::EndFrame(int updated, int deferred) {
+    auto elapsed = std::chrono::steady_clock::now() - m_frameStart;
+    m_lastElapsed = static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+    m_lastUpdated = updated;
+    m_lastDeferred = deferred;
+}
+
+} // namespace GPUParticles
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Per-instance input to the update scheduler
+ */
+struct ScheduleRequest {
+    float priority;      // Relative importance (1 = normal)
+    float distance;      // Distance from the camera in world units
+    int phase;           // Round-robin offset, spreads instances sharing an interval
+    int deferredFrames;  // Frames the instance was due but skipped for budget
+
+    ScheduleRequest() : priority(1.0f), distance(0.0f), phase(0), deferredFrames(0) {}
+};
+
+/**
+ * @brief Time-sliced update scheduler with a per-frame time budget
+ *
+ * Distant and low-priority instances are updated every 2nd, 4th or 8th
+ * frame with the time they accumulated in between. Instances sharing an
+ * interval are offset by their phase so the cost is spread evenly across
+ * frames. Once the frame budget is spent the remaining due instances are
+ * deferred, lowest priority first; deferral raises their urgency so no
+ * instance starves.
+ */
+class UpdateScheduler {
+public:
+    UpdateScheduler();
+
+    /**
+     * @brief Set the simulation time allowed per frame
+     * @param microseconds Budget in microseconds (0 = unlimited)
+     */
+    void SetFrameBudget(int microseconds);
+    int GetFrameBudget() const { return m_frameBudget; }
+
+    /**
+     * @brief Distance up to which normal priority instances update every frame
+     *
+     * Each doubling of the distance doubles the update interval, up to 8.
+     */
+    void SetFullRateDistance(float distance);
+
+    /**
+     * @brief Update interval in frames (1, 2, 4 or 8)
+     */
+    int GetUpdateInterval(const ScheduleRequest& request) const;
+
+    /**
+     * @brief Start a frame and pick the instances due for an update
+     * @param requests One entry per instance
+     * @param order Output, indices of due instances, most urgent first
+     */
+    void BeginFrame(const std::vector<ScheduleRequest>& requests, std::vector<size_t>& order);
+
+    /**
+     * @brief True while the frame budget has time left
+     */
+    bool HasTimeLeft() const;
+
+    /**
+     * @brief Finish the frame and record statistics
+     */
+    void EndFrame(int updated, int deferred);
+
+    // Statistics from the last frame
+    int GetLastUpdated() const { return m_lastUpdated; }
+    int GetLastDeferred() const { return m_lastDeferred; }
+    int GetLastElapsedMicroseconds() const { return m_lastElapsed; }
+
+private:
+    int m_frameBudget;
+    float m_fullRateDistance;
+    unsigned int m_frame;
+    std::chrono::steady_clock::time_point m_frameStart;
+
+    // Scratch buffer reused between frames
+    std::vector<float> m_urgency;
+
+    int m_lastUpdated;
+    int m_lastDeferred;
+    int m_lastElapsed;
+};
+
+} // namespace GPUParticles
@@ -0,0 +1,125 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace GPUParticles {
+
+WorkerPool::WorkerPool()
+    : m_generation(0)
+    , m_activeWorkers(0)
+    , m_stopping(false)
+    , m_job(nullptr)
+    , m_jobCount(0)
+    , m_taskCount(0)
+    , m_nextTask(0)
+    , m_finishedTasks(0)
+{
+}
+
+WorkerPool::~WorkerPool() {
+    Shutdown();
+}
+
+void WorkerPool::Initialize(int threadCount) {
+    Shutdown();
+
+    m_stopping = false;
+    for (int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&WorkerPool::WorkerLoop, this);
+    }
+}
+
+void WorkerPool::Shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+void WorkerPool::ParallelFor(uint32_t count,
+                             uint32_t minPerTask,
+                             const std::function<void(uint32_t, uint32_t)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t maxTasks = static_cast<uint32_t>(m_threads.size()) + 1;
+    const uint32_t taskCount = std::min(maxTasks, std::max(1u, count / std::max(1u, minPerTask)));
+
+    if (taskCount <= 1) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_jobCount = count;
+        m_taskCount = taskCount;
+        m_nextTask = 0;
+        m_finishedTasks = 0;
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    // The calling thread works too
+    RunTasks();
+
+    // Wait for the last task, and for every worker to stop touching the
+    // job before it goes out of scope
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_finishedTasks == m_taskCount && m_activeWorkers == 0; });
+    m_job = nullptr;
+}
+
+void WorkerPool::RunTasks() {
+    for (;;) {
+        const uint32_t task = m_nextTask.fetch_add(1);
+        if (task >= m_taskCount) {
+            return;
+        }
+
+        // Even split; the first (count % tasks) ranges get one extra index
+        const uint32_t base = m_jobCount / m_taskCount;
+        const uint32_t extra = m_jobCount % m_taskCount;
+        const uint32_t begin = task * base + std::min(task, extra);
+        const uint32_t end = begin + base + (task < extra ? 1 : 0);
+
+        (*m_job)(begin, end);
+        m_finishedTasks.fetch_add(1);
+    }
+}
+
+void WorkerPool::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) {
+                return;
+            }
+            seenGeneration = m_generation;
+            if (!m_job) {
+                continue;
+            }
+            m_activeWorkers++;
+        }
+
+        RunTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_activeWorkers--;
+        }
+        m_done.notify_all();
+    }
+}
+
+} // namespace GPUParticles
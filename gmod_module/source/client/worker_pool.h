@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GPUParticles {
+
+/**
+ * @brief Small fixed set of threads for data-parallel loops
+ *
+ * ParallelFor splits an index range into contiguous tasks and runs them
+ * on the workers and the calling thread, returning when all are done.
+ * Tasks must only write to data owned by their own range.
+ */
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    /**
+     * @brief Start the worker threads
+     * @param threadCount Workers besides the calling thread (0 = run inline)
+     */
+    void Initialize(int threadCount);
+
+    /**
+     * @brief Stop and join all workers
+     */
+    void Shutdown();
+
+    int GetWorkerCount() const { return static_cast<int>(m_threads.size()); }
+
+    /**
+     * @brief Run fn(begin, end) over [0, count) in parallel
+     * @param minPerTask Smallest range worth handing to another thread
+     */
+    void ParallelFor(uint32_t count,
+                     uint32_t minPerTask,
+                     const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    uint64_t m_generation;
+    int m_activeWorkers;
+    bool m_stopping;
+
+    // Current job, valid while a ParallelFor call is running
+    const std::function<void(uint32_t, uint32_t)>* m_job;
+    uint32_t m_jobCount;
+    uint32_t m_taskCount;
+    std::atomic<uint32_t> m_nextTask;
+    std::atomic<uint32_t> m_finishedTasks;
+};
+
+} // namespace GPUParticles
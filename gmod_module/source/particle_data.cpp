@@ -91,6 +91,62 @@ float MinMaxCurve::Evaluate(float t, float randomValue) const {
     return value * multiplier;
 }
 
+namespace {
+
+// Lowest and highest keyframe value of a curve (0 if it has no keys)
+void GetKeyRange(const AnimationCurve& c, float& lo, float& hi) {
+    lo = hi = 0.0f;
+    for (size_t i = 0; i < c.keys.size(); ++i) {
+        lo = (i == 0) ? c.keys[i].value : std::min(lo, c.keys[i].value);
+        hi = (i == 0) ? c.keys[i].value : std::max(hi, c.keys[i].value);
+    }
+}
+
+// Range of Evaluate() before the multiplier is applied
+void GetUnscaledRange(const MinMaxCurve& c, float& lo, float& hi) {
+    switch (c.mode) {
+        case CurveMode::Curve:
+            GetKeyRange(c.curve, lo, hi);
+            return;
+
+        case CurveMode::RandomBetweenTwoConstants:
+            lo = std::min(c.constantMin, c.constantMax);
+            hi = std::max(c.constantMin, c.constantMax);
+            return;
+
+        case CurveMode::TwoCurves:
+        case CurveMode::RandomBetweenTwoCurves: {
+            float loMin, hiMin, loMax, hiMax;
+            GetKeyRange(c.curveMin, loMin, hiMin);
+            GetKeyRange(c.curveMax, loMax, hiMax);
+            lo = std::min(loMin, loMax);
+            hi = std::max(hiMin, hiMax);
+            return;
+        }
+
+        case CurveMode::Constant:
+        case CurveMode::TwoConstants:
+        default:
+            lo = hi = c.constant;
+            return;
+    }
+}
+
+} // namespace
+
+float MinMaxCurve::GetMaxValue() const {
+    // Evaluate() scales every mode; a negative multiplier swaps the ends
+    float lo, hi;
+    GetUnscaledRange(*this, lo, hi);
+    return std::max(lo * multiplier, hi * multiplier);
+}
+
+float MinMaxCurve::GetMinValue() const {
+    float lo, hi;
+    GetUnscaledRange(*this, lo, hi);
+    return std::min(lo * multiplier, hi * multiplier);
+}
+
 // ============================================================================
 // Gradient Implementation
 // ============================================================================
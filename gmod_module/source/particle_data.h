@@ -72,6 +72,10 @@ struct MinMaxCurve {
                     constantMax(0), multiplier(1.0f) {}
 
     float Evaluate(float t, float randomValue) const;
+
+    // Largest / smallest value the curve can produce over the whole lifetime
+    float GetMaxValue() const;
+    float GetMinValue() const;
 };
 
 // ============================================================================
@@ -382,12 +386,13 @@ struct RendererModule {
     float lengthScale;
     float normalDirection;
     int sortingOrder;
+    int hullVertices;  // Corners of the alpha-trimmed outline, 4-8 (0 = full quad)
 
     RendererModule() : renderMode(ParticleSystemRenderMode::Billboard),
                        sortMode(ParticleSystemSortMode::None),
                        minParticleSize(0), maxParticleSize(0.5f),
                        flip(false), lengthScale(2.0f), normalDirection(1.0f),
-                       sortingOrder(0) {}
+                       sortingOrder(0), hullVertices(0) {}
 };
 
 // ============================================================================
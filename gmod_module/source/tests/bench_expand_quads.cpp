@@ -0,0 +1,94 @@
+// CPU billboard expansion, SSE against scalar. ExpandQuads runs its SSE
+// path on whole groups of four and the scalar path on the rest, so calls
+// of three particles at a time time and check the scalar code in the
+// same build. Both must place every corner where ExpandCorner (the
+// shader's math) does.
+
+#include "test_common.h"
+#include "../client/render_packet.h"
+#include <cmath>
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+const uint32_t kParticleCount = 16384;
+const uint32_t kScalarChunk = 3;    // Below a full SSE group
+const float kTolerance = 2e-3f;     // World units, for centers up to 1000 and sizes up to 64
+
+// Calls of three never fill an SSE group; the setup each call repeats is
+// only the corner-to-UV table
+void ExpandScalar(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z,
+                  const std::vector<float>& size, const std::vector<float>& rotation,
+                  const std::vector<uint32_t>& color, const CameraData& camera, ParticleVertex* out) {
+    for (uint32_t i = 0; i < kParticleCount; i += kScalarChunk) {
+        const uint32_t count = std::min(kScalarChunk, kParticleCount - i);
+        RenderPacketBuilder::ExpandQuads(&x[i], &y[i], &z[i], &size[i], &rotation[i], &color[i], count, camera,
+                                         out + static_cast<size_t>(i) * 4);
+    }
+}
+
+bool Close(const Vector3f& a, const Vector3f& b) {
+    return std::fabs(a.x - b.x) <= kTolerance && std::fabs(a.y - b.y) <= kTolerance &&
+           std::fabs(a.z - b.z) <= kTolerance;
+}
+
+} // namespace
+
+int main() {
+    Test::Random random(38);
+    std::vector<float> x(kParticleCount), y(kParticleCount), z(kParticleCount);
+    std::vector<float> size(kParticleCount), rotation(kParticleCount);
+    std::vector<uint32_t> color(kParticleCount);
+    for (uint32_t i = 0; i < kParticleCount; ++i) {
+        x[i] = random.Range(-1000.0f, 1000.0f);
+        y[i] = random.Range(-1000.0f, 1000.0f);
+        z[i] = random.Range(-1000.0f, 1000.0f);
+        size[i] = random.Range(0.5f, 64.0f);
+        // Spin accumulates over a lifetime, well past one turn
+        rotation[i] = (i % 8 == 0) ? random.Range(-100.0f, 100.0f) : random.Range(-6.3f, 6.3f);
+        color[i] = random.Next();
+    }
+
+    // An oblique camera, so every axis component is in play
+    CameraData camera;
+    camera.right = Vector3f(0.6f, 0.8f, 0.0f);
+    camera.up = Vector3f(-0.48f, 0.36f, 0.8f);
+    camera.forward = Vector3f(0.64f, -0.48f, 0.6f);
+
+    std::vector<ParticleVertex> simd(kParticleCount * 4);
+    std::vector<ParticleVertex> scalar(kParticleCount * 4);
+
+    const double simdMicros = Test::TimeMicroseconds([&] {
+        RenderPacketBuilder::ExpandQuads(x.data(), y.data(), z.data(), size.data(), rotation.data(), color.data(),
+                                         kParticleCount, camera, simd.data());
+    }, 20);
+    const double scalarMicros = Test::TimeMicroseconds([&] {
+        ExpandScalar(x, y, z, size, rotation, color, camera, scalar.data());
+    }, 20);
+
+    const ParticleShape quad;
+    for (uint32_t i = 0; i < kParticleCount; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            const ParticleVertex& a = simd[i * 4 + c];
+            const ParticleVertex& b = scalar[i * 4 + c];
+            const Vector3f expected = RenderPacketBuilder::ExpandCorner(
+                Vector3f(x[i], y[i], z[i]), size[i], rotation[i], quad.corners[c].x, quad.corners[c].y, camera);
+
+            CHECK(Close(a.position, expected));
+            CHECK(Close(b.position, expected));
+            CHECK(a.color == color[i] && b.color == color[i]);
+            CHECK(a.sizeRot.x == b.sizeRot.x && a.sizeRot.y == b.sizeRot.y);
+            CHECK(a.corner.x == b.corner.x && a.corner.y == b.corner.y);
+        }
+    }
+
+    std::printf("ExpandQuads, %u rotated billboards (%s)\n", kParticleCount,
+                GPUPARTICLES_SSE ? "SSE build" : "no SSE in this build, both paths scalar");
+    std::printf("  sse     %6.1f ns/particle\n", simdMicros * 1000.0 / kParticleCount);
+    std::printf("  scalar  %6.1f ns/particle  (%.2fx)\n", scalarMicros * 1000.0 / kParticleCount,
+                scalarMicros / simdMicros);
+
+    return Test::Result("bench_expand_quads");
+}
@@ -0,0 +1,154 @@
+// Vertex throughput of the render packet builder, without a game client.
+// Builds billboards for a large synthetic instance in each vertex format,
+// reports bytes per particle and fill rate, and checks the written
+// vertices against the particles they came from.
+
+#include "test_common.h"
+#include "../client/render_packet.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+const uint32_t kParticleCount = 16384;   // One full 16-bit indexed draw of quads
+const int kRuns = 20;
+
+std::vector<Particle> MakeParticles(Test::Random& random) {
+    std::vector<Particle> particles(kParticleCount);
+    for (uint32_t i = 0; i < kParticleCount; ++i) {
+        Particle& p = particles[i];
+        p.position = Vector3(random.Range(-500.0f, 500.0f), random.Range(-500.0f, 500.0f), random.Range(0.0f, 800.0f));
+        p.velocity = Vector3(random.Range(-50.0f, 50.0f), random.Range(-50.0f, 50.0f), random.Range(0.0f, 200.0f));
+        p.color = Color(random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f), random.Range(0.0f, 1.0f));
+        p.size = random.Range(1.0f, 64.0f);
+        p.rotation = random.Range(-6.0f, 6.0f);
+        p.lifetime = 2.0f;
+        p.age = random.Range(0.0f, 2.0f);
+        p.alive = (i % 10) != 0;   // Pools always hold some dead slots
+    }
+    return particles;
+}
+
+CameraData MakeCamera() {
+    CameraData camera;
+    camera.position = Vector3f(-2000.0f, 0.0f, 400.0f);
+    camera.forward = Vector3f(1.0f, 0.0f, 0.0f);
+    camera.right = Vector3f(0.0f, -1.0f, 0.0f);
+    camera.up = Vector3f(0.0f, 0.0f, 1.0f);
+    return camera;
+}
+
+// Normal halves only, which is all FloatToHalf produces besides zero
+float HalfToFloat(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+    const uint32_t bits = exponent ? sign | ((exponent - 15 + 127) << 23) | (mantissa << 13) : sign;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Builds the instance kRuns times and prints the rate
+uint32_t Measure(const char* name,
+                 const ParticleView& view,
+                 const InstanceTransform& transform,
+                 const CameraData& camera,
+                 VertexFormat format,
+                 std::vector<uint8_t>& buffer) {
+    const uint32_t vertices = transform.shape.vertexCount;
+    buffer.assign(static_cast<size_t>(kParticleCount) * vertices * GetVertexStride(format), 0);
+
+    uint32_t written = 0;
+    const double micros = Test::TimeMicroseconds([&] {
+        written = RenderPacketBuilder::BuildInstance(view, transform, camera, format, buffer.data(), kParticleCount);
+    }, kRuns);
+
+    // Bytes per particle is what the vertex stream costs per draw; the fill
+    // rate is what the CPU sustains writing it
+    const uint32_t bytesPerParticle = vertices * GetVertexStride(format);
+    std::printf("  %-10s %6u particles  %3u bytes/particle  %6.1f ns/particle  %7.1f Mvertices/s  %7.1f MB/s\n",
+                name, written, bytesPerParticle, micros * 1000.0 / written, written * vertices / micros,
+                static_cast<double>(written) * bytesPerParticle / micros);
+    return written;
+}
+
+} // namespace
+
+int main() {
+    Test::Random random(34);
+    const std::vector<Particle> particles = MakeParticles(random);
+    const ParticleView view(particles);
+    const CameraData camera = MakeCamera();
+
+    InstanceTransform transform;
+    transform.position = Vector3f(100.0f, -200.0f, 50.0f);
+    transform.scale = 1.5f;
+    transform.tint = Color(1.0f, 0.5f, 0.25f, 1.0f);
+
+    uint32_t alive = 0;
+    for (const Particle& p : particles) {
+        alive += p.alive ? 1u : 0u;
+    }
+
+    std::printf("Render packet build, %u of %u slots alive\n", alive, kParticleCount);
+    std::vector<uint8_t> buffer;
+
+    // Standard vertices carry the particle center and the corner offset
+    const uint32_t written = Measure("standard", view, transform, camera, VertexFormat::Standard, buffer);
+    CHECK(written == alive);
+
+    const ParticleVertex* vertices = reinterpret_cast<const ParticleVertex*>(buffer.data());
+    const ParticleShape quad;
+    uint32_t k = 0;
+    for (const Particle& p : particles) {
+        if (!p.alive) {
+            continue;
+        }
+        const uint32_t color = PackParticleColor(p.color, transform.tint, transform.alphaScale, transform.blend);
+        for (uint32_t c = 0; c < quad.vertexCount; ++c) {
+            const ParticleVertex& v = vertices[k * quad.vertexCount + c];
+            CHECK(v.position.x == p.position.x + transform.position.x);
+            CHECK(v.position.y == p.position.y + transform.position.y);
+            CHECK(v.position.z == p.position.z + transform.position.z);
+            CHECK(v.color == color);
+            CHECK(v.sizeRot.x == p.size * transform.scale && v.sizeRot.y == p.rotation);
+            CHECK(v.corner.x == quad.corners[c].x && v.corner.y == quad.corners[c].y);
+        }
+        k++;
+    }
+
+    // Compact vertices quantize size, rotation and corner; they must decode
+    // to the standard values within half-float precision
+    std::vector<uint8_t> compactBuffer;
+    CHECK(Measure("compact", view, transform, camera, VertexFormat::Compact, compactBuffer) == alive);
+    CHECK(GetVertexStride(VertexFormat::Compact) * 4 == GetVertexStride(VertexFormat::Standard) * 3);
+
+    const CompactParticleVertex* compact = reinterpret_cast<const CompactParticleVertex*>(compactBuffer.data());
+    for (uint32_t i = 0; i < alive * quad.vertexCount; ++i) {
+        const ParticleVertex& standard = vertices[i];
+        const CompactParticleVertex& v = compact[i];
+        CHECK(v.position.x == standard.position.x && v.position.y == standard.position.y &&
+              v.position.z == standard.position.z);
+        CHECK(v.color == standard.color);
+        CHECK(std::fabs(HalfToFloat(v.size) - standard.sizeRot.x) <= standard.sizeRot.x / 1024.0f);
+        CHECK(std::fabs(HalfToFloat(v.rotation) - standard.sizeRot.y) <= std::fabs(standard.sizeRot.y) / 1024.0f);
+        CHECK(v.cornerX / CompactParticleVertex::kCornerScale == standard.corner.x);
+        CHECK(v.cornerY / CompactParticleVertex::kCornerScale == standard.corner.y);
+    }
+
+    // Every particle's fan indexes its own four corners
+    std::vector<uint16_t> indices(RenderPacketBuilder::GetIndicesPerParticle(4) * kParticleCount);
+    RenderPacketBuilder::BuildFanIndices(indices.data(), kParticleCount, 4);
+    for (uint32_t i = 0; i < kParticleCount; ++i) {
+        for (uint32_t j = 0; j < RenderPacketBuilder::GetIndicesPerParticle(4); ++j) {
+            const uint16_t index = indices[i * RenderPacketBuilder::GetIndicesPerParticle(4) + j];
+            CHECK(index >= i * 4 && index < i * 4 + 4);
+        }
+    }
+
+    return Test::Result("bench_render_packet");
+}
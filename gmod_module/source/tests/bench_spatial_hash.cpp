@@ -0,0 +1,143 @@
+// Spatial hash at 10k instances: radius and box queries after inserts,
+// moves and removals must return exactly what a brute-force scan finds.
+// Prints the query cost of the hash against the scan.
+
+#include "test_common.h"
+#include "../client/instance_spatial_hash.h"
+#include <algorithm>
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+const int kInstanceCount = 10000;
+const int kQueryCount = 500;
+const float kWorldExtent = 16000.0f;   // Map half-size in world units
+
+struct Query {
+    Vector3 center;
+    float radius;
+    Vector3 mins;
+    Vector3 maxs;
+};
+
+bool Alive(int id) {
+    return id % 7 != 0;   // Every seventh instance is removed
+}
+
+void BruteRadius(const std::vector<Vector3>& positions, const Query& query, std::vector<int>& out) {
+    out.clear();
+    const float radiusSq = query.radius * query.radius;
+    for (int id = 0; id < kInstanceCount; ++id) {
+        const Vector3& p = positions[id];
+        const float dx = p.x - query.center.x, dy = p.y - query.center.y, dz = p.z - query.center.z;
+        if (Alive(id) && dx * dx + dy * dy + dz * dz <= radiusSq) {
+            out.push_back(id);
+        }
+    }
+}
+
+void BruteBox(const std::vector<Vector3>& positions, const Query& query, std::vector<int>& out) {
+    out.clear();
+    for (int id = 0; id < kInstanceCount; ++id) {
+        const Vector3& p = positions[id];
+        if (Alive(id) && p.x >= query.mins.x && p.x <= query.maxs.x && p.y >= query.mins.y &&
+            p.y <= query.maxs.y && p.z >= query.mins.z && p.z <= query.maxs.z) {
+            out.push_back(id);
+        }
+    }
+}
+
+bool SameIds(std::vector<int> a, std::vector<int> b) {
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+} // namespace
+
+int main() {
+    Test::Random random(31);
+    InstanceSpatialHash hash;
+
+    std::vector<Vector3> positions(kInstanceCount);
+    for (int id = 0; id < kInstanceCount; ++id) {
+        positions[id] = Vector3(random.Range(-kWorldExtent, kWorldExtent), random.Range(-kWorldExtent, kWorldExtent),
+                                random.Range(-kWorldExtent, kWorldExtent) * 0.125f);
+        hash.Insert(id, positions[id]);
+    }
+
+    // Moves within and across cells, then removals
+    for (int id = 0; id < kInstanceCount; id += 3) {
+        positions[id].x += random.Range(-1500.0f, 1500.0f);
+        positions[id].y += random.Range(-20.0f, 20.0f);
+        hash.Move(id, positions[id]);
+    }
+    for (int id = 0; id < kInstanceCount; ++id) {
+        if (!Alive(id)) {
+            hash.Remove(id);
+        }
+    }
+    CHECK(static_cast<int>(hash.GetCount()) == kInstanceCount - (kInstanceCount + 6) / 7);
+
+    // Mostly local queries (explosions, kill volumes) and a few map-wide ones
+    std::vector<Query> queries(kQueryCount);
+    for (int i = 0; i < kQueryCount; ++i) {
+        Query& query = queries[i];
+        query.center = Vector3(random.Range(-kWorldExtent, kWorldExtent), random.Range(-kWorldExtent, kWorldExtent), 0.0f);
+        query.radius = (i % 50 == 0) ? 3.0f * kWorldExtent : random.Range(0.0f, 2000.0f);
+        const float halfX = random.Range(0.0f, 2000.0f);
+        const float halfY = (i % 50 == 0) ? 2.0f * kWorldExtent : random.Range(0.0f, 2000.0f);
+        query.mins = Vector3(query.center.x - halfX, query.center.y - halfY, -500.0f);
+        query.maxs = Vector3(query.center.x + halfX, query.center.y + halfY, 500.0f);
+    }
+
+    std::vector<int> found;
+    std::vector<int> expected;
+    for (const Query& query : queries) {
+        hash.QueryRadius(query.center, query.radius, found);
+        BruteRadius(positions, query, expected);
+        CHECK(SameIds(found, expected));
+
+        hash.QueryBox(query.mins, query.maxs, found);
+        BruteBox(positions, query, expected);
+        CHECK(SameIds(found, expected));
+    }
+
+    // Query cost, hash against scan
+    size_t sink = 0;
+    const double hashRadius = Test::TimeMicroseconds([&] {
+        for (const Query& query : queries) {
+            hash.QueryRadius(query.center, query.radius, found);
+            sink += found.size();
+        }
+    });
+    const double bruteRadius = Test::TimeMicroseconds([&] {
+        for (const Query& query : queries) {
+            BruteRadius(positions, query, expected);
+            sink += expected.size();
+        }
+    });
+    const double hashBox = Test::TimeMicroseconds([&] {
+        for (const Query& query : queries) {
+            hash.QueryBox(query.mins, query.maxs, found);
+            sink += found.size();
+        }
+    });
+    const double bruteBox = Test::TimeMicroseconds([&] {
+        for (const Query& query : queries) {
+            BruteBox(positions, query, expected);
+            sink += expected.size();
+        }
+    });
+
+    std::printf("%zu instances in %zu cells of %.0f units, %d queries (%zu hits)\n",
+                hash.GetCount(), hash.GetCellCount(), hash.GetCellSize(), kQueryCount, sink);
+    std::printf("  radius: hash %8.1f us/query, scan %8.1f us/query\n",
+                hashRadius / kQueryCount, bruteRadius / kQueryCount);
+    std::printf("  box:    hash %8.1f us/query, scan %8.1f us/query\n",
+                hashBox / kQueryCount, bruteBox / kQueryCount);
+
+    return Test::Result("bench_spatial_hash");
+}
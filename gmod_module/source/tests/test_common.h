@@ -0,0 +1,73 @@
+#pragma once
+
+// Minimal checks for the headless tests and benchmarks (BUILD_TESTS).
+// A failed CHECK prints the expression and marks the run as failed; the
+// test keeps going so one run reports every broken case.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace GPUParticles {
+namespace Test {
+
+inline int& FailureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+// Exit code for main()
+inline int Result(const char* name) {
+    if (FailureCount() > 0) {
+        std::printf("%s: %d check(s) failed\n", name, FailureCount());
+        return 1;
+    }
+    std::printf("%s: passed\n", name);
+    return 0;
+}
+
+// Deterministic xorshift, so failures reproduce
+class Random {
+public:
+    explicit Random(uint32_t seed) : m_state(seed ? seed : 1u) {}
+
+    uint32_t Next() {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    // Uniform in [lo, hi)
+    float Range(float lo, float hi) {
+        return lo + (hi - lo) * static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint32_t m_state;
+};
+
+// Wall time of fn() in microseconds, best of a few runs
+template <typename Fn>
+double TimeMicroseconds(Fn&& fn, int runs = 5) {
+    double best = 0.0;
+    for (int run = 0; run < runs; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+        const double elapsed = std::chrono::duration<double, std::micro>(end - start).count();
+        best = (run == 0) ? elapsed : (elapsed < best ? elapsed : best);
+    }
+    return best;
+}
+
+} // namespace Test
+} // namespace GPUParticles
+
+#define CHECK(expr)                                                              \
+    do {                                                                         \
+        if (!(expr)) {                                                           \
+            std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #expr); \
+            ::GPUParticles::Test::FailureCount()++;                              \
+        }                                                                        \
+    } while (0)
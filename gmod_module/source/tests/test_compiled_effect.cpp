@@ -0,0 +1,622 @@
+// Headless test of compiled effects (.gpartc)
+//
+// Compiles the basic test effect and an effect with every module enabled,
+// loads both back from aligned and misaligned buffers and compares them
+// field by field with what was compiled. Then corrupts the image in the
+// ways a bad or stale file would be and checks that CompiledEffectView
+// rejects it instead of reading outside the buffer.
+//
+// Usage: test_compiled_effect <test_basic.gpart>
+
+#include "test_common.h"
+#include "../client/compiled_effect.h"
+#include "../client/particle_loader.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+// ============================================================================
+// Field-by-field comparison
+// ============================================================================
+
+#define CHECK_FIELD(a, b, field) CHECK((a).field == (b).field)
+
+void CheckVector(const Vector3& a, const Vector3& b) {
+    CHECK(a.x == b.x && a.y == b.y && a.z == b.z);
+}
+
+void CheckColor(const Color& a, const Color& b) {
+    CHECK(a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a);
+}
+
+void CheckKeys(const AnimationCurve& a, const AnimationCurve& b) {
+    CHECK(a.keys.size() == b.keys.size());
+    for (size_t i = 0; i < a.keys.size() && i < b.keys.size(); ++i) {
+        CHECK_FIELD(a.keys[i], b.keys[i], time);
+        CHECK_FIELD(a.keys[i], b.keys[i], value);
+        CHECK_FIELD(a.keys[i], b.keys[i], inTangent);
+        CHECK_FIELD(a.keys[i], b.keys[i], outTangent);
+    }
+}
+
+void CheckCurve(const MinMaxCurve& a, const MinMaxCurve& b) {
+    CHECK_FIELD(a, b, mode);
+    CHECK_FIELD(a, b, constant);
+    CHECK_FIELD(a, b, constantMin);
+    CHECK_FIELD(a, b, constantMax);
+    CHECK_FIELD(a, b, multiplier);
+    CheckKeys(a.curve, b.curve);
+    CheckKeys(a.curveMin, b.curveMin);
+    CheckKeys(a.curveMax, b.curveMax);
+}
+
+void CheckGradient(const Gradient& a, const Gradient& b) {
+    CHECK(a.colorKeys.size() == b.colorKeys.size());
+    for (size_t i = 0; i < a.colorKeys.size() && i < b.colorKeys.size(); ++i) {
+        CheckColor(a.colorKeys[i].color, b.colorKeys[i].color);
+        CHECK_FIELD(a.colorKeys[i], b.colorKeys[i], time);
+    }
+    CHECK(a.alphaKeys.size() == b.alphaKeys.size());
+    for (size_t i = 0; i < a.alphaKeys.size() && i < b.alphaKeys.size(); ++i) {
+        CHECK_FIELD(a.alphaKeys[i], b.alphaKeys[i], alpha);
+        CHECK_FIELD(a.alphaKeys[i], b.alphaKeys[i], time);
+    }
+}
+
+void CheckMain(const MainModule& a, const MainModule& b) {
+    CHECK_FIELD(a, b, duration);
+    CHECK_FIELD(a, b, looping);
+    CHECK_FIELD(a, b, prewarm);
+    CheckCurve(a.startDelay, b.startDelay);
+    CheckCurve(a.startLifetime, b.startLifetime);
+    CheckCurve(a.startSpeed, b.startSpeed);
+    CheckCurve(a.startSize, b.startSize);
+    CHECK_FIELD(a, b, startSize3D);
+    CheckCurve(a.startSizeX, b.startSizeX);
+    CheckCurve(a.startSizeY, b.startSizeY);
+    CheckCurve(a.startSizeZ, b.startSizeZ);
+    CheckCurve(a.startRotation, b.startRotation);
+    CHECK_FIELD(a, b, startRotation3D);
+    CheckCurve(a.startRotationX, b.startRotationX);
+    CheckCurve(a.startRotationY, b.startRotationY);
+    CheckCurve(a.startRotationZ, b.startRotationZ);
+    CheckColor(a.startColor, b.startColor);
+    CheckCurve(a.gravityModifier, b.gravityModifier);
+    CHECK_FIELD(a, b, simulationSpace);
+    CHECK_FIELD(a, b, simulationSpeed);
+    CHECK_FIELD(a, b, playOnAwake);
+    CHECK_FIELD(a, b, maxParticles);
+}
+
+void CheckRenderer(const RendererModule& a, const RendererModule& b) {
+    CHECK_FIELD(a, b, renderMode);
+    CHECK_FIELD(a, b, sortMode);
+    CHECK_FIELD(a, b, minParticleSize);
+    CHECK_FIELD(a, b, maxParticleSize);
+    CHECK_FIELD(a, b, material);
+    CHECK_FIELD(a, b, texture);
+    CheckVector(a.pivot, b.pivot);
+    CHECK_FIELD(a, b, flip);
+    CheckVector(a.velocityScale, b.velocityScale);
+    CHECK_FIELD(a, b, lengthScale);
+    CHECK_FIELD(a, b, normalDirection);
+    CHECK_FIELD(a, b, sortingOrder);
+    CHECK_FIELD(a, b, hullVertices);
+}
+
+// Disabled modules are not stored and load as their defaults, so only
+// enabled ones are compared past the flag
+void CheckModules(const ParticleSystemData& a, const ParticleSystemData& b) {
+    CHECK_FIELD(a, b, emission.enabled);
+    if (a.emission.enabled && b.emission.enabled) {
+        CheckCurve(a.emission.rateOverTime, b.emission.rateOverTime);
+        CheckCurve(a.emission.rateOverDistance, b.emission.rateOverDistance);
+        CHECK(a.emission.bursts.size() == b.emission.bursts.size());
+        for (size_t i = 0; i < a.emission.bursts.size() && i < b.emission.bursts.size(); ++i) {
+            const Burst& x = a.emission.bursts[i];
+            const Burst& y = b.emission.bursts[i];
+            CHECK(x.time == y.time && x.minCount == y.minCount && x.maxCount == y.maxCount &&
+                  x.cycles == y.cycles && x.repeatInterval == y.repeatInterval);
+        }
+    }
+
+    CHECK_FIELD(a, b, shape.enabled);
+    if (a.shape.enabled && b.shape.enabled) {
+        CHECK_FIELD(a, b, shape.shapeType);
+        CHECK_FIELD(a, b, shape.angle);
+        CHECK_FIELD(a, b, shape.radius);
+        CHECK_FIELD(a, b, shape.radiusThickness);
+        CHECK_FIELD(a, b, shape.arc);
+        CheckVector(a.shape.boxScale, b.shape.boxScale);
+        CheckVector(a.shape.position, b.shape.position);
+        CheckVector(a.shape.rotation, b.shape.rotation);
+        CheckVector(a.shape.scale, b.shape.scale);
+        CHECK_FIELD(a, b, shape.alignToDirection);
+        CHECK_FIELD(a, b, shape.randomDirectionAmount);
+        CHECK_FIELD(a, b, shape.sphericalDirectionAmount);
+        CHECK_FIELD(a, b, shape.arcMode);
+    }
+
+    CHECK_FIELD(a, b, velocityOverLifetime.enabled);
+    if (a.velocityOverLifetime.enabled && b.velocityOverLifetime.enabled) {
+        CheckCurve(a.velocityOverLifetime.x, b.velocityOverLifetime.x);
+        CheckCurve(a.velocityOverLifetime.y, b.velocityOverLifetime.y);
+        CheckCurve(a.velocityOverLifetime.z, b.velocityOverLifetime.z);
+        CHECK_FIELD(a, b, velocityOverLifetime.space);
+    }
+
+    CHECK_FIELD(a, b, limitVelocityOverLifetime.enabled);
+    if (a.limitVelocityOverLifetime.enabled && b.limitVelocityOverLifetime.enabled) {
+        CheckCurve(a.limitVelocityOverLifetime.limit, b.limitVelocityOverLifetime.limit);
+        CHECK_FIELD(a, b, limitVelocityOverLifetime.dampen);
+        CHECK_FIELD(a, b, limitVelocityOverLifetime.separateAxes);
+        CheckCurve(a.limitVelocityOverLifetime.limitX, b.limitVelocityOverLifetime.limitX);
+        CheckCurve(a.limitVelocityOverLifetime.limitY, b.limitVelocityOverLifetime.limitY);
+        CheckCurve(a.limitVelocityOverLifetime.limitZ, b.limitVelocityOverLifetime.limitZ);
+    }
+
+    CHECK_FIELD(a, b, forceOverLifetime.enabled);
+    if (a.forceOverLifetime.enabled && b.forceOverLifetime.enabled) {
+        CheckCurve(a.forceOverLifetime.x, b.forceOverLifetime.x);
+        CheckCurve(a.forceOverLifetime.y, b.forceOverLifetime.y);
+        CheckCurve(a.forceOverLifetime.z, b.forceOverLifetime.z);
+        CHECK_FIELD(a, b, forceOverLifetime.space);
+        CHECK_FIELD(a, b, forceOverLifetime.randomized);
+    }
+
+    CHECK_FIELD(a, b, colorOverLifetime.enabled);
+    if (a.colorOverLifetime.enabled && b.colorOverLifetime.enabled) {
+        CheckGradient(a.colorOverLifetime.gradient, b.colorOverLifetime.gradient);
+    }
+
+    CHECK_FIELD(a, b, sizeOverLifetime.enabled);
+    if (a.sizeOverLifetime.enabled && b.sizeOverLifetime.enabled) {
+        CheckCurve(a.sizeOverLifetime.size, b.sizeOverLifetime.size);
+        CHECK_FIELD(a, b, sizeOverLifetime.separateAxes);
+        CheckCurve(a.sizeOverLifetime.x, b.sizeOverLifetime.x);
+        CheckCurve(a.sizeOverLifetime.y, b.sizeOverLifetime.y);
+        CheckCurve(a.sizeOverLifetime.z, b.sizeOverLifetime.z);
+    }
+
+    CHECK_FIELD(a, b, rotationOverLifetime.enabled);
+    if (a.rotationOverLifetime.enabled && b.rotationOverLifetime.enabled) {
+        CheckCurve(a.rotationOverLifetime.x, b.rotationOverLifetime.x);
+        CheckCurve(a.rotationOverLifetime.y, b.rotationOverLifetime.y);
+        CheckCurve(a.rotationOverLifetime.z, b.rotationOverLifetime.z);
+        CHECK_FIELD(a, b, rotationOverLifetime.separateAxes);
+    }
+
+    CHECK_FIELD(a, b, noise.enabled);
+    if (a.noise.enabled && b.noise.enabled) {
+        CheckCurve(a.noise.strength, b.noise.strength);
+        CHECK_FIELD(a, b, noise.frequency);
+        CHECK_FIELD(a, b, noise.scrollSpeed);
+        CHECK_FIELD(a, b, noise.damping);
+        CHECK_FIELD(a, b, noise.octaves);
+        CHECK_FIELD(a, b, noise.octaveMultiplier);
+        CHECK_FIELD(a, b, noise.octaveScale);
+        CHECK_FIELD(a, b, noise.quality);
+        CHECK_FIELD(a, b, noise.separateAxes);
+        CheckCurve(a.noise.strengthX, b.noise.strengthX);
+        CheckCurve(a.noise.strengthY, b.noise.strengthY);
+        CheckCurve(a.noise.strengthZ, b.noise.strengthZ);
+    }
+
+    CHECK_FIELD(a, b, collision.enabled);
+    if (a.collision.enabled && b.collision.enabled) {
+        CHECK_FIELD(a, b, collision.type);
+        CHECK_FIELD(a, b, collision.mode);
+        CheckCurve(a.collision.dampen, b.collision.dampen);
+        CheckCurve(a.collision.bounce, b.collision.bounce);
+        CheckCurve(a.collision.lifetimeLoss, b.collision.lifetimeLoss);
+        CHECK_FIELD(a, b, collision.minKillSpeed);
+        CHECK_FIELD(a, b, collision.maxKillSpeed);
+        CHECK_FIELD(a, b, collision.radiusScale);
+        CHECK_FIELD(a, b, collision.collidesWithDynamic);
+        CHECK_FIELD(a, b, collision.maxCollisionShapes);
+    }
+
+    CHECK_FIELD(a, b, textureSheetAnimation.enabled);
+    if (a.textureSheetAnimation.enabled && b.textureSheetAnimation.enabled) {
+        CHECK_FIELD(a, b, textureSheetAnimation.numTilesX);
+        CHECK_FIELD(a, b, textureSheetAnimation.numTilesY);
+        CHECK_FIELD(a, b, textureSheetAnimation.animationType);
+        CHECK_FIELD(a, b, textureSheetAnimation.mode);
+        CheckCurve(a.textureSheetAnimation.frameOverTime, b.textureSheetAnimation.frameOverTime);
+        CheckCurve(a.textureSheetAnimation.startFrame, b.textureSheetAnimation.startFrame);
+        CHECK_FIELD(a, b, textureSheetAnimation.cycleCount);
+        CHECK_FIELD(a, b, textureSheetAnimation.rowIndex);
+    }
+}
+
+void CheckSystem(const ParticleSystemData& a, const ParticleSystemData& b) {
+    CHECK_FIELD(a, b, name);
+    CHECK_FIELD(a, b, version);
+    CheckMain(a.main, b.main);
+    CheckModules(a, b);
+    CheckRenderer(a.renderer, b.renderer);
+    CHECK(a.subEmitters.size() == b.subEmitters.size());
+    for (size_t i = 0; i < a.subEmitters.size() && i < b.subEmitters.size(); ++i) {
+        CHECK_FIELD(a.subEmitters[i], b.subEmitters[i], type);
+        CHECK_FIELD(a.subEmitters[i], b.subEmitters[i], subEmitterName);
+    }
+}
+
+// ============================================================================
+// Effects
+// ============================================================================
+
+AnimationCurve MakeKeys(float base, int count) {
+    AnimationCurve curve;
+    for (int i = 0; i < count; ++i) {
+        Keyframe key;
+        key.time = static_cast<float>(i) / count;
+        key.value = base + i;
+        key.inTangent = -0.5f * i;
+        key.outTangent = 0.25f * i;
+        curve.keys.push_back(key);
+    }
+    return curve;
+}
+
+MinMaxCurve MakeCurve(float base) {
+    MinMaxCurve curve;
+    curve.mode = CurveMode::TwoCurves;
+    curve.constant = base;
+    curve.constantMin = base - 1.0f;
+    curve.constantMax = base + 1.0f;
+    curve.multiplier = 1.5f;
+    curve.curve = MakeKeys(base, 3);
+    curve.curveMin = MakeKeys(base - 2.0f, 2);
+    curve.curveMax = MakeKeys(base + 2.0f, 4);
+    return curve;
+}
+
+// Non-default values everywhere, so a field that is dropped or swapped shows
+ParticleSystemData MakeFullEffect() {
+    ParticleSystemData data;
+    data.name = "every_module";
+    data.version = "2.5";
+
+    MainModule& main = data.main;
+    main.duration = 3.5f;
+    main.looping = false;
+    main.prewarm = true;
+    main.startDelay = MakeCurve(0.1f);
+    main.startLifetime = MakeCurve(2.0f);
+    main.startSpeed = MakeCurve(4.0f);
+    main.startSize = MakeCurve(0.3f);
+    main.startSize3D = true;
+    main.startSizeX = MakeCurve(1.1f);
+    main.startSizeY = MakeCurve(1.2f);
+    main.startSizeZ = MakeCurve(1.3f);
+    main.startRotation = MakeCurve(0.7f);
+    main.startRotation3D = true;
+    main.startRotationX = MakeCurve(0.1f);
+    main.startRotationY = MakeCurve(0.2f);
+    main.startRotationZ = MakeCurve(0.3f);
+    main.startColor = Color(0.9f, 0.5f, 0.25f, 0.75f);
+    main.gravityModifier = MakeCurve(-0.4f);
+    main.simulationSpace = ParticleSystemSimulationSpace::World;
+    main.simulationSpeed = 1.25f;
+    main.playOnAwake = false;
+    main.maxParticles = 777;
+
+    data.emission.enabled = true;
+    data.emission.rateOverTime = MakeCurve(50.0f);
+    data.emission.rateOverDistance = MakeCurve(2.0f);
+    Burst burst;
+    burst.time = 0.5f;
+    burst.minCount = 10;
+    burst.maxCount = 20;
+    burst.cycles = 3;
+    burst.repeatInterval = 0.25f;
+    data.emission.bursts.push_back(burst);
+    burst.time = 1.5f;
+    burst.minCount = 5;
+    data.emission.bursts.push_back(burst);
+
+    ShapeModule& shape = data.shape;
+    shape.enabled = true;
+    shape.shapeType = ParticleSystemShapeType::Box;
+    shape.angle = 12.0f;
+    shape.radius = 3.0f;
+    shape.radiusThickness = 0.5f;
+    shape.arc = 270.0f;
+    shape.boxScale = Vector3(1, 2, 3);
+    shape.position = Vector3(4, 5, 6);
+    shape.rotation = Vector3(7, 8, 9);
+    shape.scale = Vector3(0.5f, 0.25f, 2.0f);
+    shape.alignToDirection = true;
+    shape.randomDirectionAmount = 0.3f;
+    shape.sphericalDirectionAmount = 0.6f;
+    shape.arcMode = ParticleSystemShapeMultiModeValue::Loop;
+
+    data.velocityOverLifetime.enabled = true;
+    data.velocityOverLifetime.x = MakeCurve(1.0f);
+    data.velocityOverLifetime.y = MakeCurve(2.0f);
+    data.velocityOverLifetime.z = MakeCurve(3.0f);
+    data.velocityOverLifetime.space = ParticleSystemSimulationSpace::World;
+
+    data.limitVelocityOverLifetime.enabled = true;
+    data.limitVelocityOverLifetime.limit = MakeCurve(8.0f);
+    data.limitVelocityOverLifetime.dampen = 0.35f;
+    data.limitVelocityOverLifetime.separateAxes = true;
+    data.limitVelocityOverLifetime.limitX = MakeCurve(4.0f);
+    data.limitVelocityOverLifetime.limitY = MakeCurve(5.0f);
+    data.limitVelocityOverLifetime.limitZ = MakeCurve(6.0f);
+
+    data.forceOverLifetime.enabled = true;
+    data.forceOverLifetime.x = MakeCurve(-1.0f);
+    data.forceOverLifetime.y = MakeCurve(-2.0f);
+    data.forceOverLifetime.z = MakeCurve(-3.0f);
+    data.forceOverLifetime.space = ParticleSystemSimulationSpace::World;
+    data.forceOverLifetime.randomized = true;
+
+    data.colorOverLifetime.enabled = true;
+    for (int i = 0; i < 3; ++i) {
+        GradientColorKey color;
+        color.color = Color(0.1f * i, 0.2f * i, 0.3f * i, 1.0f);
+        color.time = 0.5f * i;
+        data.colorOverLifetime.gradient.colorKeys.push_back(color);
+        GradientAlphaKey alpha;
+        alpha.alpha = 1.0f - 0.4f * i;
+        alpha.time = 0.5f * i;
+        data.colorOverLifetime.gradient.alphaKeys.push_back(alpha);
+    }
+
+    data.sizeOverLifetime.enabled = true;
+    data.sizeOverLifetime.size = MakeCurve(1.0f);
+    data.sizeOverLifetime.separateAxes = true;
+    data.sizeOverLifetime.x = MakeCurve(0.5f);
+    data.sizeOverLifetime.y = MakeCurve(0.6f);
+    data.sizeOverLifetime.z = MakeCurve(0.7f);
+
+    data.rotationOverLifetime.enabled = true;
+    data.rotationOverLifetime.x = MakeCurve(0.2f);
+    data.rotationOverLifetime.y = MakeCurve(0.4f);
+    data.rotationOverLifetime.z = MakeCurve(0.8f);
+    data.rotationOverLifetime.separateAxes = true;
+
+    NoiseModule& noise = data.noise;
+    noise.enabled = true;
+    noise.strength = MakeCurve(2.0f);
+    noise.frequency = 0.75f;
+    noise.scrollSpeed = 1.5f;
+    noise.damping = false;
+    noise.octaves = 3;
+    noise.octaveMultiplier = 0.4f;
+    noise.octaveScale = 2.5f;
+    noise.quality = 1;
+    noise.separateAxes = true;
+    noise.strengthX = MakeCurve(1.0f);
+    noise.strengthY = MakeCurve(2.0f);
+    noise.strengthZ = MakeCurve(3.0f);
+
+    CollisionModule& collision = data.collision;
+    collision.enabled = true;
+    collision.type = ParticleSystemCollisionType::World;
+    collision.mode = ParticleSystemCollisionMode::Collision2D;
+    collision.dampen = MakeCurve(0.2f);
+    collision.bounce = MakeCurve(0.8f);
+    collision.lifetimeLoss = MakeCurve(0.1f);
+    collision.minKillSpeed = 0.5f;
+    collision.maxKillSpeed = 500.0f;
+    collision.radiusScale = 0.9f;
+    collision.collidesWithDynamic = false;
+    collision.maxCollisionShapes = 64;
+
+    TextureSheetAnimationModule& sheet = data.textureSheetAnimation;
+    sheet.enabled = true;
+    sheet.numTilesX = 4;
+    sheet.numTilesY = 2;
+    sheet.animationType = ParticleSystemAnimationType::SingleRow;
+    sheet.mode = ParticleSystemAnimationMode::Sprites;
+    sheet.frameOverTime = MakeCurve(0.0f);
+    sheet.startFrame = MakeCurve(1.0f);
+    sheet.cycleCount = 2;
+    sheet.rowIndex = 1;
+
+    RendererModule& renderer = data.renderer;
+    renderer.renderMode = ParticleSystemRenderMode::Stretch;
+    renderer.sortMode = ParticleSystemSortMode::YoungestInFront;
+    renderer.minParticleSize = 0.01f;
+    renderer.maxParticleSize = 0.25f;
+    renderer.material = "effects/full_material";
+    renderer.texture = "particles/full.png";
+    renderer.pivot = Vector3(0.1f, 0.2f, 0.3f);
+    renderer.flip = true;
+    renderer.velocityScale = Vector3(0.5f, 0.5f, 1.0f);
+    renderer.lengthScale = 3.0f;
+    renderer.normalDirection = 0.5f;
+    renderer.sortingOrder = -2;
+    renderer.hullVertices = 6;
+
+    SubEmitter sub;
+    sub.type = ParticleSystemSubEmitterType::Death;
+    sub.subEmitterName = "sparks";
+    data.subEmitters.push_back(sub);
+    sub.type = ParticleSystemSubEmitterType::Birth;
+    sub.subEmitterName = "smoke_trail";
+    data.subEmitters.push_back(sub);
+    return data;
+}
+
+// Aligned copy of a file image, which Open needs
+std::vector<uint32_t> AlignedCopy(const std::vector<uint8_t>& image) {
+    std::vector<uint32_t> words((image.size() + 3) / 4);
+    std::memcpy(words.data(), image.data(), image.size());
+    return words;
+}
+
+// Compile, then load through every path the module takes
+void CheckRoundTrip(const char* name, const ParticleSystemData& source) {
+    const std::vector<uint8_t> image = CompiledEffect::Compile(source);
+    CHECK(CompiledEffect::IsCompiled(image.data(), image.size()));
+
+    // Aligned: used in place
+    const std::vector<uint32_t> aligned = AlignedCopy(image);
+    ParticleLoader loader;
+    std::unique_ptr<ParticleSystemData> loaded = loader.LoadCompiled(aligned.data(), image.size());
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CheckSystem(source, *loaded);
+    }
+
+    // Misaligned, as a Lua string can be: the view refuses it and the
+    // loader copies it first
+    std::vector<uint32_t> shifted(aligned.size() + 1);
+    const uint8_t* misaligned = reinterpret_cast<const uint8_t*>(shifted.data()) + 1;
+    std::memcpy(const_cast<uint8_t*>(misaligned), image.data(), image.size());
+
+    CompiledEffectView view;
+    std::string error;
+    CHECK(!view.Open(misaligned, image.size(), error));
+
+    loaded = loader.LoadCompiled(misaligned, image.size());
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CheckSystem(source, *loaded);
+    }
+
+    loaded = loader.LoadFromString(std::string(reinterpret_cast<const char*>(image.data()), image.size()));
+    CHECK(loaded != nullptr);
+    if (loaded) {
+        CheckSystem(source, *loaded);
+    }
+
+    std::printf("%s: %zu bytes compiled\n", name, image.size());
+}
+
+// ============================================================================
+// Rejection
+// ============================================================================
+
+// Open a corrupted copy of the image; it must fail with the expected error
+template <typename Corrupt>
+void CheckRejected(const char* what, const std::vector<uint8_t>& image, const char* expected, Corrupt corrupt) {
+    std::vector<uint32_t> words = AlignedCopy(image);
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(words.data());
+    size_t size = image.size();
+    corrupt(*reinterpret_cast<CompiledEffectHeader*>(bytes), bytes, size);
+
+    CompiledEffectView view;
+    std::string error;
+    const bool opened = view.Open(bytes, size, error);
+    if (opened || error.find(expected) == std::string::npos) {
+        std::printf("%s: opened=%d, error \"%s\", expected \"%s\"\n", what, opened ? 1 : 0, error.c_str(), expected);
+    }
+    CHECK(!opened);
+    CHECK(error.find(expected) != std::string::npos);
+}
+
+// Records are const through the view; the buffer under it is a copy
+template <typename Record>
+Record& Mutable(const Record& record) {
+    return const_cast<Record&>(record);
+}
+
+// Opens fine, but a record range leaves its table; ToSystemData must fail
+template <typename Corrupt>
+void CheckRecordRejected(const char* what, const std::vector<uint8_t>& image, Corrupt corrupt) {
+    const std::vector<uint32_t> words = AlignedCopy(image);
+
+    CompiledEffectView view;
+    std::string error;
+    CHECK(view.Open(words.data(), image.size(), error));
+    corrupt(view.GetHeader(), view);
+
+    error.clear();
+    const bool converted = view.ToSystemData(error) != nullptr;
+    if (converted || error.empty()) {
+        std::printf("%s: converted=%d, error \"%s\"\n", what, converted ? 1 : 0, error.c_str());
+    }
+    CHECK(!converted);
+    CHECK(!error.empty());
+}
+
+void CheckRejection(const ParticleSystemData& source) {
+    const std::vector<uint8_t> image = CompiledEffect::Compile(source);
+
+    CheckRejected("truncated", image, "truncated", [](CompiledEffectHeader&, uint8_t*, size_t& size) {
+        size -= 4;
+    });
+    CheckRejected("header only", image, "not a compiled effect", [](CompiledEffectHeader&, uint8_t*, size_t& size) {
+        size = sizeof(CompiledEffectHeader) - 1;
+    });
+    CheckRejected("version", image, "version", [](CompiledEffectHeader& header, uint8_t*, size_t&) {
+        header.version = CompiledEffect::kVersion + 1;
+    });
+    CheckRejected("table past fileSize", image, "out of bounds", [](CompiledEffectHeader& header, uint8_t*, size_t&) {
+        header.keyframes.count += 1;
+        header.keyframes.offset = header.fileSize - header.keyframes.count * sizeof(Keyframe) + 4;
+    });
+    CheckRejected("huge table", image, "out of bounds", [](CompiledEffectHeader& header, uint8_t*, size_t&) {
+        header.bursts.count = 0x40000000u;
+    });
+    CheckRejected("module bytes", image, "module mask", [](CompiledEffectHeader& header, uint8_t*, size_t&) {
+        header.modules.count -= 4;
+    });
+    CheckRejected("module mask", image, "module mask", [](CompiledEffectHeader& header, uint8_t*, size_t&) {
+        header.moduleMask &= ~static_cast<uint32_t>(kCompiledNoise);
+    });
+    CheckRejected("string table", image, "not terminated", [](CompiledEffectHeader& header, uint8_t* bytes, size_t&) {
+        bytes[header.strings.offset + header.strings.count - 1] = 'x';
+    });
+
+    // Curve keys of the main module, emission bursts and gradient keys
+    CheckRecordRejected("curve keys", image, [](const CompiledEffectHeader& header, const CompiledEffectView& view) {
+        CompiledCurve& curve = Mutable(view.GetMain().startLifetime);
+        curve.curve.first = header.keyframes.count;
+        curve.curve.count = 1;
+    });
+    CheckRecordRejected("curve key count", image, [](const CompiledEffectHeader&, const CompiledEffectView& view) {
+        CompiledCurve& curve = Mutable(view.GetMain().startSpeed);
+        curve.curveMax.first = 1;
+        curve.curveMax.count = 0xFFFFFFFFu;
+    });
+    CheckRecordRejected("bursts", image, [](const CompiledEffectHeader& header, const CompiledEffectView& view) {
+        Mutable(*view.GetModule<CompiledEmissionModule>(kCompiledEmission)).bursts.count = header.bursts.count + 1;
+    });
+    CheckRecordRejected("gradient", image, [](const CompiledEffectHeader& header, const CompiledEffectView& view) {
+        Mutable(*view.GetModule<CompiledColorModule>(kCompiledColorOverLifetime)).gradient.alphaKeys.first =
+            header.alphaKeys.count;
+    });
+}
+
+std::vector<uint8_t> ReadFile(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::printf("usage: test_compiled_effect <test_basic.gpart>\n");
+        return 1;
+    }
+
+    const std::vector<uint8_t> json = ReadFile(argv[1]);
+    CHECK(!json.empty());
+
+    ParticleLoader loader;
+    std::unique_ptr<ParticleSystemData> basic = loader.LoadFromString(std::string(json.begin(), json.end()));
+    CHECK(basic != nullptr);
+    if (basic) {
+        CheckRoundTrip("test_basic", *basic);
+    }
+
+    const ParticleSystemData full = MakeFullEffect();
+    CheckRoundTrip("every module", full);
+    CheckRejection(full);
+
+    return Test::Result("compiled_effect");
+}
@@ -0,0 +1,121 @@
+// Reference test of RenderPacketBuilder::OrientQuads
+//
+// Every case has its four corners worked out by hand from the render
+// mode's definition, so the test does not lean on ComputeQuadAxes. Each
+// case fills a batch of eleven particles: two SSE groups and a scalar tail.
+
+#include "test_common.h"
+#include "../client/render_packet.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace GPUParticles;
+
+namespace {
+
+const uint32_t kBatchCount = 11;
+const float kTolerance = 2e-3f;
+const float kHalfPi = 1.5707963f;
+
+struct Case {
+    const char* name;
+    ParticleSystemRenderMode mode;
+    float size;
+    float rotation;
+    Vector3f velocity;     // Already scaled
+    Vector3f corners[4];   // Offsets from the center of corners (-1,-1), (1,-1), (1,1), (-1,1)
+};
+
+const float kCornerX[4] = { -1, 1, 1, -1 };
+const float kCornerY[4] = { -1, -1, 1, 1 };
+
+// Camera at (0, -100, 0). Its right vector leaves the ground plane, so
+// vertical billboards flatten it to (0.6, 0.8, 0).
+CameraData MakeCamera() {
+    CameraData camera;
+    camera.position = Vector3f(0, -100, 0);
+    camera.right = Vector3f(0.48f, 0.64f, 0.6f);
+    camera.up = Vector3f(-0.36f, -0.48f, 0.8f);
+    camera.forward = Vector3f(0.8f, -0.6f, 0.0f);
+    return camera;
+}
+
+const Case kCases[] = {
+    // World X and Y, scaled by the size
+    { "horizontal", ParticleSystemRenderMode::HorizontalBillboard, 2.0f, 0.0f, Vector3f(0, 0, 0),
+      { Vector3f(-2, -2, 0), Vector3f(2, -2, 0), Vector3f(2, 2, 0), Vector3f(-2, 2, 0) } },
+    // A quarter turn carries corner +X to +Y
+    { "horizontal rotated", ParticleSystemRenderMode::HorizontalBillboard, 2.0f, kHalfPi, Vector3f(0, 0, 0),
+      { Vector3f(2, -2, 0), Vector3f(2, 2, 0), Vector3f(-2, 2, 0), Vector3f(-2, -2, 0) } },
+    // Flattened camera right and world Z
+    { "vertical", ParticleSystemRenderMode::VerticalBillboard, 1.0f, 0.0f, Vector3f(0, 0, 0),
+      { Vector3f(-0.6f, -0.8f, -1), Vector3f(0.6f, 0.8f, -1), Vector3f(0.6f, 0.8f, 1), Vector3f(-0.6f, -0.8f, 1) } },
+    { "vertical rotated", ParticleSystemRenderMode::VerticalBillboard, 1.0f, kHalfPi, Vector3f(0, 0, 0),
+      { Vector3f(0.6f, 0.8f, -1), Vector3f(0.6f, 0.8f, 1), Vector3f(-0.6f, -0.8f, 1), Vector3f(-0.6f, -0.8f, -1) } },
+    // Moving along X seen from -Y: half-length size * lengthScale + speed / 2
+    // = 2 + 5 along X, half-width 1 along velocity x toCamera = -Z.
+    // Stretch ignores rotation.
+    { "stretch", ParticleSystemRenderMode::Stretch, 1.0f, 0.7f, Vector3f(10, 0, 0),
+      { Vector3f(-7, 0, 1), Vector3f(-7, 0, -1), Vector3f(7, 0, -1), Vector3f(7, 0, 1) } },
+    // Still particles fall back to the camera's own axes
+    { "stretch still", ParticleSystemRenderMode::Stretch, 1.5f, 0.0f, Vector3f(0, 0, 0),
+      { Vector3f(-0.18f, -0.24f, -2.1f), Vector3f(1.26f, 1.68f, -0.3f), Vector3f(0.18f, 0.24f, 2.1f),
+        Vector3f(-1.26f, -1.68f, 0.3f) } },
+    // So do particles moving straight along the view ray
+    { "stretch along view", ParticleSystemRenderMode::Stretch, 1.0f, 0.0f, Vector3f(0, 5, 0),
+      { Vector3f(-0.12f, -0.16f, -1.4f), Vector3f(0.84f, 1.12f, -0.2f), Vector3f(0.12f, 0.16f, 1.4f),
+        Vector3f(-0.84f, -1.12f, 0.2f) } },
+};
+
+void CheckCase(const Case& test, const CameraData& camera) {
+    RenderModeParams params;
+    params.mode = test.mode;
+    params.velocityScale = Vector3f(1, 1, 1);
+    params.lengthScale = 2.0f;
+
+    // Centers on the camera's Y axis keep every case's view ray along Y
+    static OrientedQuadBatch batch;
+    for (uint32_t i = 0; i < kBatchCount; ++i) {
+        batch.x[i] = 0.0f;
+        batch.y[i] = 3.0f * i;
+        batch.z[i] = 0.0f;
+        batch.vx[i] = test.velocity.x;
+        batch.vy[i] = test.velocity.y;
+        batch.vz[i] = test.velocity.z;
+        batch.size[i] = test.size;
+        batch.rotation[i] = test.rotation;
+        batch.color[i] = 0xFFFFFFFFu;
+    }
+
+    RenderPacketBuilder::OrientQuads(params, camera, batch, kBatchCount);
+
+    int failures = 0;
+    for (uint32_t i = 0; i < kBatchCount; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            const float cx = kCornerX[c];
+            const float cy = kCornerY[c];
+            const float x = batch.axisXx[i] * cx + batch.axisYx[i] * cy;
+            const float y = batch.axisXy[i] * cx + batch.axisYy[i] * cy;
+            const float z = batch.axisXz[i] * cx + batch.axisYz[i] * cy;
+            const Vector3f& expected = test.corners[c];
+            if (std::fabs(x - expected.x) > kTolerance || std::fabs(y - expected.y) > kTolerance ||
+                std::fabs(z - expected.z) > kTolerance) {
+                if (failures++ == 0) {
+                    std::printf("%s: particle %u corner (%g, %g) at (%g, %g, %g), expected (%g, %g, %g)\n",
+                                test.name, i, cx, cy, x, y, z, expected.x, expected.y, expected.z);
+                }
+            }
+        }
+    }
+    CHECK(failures == 0);
+}
+
+} // namespace
+
+int main() {
+    const CameraData camera = MakeCamera();
+    for (const Case& test : kCases) {
+        CheckCase(test, camera);
+    }
+    return Test::Result("orient_quads");
+}
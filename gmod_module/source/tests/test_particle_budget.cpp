@@ -0,0 +1,87 @@
+// Budget allocation under stress: thousands of instances with random
+// limits, priorities and distances must never be given more particles in
+// total than the global budget, and no instance more than it asked for.
+
+#include "test_common.h"
+#include "../client/particle_budget.h"
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+void CheckAllocation(ParticleBudgetManager& budget, const std::vector<BudgetRequest>& requests) {
+    std::vector<BudgetAllocation> allocations;
+    budget.Allocate(requests, allocations);
+    CHECK(allocations.size() == requests.size());
+
+    long long total = 0;
+    for (size_t i = 0; i < allocations.size(); ++i) {
+        const BudgetAllocation& allocation = allocations[i];
+        CHECK(allocation.particleCap >= 0);
+        CHECK(allocation.particleCap <= std::max(0, requests[i].maxParticles));
+        CHECK(allocation.emissionScale >= 0.0f && allocation.emissionScale <= 1.0f);
+        // Compensation only ever enlarges (alpha is 1/coverage, so allow rounding)
+        CHECK(allocation.sizeCompensation >= 1.0f && allocation.alphaCompensation >= 0.999f);
+        total += allocation.particleCap;
+    }
+
+    CHECK(total <= budget.GetBudget());
+    CHECK(total == budget.GetLastAllocated());
+}
+
+} // namespace
+
+int main() {
+    Test::Random random(26);
+    ParticleBudgetManager budget;
+
+    // Many instances against budgets from starved to generous
+    const int budgets[] = { 0, 1, 100, 5000, 20000, 200000 };
+    const int instanceCounts[] = { 1, 10, 500, 10000 };
+
+    for (int limit : budgets) {
+        budget.SetBudget(limit);
+        for (int count : instanceCounts) {
+            for (int round = 0; round < 4; ++round) {
+                std::vector<BudgetRequest> requests(count);
+                for (BudgetRequest& request : requests) {
+                    request.maxParticles = static_cast<int>(random.Range(-10.0f, 5000.0f));
+                    request.priority = random.Range(-1.0f, 8.0f);
+                    request.distance = random.Range(0.0f, 20000.0f);
+                    request.radius = random.Range(0.0f, 500.0f);
+                }
+                CheckAllocation(budget, requests);
+            }
+        }
+    }
+
+    // Equal instances over budget share it evenly
+    budget.SetBudget(1000);
+    std::vector<BudgetRequest> equal(10);
+    for (BudgetRequest& request : equal) {
+        request.maxParticles = 500;
+    }
+    std::vector<BudgetAllocation> allocations;
+    budget.Allocate(equal, allocations);
+    for (const BudgetAllocation& allocation : allocations) {
+        CHECK(allocation.particleCap == 100);
+        CHECK(allocation.sizeCompensation > 1.0f);
+    }
+
+    // Under budget everyone keeps their full demand
+    budget.SetBudget(100000);
+    budget.Allocate(equal, allocations);
+    for (const BudgetAllocation& allocation : allocations) {
+        CHECK(allocation.particleCap == 500);
+        CHECK(allocation.emissionScale == 1.0f);
+    }
+
+    // Higher priority wins a larger share
+    budget.SetBudget(600);
+    equal[0].priority = 4.0f;
+    budget.Allocate(equal, allocations);
+    CHECK(allocations[0].particleCap > allocations[1].particleCap);
+
+    return Test::Result("test_particle_budget");
+}
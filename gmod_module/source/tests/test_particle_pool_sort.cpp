@@ -0,0 +1,172 @@
+// Headless test of ParticlePool::SortBackToFront with mixed sort modes
+//
+// Distance sources are sorted per particle; age-sorted sources must stay
+// one block at their emitter's depth, ordered by age inside it, across
+// frames that reuse the previous order and frames whose layout changes.
+
+#include "test_common.h"
+#include "../client/particle_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace GPUParticles;
+
+namespace {
+
+std::vector<Particle> MakeParticles(Test::Random& random, int count, const Vector3& center) {
+    std::vector<Particle> particles(count);
+    for (Particle& p : particles) {
+        p.position = Vector3(center.x + random.Range(-5.0f, 5.0f), center.y + random.Range(-5.0f, 5.0f),
+                             center.z + random.Range(-5.0f, 5.0f));
+        p.age = random.Range(0.0f, 3.0f);
+        p.alive = true;
+    }
+    return particles;
+}
+
+ParticlePool::Source MakeSource(const std::vector<Particle>& particles, const Vector3& position,
+                                ParticleSystemSortMode sortMode) {
+    ParticlePool::Source source;
+    source.particles = &particles;
+    source.aliveCount = static_cast<int>(particles.size());
+    source.position = position;
+    source.scale = 1.0f;
+    source.alphaScale = 1.0f;
+    source.tint = Color(1, 1, 1, 1);
+    source.blend = BlendMode::Alpha;
+    source.sortMode = sortMode;
+    source.shape = nullptr;
+    source.templateIndex = 0;
+    source.packet = nullptr;
+    source.version = 1;
+    return source;
+}
+
+float DistanceSq(float x, float y, float z, const Vector3& camera) {
+    float dx = x - camera.x;
+    float dy = y - camera.y;
+    float dz = z - camera.z;
+    return dx * dx + dy * dy + dz * dz;
+}
+
+void CheckOrder(const ParticlePool& pool, const Vector3& camera) {
+    const std::vector<uint32_t>& order = pool.GetOrder();
+    const uint32_t count = pool.GetCount();
+    CHECK(order.size() == count);
+
+    std::vector<uint32_t> seen(order);
+    std::sort(seen.begin(), seen.end());
+    for (uint32_t i = 0; i < seen.size(); ++i) {
+        CHECK(seen[i] == i);
+    }
+
+    // Walk the order as units: a particle, or a whole age-sorted range
+    float lastDepth = 1e30f;
+    size_t k = 0;
+    while (k < order.size()) {
+        const ParticlePool::SourceRange* block = nullptr;
+        for (const ParticlePool::SourceRange& range : pool.GetSourceRanges()) {
+            if (range.sortMode != ParticleSystemSortMode::Distance && order[k] >= range.begin &&
+                order[k] < range.begin + range.count) {
+                block = &range;
+            }
+        }
+
+        float depth;
+        if (!block) {
+            const uint32_t i = order[k];
+            depth = DistanceSq(pool.GetX()[i], pool.GetY()[i], pool.GetZ()[i], camera);
+            k++;
+        } else {
+            depth = DistanceSq(block->emitter.x, block->emitter.y, block->emitter.z, camera);
+            CHECK(k + block->count <= order.size());
+            for (uint32_t j = 0; j < block->count && k + j < order.size(); ++j) {
+                CHECK(order[k + j] >= block->begin && order[k + j] < block->begin + block->count);
+            }
+            k += block->count;
+        }
+
+        // Keys keep 22 bits, so allow for their rounding
+        CHECK(depth <= lastDepth * 1.001f);
+        lastDepth = depth;
+    }
+}
+
+// Ages along the draw order of each age-sorted range
+void CheckAges(const ParticlePool& pool, const std::vector<std::vector<Particle>>& particles) {
+    const std::vector<uint32_t>& order = pool.GetOrder();
+    const std::vector<ParticlePool::SourceRange>& ranges = pool.GetSourceRanges();
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        const ParticlePool::SourceRange& range = ranges[r];
+        if (range.sortMode == ParticleSystemSortMode::Distance) {
+            continue;
+        }
+
+        size_t first = order.size();
+        for (size_t k = 0; k < order.size(); ++k) {
+            if (order[k] >= range.begin && order[k] < range.begin + range.count) {
+                first = std::min(first, k);
+            }
+        }
+        CHECK(first + range.count <= order.size());
+        if (first + range.count > order.size()) {
+            continue;
+        }
+
+        // Compared as sort keys, which round ages to 22 bits
+        const std::vector<Particle>& source = particles[r];
+        for (uint32_t j = 1; j < range.count; ++j) {
+            uint32_t previous = ParticleSorter::FloatKey(source[order[first + j - 1] - range.begin].age);
+            uint32_t current = ParticleSorter::FloatKey(source[order[first + j] - range.begin].age);
+            if (range.sortMode == ParticleSystemSortMode::OldestInFront) {
+                CHECK(previous <= current);
+            } else {
+                CHECK(previous >= current);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    Test::Random random(41);
+    const Vector3 camera(0, 0, 0);
+
+    const ParticleSystemSortMode modes[] = {
+        ParticleSystemSortMode::Distance, ParticleSystemSortMode::OldestInFront,
+        ParticleSystemSortMode::Distance, ParticleSystemSortMode::YoungestInFront,
+        ParticleSystemSortMode::OldestInFront,
+    };
+    const int instances = static_cast<int>(sizeof(modes) / sizeof(modes[0]));
+
+    std::vector<std::vector<Particle>> particles(instances);
+    std::vector<Vector3> positions(instances);
+    ParticlePool pool;
+
+    for (int frame = 0; frame < 6; ++frame) {
+        // Counts change every other frame so both the reused and the rebuilt
+        // unit order are covered
+        std::vector<ParticlePool::Source> sources;
+        for (int i = 0; i < instances; ++i) {
+            if (frame % 2 == 0) {
+                positions[i] = Vector3(random.Range(-60.0f, 60.0f), random.Range(-60.0f, 60.0f), 0.0f);
+                particles[i] = MakeParticles(random, 20 + static_cast<int>(random.Next() % 200), positions[i]);
+            } else {
+                for (Particle& p : particles[i]) {
+                    p.position.x += random.Range(-0.5f, 0.5f);
+                    p.age += 0.016f;
+                }
+            }
+            sources.push_back(MakeSource(particles[i], positions[i], modes[i]));
+        }
+
+        pool.Fill(sources);
+        pool.SortBackToFront(camera);
+        CheckOrder(pool, camera);
+        CheckAges(pool, particles);
+    }
+
+    return Test::Result("particle_pool_sort");
+}
@@ -0,0 +1,157 @@
+// Headless test of the point sprite path: ScreenSizeFilter::IsPointSprite
+// and RenderPacketBuilder::PackPointSprite
+//
+// Checks which particles become points, that the width survives the trip
+// through the alpha byte, that alpha is folded into the width as
+// sqrt(alpha), and that sprites under one pixel are kept with the
+// probability of their remaining coverage.
+
+#include "test_common.h"
+#include "../client/render_packet.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GPUParticles;
+
+namespace {
+
+const float kViewportHeight = 1080.0f;
+
+// Camera at the origin looking down +X with a 90 degree vertical FOV, so a
+// unit half-extent at depth d is kViewportHeight / d pixels
+ScreenSizeFilter MakeFilter(float pointSpriteSize) {
+    CameraData camera;
+    camera.position = Vector3f(0, 0, 0);
+    camera.right = Vector3f(0, -1, 0);
+    camera.up = Vector3f(0, 0, 1);
+    camera.forward = Vector3f(1, 0, 0);
+
+    float projection[16] = {};
+    projection[0] = 1.0f;
+    projection[5] = 1.0f;
+    projection[10] = 1.0f;
+    projection[11] = 1.0f;
+
+    ScreenSizeFilter filter;
+    filter.SetView(camera, projection, kViewportHeight);
+    filter.SetPointSpriteSize(pointSpriteSize);
+    return filter;
+}
+
+float DecodeWidth(const PointSpriteVertex& vertex) {
+    return static_cast<float>(vertex.color >> 24) / PointSpriteVertex::kSizeScale;
+}
+
+void TestIsPointSprite() {
+    const ScreenSizeFilter filter = MakeFilter(4.0f);
+    RenderModeParams billboard;
+    float pixels = 0.0f;
+
+    // 1080 / 540 = 2 pixels: a point, with its projected width reported
+    CHECK(filter.IsPointSprite(billboard, Vector3f(540, 0, 0), 1.0f, pixels));
+    CHECK(std::fabs(pixels - 2.0f) < 1e-3f);
+
+    // 1080 / 216 = 5 pixels: still a quad
+    CHECK(!filter.IsPointSprite(billboard, Vector3f(216, 0, 0), 1.0f, pixels));
+
+    // Only camera-facing quads keep their look as points
+    RenderModeParams stretched;
+    stretched.mode = ParticleSystemRenderMode::Stretch;
+    CHECK(!filter.IsPointSprite(stretched, Vector3f(540, 0, 0), 1.0f, pixels));
+    RenderModeParams horizontal;
+    horizontal.mode = ParticleSystemRenderMode::HorizontalBillboard;
+    CHECK(!filter.IsPointSprite(horizontal, Vector3f(540, 0, 0), 1.0f, pixels));
+
+    // Off, and capped at what the size byte holds
+    const ScreenSizeFilter off = MakeFilter(0.0f);
+    CHECK(!off.IsPointSprite(billboard, Vector3f(540, 0, 0), 1.0f, pixels));
+    CHECK(MakeFilter(100.0f).GetPointSpriteSize() == PointSpriteVertex::kMaxPixels);
+}
+
+void TestSizeRoundTrip() {
+    const Vector3f center(1, 2, 3);
+    PointSpriteVertex vertex;
+
+    // Opaque particles keep their width to the nearest 1/16 pixel
+    for (float pixels = 1.0f; pixels <= PointSpriteVertex::kMaxPixels; pixels += 0.37f) {
+        CHECK(RenderPacketBuilder::PackPointSprite(center, 0xFF204080u, pixels, BlendMode::Alpha, 0, vertex));
+        CHECK(std::fabs(DecodeWidth(vertex) - pixels) <= 0.5f / PointSpriteVertex::kSizeScale);
+        CHECK((vertex.color & 0x00FFFFFFu) == 0x00204080u);
+        CHECK(vertex.position.x == center.x && vertex.position.y == center.y && vertex.position.z == center.z);
+    }
+
+    // Wider than the byte holds: clamped, not wrapped
+    CHECK(RenderPacketBuilder::PackPointSprite(center, 0xFFFFFFFFu, 40.0f, BlendMode::Alpha, 0, vertex));
+    CHECK((vertex.color >> 24) == 0xFFu);
+}
+
+void TestAlphaFolding() {
+    const Vector3f center(0, 0, 0);
+    PointSpriteVertex vertex;
+
+    // Drawn opaque, so the area carries the alpha: width^2 = pixels^2 * alpha
+    const uint32_t alphas[] = { 0x10, 0x40, 0x80, 0xC0, 0xFF };
+    for (uint32_t alpha : alphas) {
+        const float pixels = 12.0f;
+        const uint32_t color = (alpha << 24) | 0x00336699u;
+        CHECK(RenderPacketBuilder::PackPointSprite(center, color, pixels, BlendMode::Additive, 0, vertex));
+
+        const float expected = pixels * std::sqrt(static_cast<float>(alpha) / 255.0f);
+        CHECK(std::fabs(DecodeWidth(vertex) - expected) <= 0.5f / PointSpriteVertex::kSizeScale);
+        CHECK((vertex.color & 0x00FFFFFFu) == 0x00336699u);
+    }
+
+    // Premultiplied colors are divided back to the straight color
+    CHECK(RenderPacketBuilder::PackPointSprite(center, 0x80402010u, 8.0f, BlendMode::Premultiplied, 0, vertex));
+    const int red = static_cast<int>((vertex.color >> 16) & 0xFF);
+    const int green = static_cast<int>((vertex.color >> 8) & 0xFF);
+    const int blue = static_cast<int>(vertex.color & 0xFF);
+    CHECK(std::abs(red - 0x80) <= 1 && std::abs(green - 0x40) <= 1 && std::abs(blue - 0x20) <= 1);
+}
+
+void TestSubPixelCut() {
+    Test::Random random(49);
+    const Vector3f center(0, 0, 0);
+    const uint32_t count = 100000;
+
+    // Each case folds to a width below one pixel; survivors are one pixel
+    // wide, so the kept fraction should match width^2
+    struct Case {
+        float pixels;
+        uint32_t alpha;
+    };
+    const Case cases[] = { { 0.5f, 0xFF }, { 0.9f, 0xFF }, { 2.0f, 0x10 }, { 3.0f, 0x04 } };
+
+    for (const Case& test : cases) {
+        const float width = test.pixels * std::sqrt(static_cast<float>(test.alpha) / 255.0f);
+        const uint32_t color = (test.alpha << 24) | 0x00FFFFFFu;
+
+        uint32_t kept = 0;
+        bool onePixel = true;
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t key = ScreenSizeFilter::GetParticleKey(i, random.Range(1.0f, 4.0f), center);
+            PointSpriteVertex vertex;
+            if (RenderPacketBuilder::PackPointSprite(center, color, test.pixels, BlendMode::Alpha, key, vertex)) {
+                kept++;
+                onePixel = onePixel && (vertex.color >> 24) == static_cast<uint32_t>(PointSpriteVertex::kSizeScale);
+            }
+        }
+
+        const float fraction = static_cast<float>(kept) / count;
+        std::printf("pixels %.2f alpha %3u: width %.3f, kept %.4f (expected %.4f)\n", test.pixels, test.alpha,
+                    width, fraction, width * width);
+        CHECK(onePixel);
+        CHECK(std::fabs(fraction - width * width) < 0.01f);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestIsPointSprite();
+    TestSizeRoundTrip();
+    TestAlphaFolding();
+    TestSubPixelCut();
+    return Test::Result("point_sprites");
+}
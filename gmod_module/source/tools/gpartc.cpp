@@ -0,0 +1,143 @@
+// gpartc - compile .gpart effects to the binary .gpartc format
+//
+// Parses each JSON effect with the client's ParticleLoader and writes the
+// flat image described in compiled_effect.h, which the module loads with
+// bounds checks and pointer fix-ups instead of a JSON parse. The output is
+// read back and checked before the tool reports success.
+//
+// Usage: gpartc <effect.gpart>... [-o output.gpartc]
+
+#include "../client/compiled_effect.h"
+#include "../client/particle_loader.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using GPUParticles::CompiledEffect;
+using GPUParticles::CompiledEffectView;
+using GPUParticles::ParticleLoader;
+using GPUParticles::ParticleSystemData;
+
+namespace {
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+int CountModules(uint32_t mask) {
+    int count = 0;
+    for (; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+// Parse, compile, write, then load the written file the way the module does
+bool CompileEffect(const std::string& input, const std::string& output, std::string& error) {
+    std::vector<uint8_t> source;
+    if (!ReadFile(input, source)) {
+        error = "cannot open " + input;
+        return false;
+    }
+    if (CompiledEffect::IsCompiled(source.data(), source.size())) {
+        error = input + " is already compiled";
+        return false;
+    }
+
+    ParticleLoader loader;
+    std::unique_ptr<ParticleSystemData> data =
+        loader.LoadFromString(std::string(source.begin(), source.end()));
+    if (!data) {
+        error = input + ": " + loader.GetLastError();
+        return false;
+    }
+
+    const std::vector<uint8_t> image = CompiledEffect::Compile(*data);
+    if (!WriteFile(output, image)) {
+        error = "cannot write " + output;
+        return false;
+    }
+
+    std::unique_ptr<ParticleSystemData> check = loader.LoadFromFile(output);
+    if (!check) {
+        error = output + " does not load back: " + loader.GetLastError();
+        return false;
+    }
+
+    CompiledEffectView view;
+    view.Open(image.data(), image.size(), error);
+    const GPUParticles::CompiledEffectHeader& header = view.GetHeader();
+    std::printf("%s -> %s: %zu -> %zu bytes, %d module(s), %u keyframe(s), %u burst(s)\n",
+                input.c_str(), output.c_str(), source.size(), image.size(), CountModules(header.moduleMask),
+                header.keyframes.count, header.bursts.count);
+    return true;
+}
+
+void PrintUsage() {
+    std::cout << "Usage: gpartc <effect.gpart>... [options]\n"
+              << "  -o FILE   Output path (one input only; default is the input path + \"c\")\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<std::string> inputs;
+    std::string output;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "-o" && hasValue) {
+            output = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        } else if (arg[0] != '-') {
+            inputs.push_back(arg);
+        } else {
+            std::cerr << "gpartc: unknown option " << arg << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (inputs.empty()) {
+        std::cerr << "gpartc: no input effect" << std::endl;
+        return 1;
+    }
+    if (!output.empty() && inputs.size() > 1) {
+        std::cerr << "gpartc: -o needs a single input" << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (const std::string& input : inputs) {
+        std::string error;
+        if (!CompileEffect(input, output.empty() ? input + "c" : output, error)) {
+            std::cerr << "gpartc: " << error << std::endl;
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
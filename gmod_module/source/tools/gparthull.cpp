@@ -0,0 +1,232 @@
+// gparthull - offline report of alpha-trimmed particle outlines
+//
+// Computes the convex outline the renderer would draw for every frame of
+// a particle texture (or flipbook sheet) and the fill it saves against the
+// full quad. Uses the same AlphaHull code as the client module, without
+// any graphics API, so it runs on build machines.
+//
+// Usage: gparthull <texture.tga> [--tiles XxY] [--vertices 4-8|all] [--threshold N] [--uv]
+
+#include "../client/alpha_hull.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using GPUParticles::AlphaHull;
+
+namespace {
+
+// Alpha channel of a decoded image, rows top to bottom
+struct AlphaImage {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> alpha;
+};
+
+// Uncompressed and RLE TGA, 8-bit greyscale (used as alpha) or 32-bit BGRA
+bool LoadTGA(const std::string& path, AlphaImage& image, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 18) {
+        error = "truncated header";
+        return false;
+    }
+
+    const uint8_t idLength = data[0];
+    const uint8_t colorMapType = data[1];
+    const uint8_t imageType = data[2];
+    const int width = data[12] | (data[13] << 8);
+    const int height = data[14] | (data[15] << 8);
+    const int bitsPerPixel = data[16];
+    const bool topDown = (data[17] & 0x20) != 0;
+
+    const bool rle = imageType == 10 || imageType == 11;
+    const bool grey = imageType == 3 || imageType == 11;
+    if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !rle)) {
+        error = "unsupported image type (need uncompressed or RLE truecolor/greyscale)";
+        return false;
+    }
+    if ((grey && bitsPerPixel != 8) || (!grey && bitsPerPixel != 32)) {
+        error = "unsupported pixel depth (need 8-bit greyscale or 32-bit BGRA)";
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        error = "empty image";
+        return false;
+    }
+
+    const size_t pixelBytes = static_cast<size_t>(bitsPerPixel / 8);
+    const size_t alphaOffset = grey ? 0 : 3;
+    const size_t pixelCount = static_cast<size_t>(width) * height;
+    size_t pos = 18 + idLength;
+
+    std::vector<uint8_t> pixels;
+    pixels.reserve(pixelCount);
+    while (pixels.size() < pixelCount) {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle) {
+            if (pos >= data.size()) {
+                break;
+            }
+            const uint8_t packet = data[pos++];
+            run = (packet & 0x7F) + 1u;
+            repeat = (packet & 0x80) != 0;
+        }
+
+        for (size_t i = 0; i < run && pixels.size() < pixelCount; ++i) {
+            if (pos + pixelBytes > data.size()) {
+                error = "truncated pixel data";
+                return false;
+            }
+            pixels.push_back(data[pos + alphaOffset]);
+            if (!repeat || i + 1 == run) {
+                pos += pixelBytes;
+            }
+        }
+    }
+    if (pixels.size() < pixelCount) {
+        error = "truncated pixel data";
+        return false;
+    }
+
+    image.width = width;
+    image.height = height;
+    image.alpha.resize(pixelCount);
+    for (int y = 0; y < height; ++y) {
+        const int source = topDown ? y : height - 1 - y;
+        std::memcpy(&image.alpha[static_cast<size_t>(y) * width],
+                    &pixels[static_cast<size_t>(source) * width], static_cast<size_t>(width));
+    }
+    return true;
+}
+
+void PrintUsage() {
+    std::cout << "Usage: gparthull <texture.tga> [options]\n"
+              << "  --tiles XxY       Flipbook layout (frames left to right, top to bottom)\n"
+              << "  --vertices N|all  Outline corner limit, 4-8 (default 8)\n"
+              << "  --threshold N     Alpha at or below N counts as empty (default 0)\n"
+              << "  --uv              Print the outline corners of every frame\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string path;
+    int tilesX = 1;
+    int tilesY = 1;
+    int minVertices = 8;
+    int maxVertices = 8;
+    int threshold = 0;
+    bool printUV = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (arg == "--tiles" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &tilesX, &tilesY) != 2 || tilesX <= 0 || tilesY <= 0) {
+                std::cerr << "gparthull: bad --tiles value (expected XxY)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--vertices" && hasValue) {
+            const std::string value = argv[++i];
+            if (value == "all") {
+                minVertices = 4;
+                maxVertices = AlphaHull::kMaxVertices;
+            } else {
+                minVertices = maxVertices = std::atoi(value.c_str());
+                if (minVertices < 4 || minVertices > AlphaHull::kMaxVertices) {
+                    std::cerr << "gparthull: --vertices must be 4-8 or all" << std::endl;
+                    return 1;
+                }
+            }
+        } else if (arg == "--threshold" && hasValue) {
+            threshold = std::atoi(argv[++i]);
+            if (threshold < 0 || threshold > 254) {
+                std::cerr << "gparthull: --threshold must be 0-254" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--uv") {
+            printUV = true;
+        } else if (arg == "--help" || arg == "-h") {
+            PrintUsage();
+            return 0;
+        } else if (path.empty() && arg[0] != '-') {
+            path = arg;
+        } else {
+            std::cerr << "gparthull: unknown option " << arg << std::endl;
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    AlphaImage image;
+    std::string error;
+    if (path.empty() || !LoadTGA(path, image, error)) {
+        std::cerr << "gparthull: " << (path.empty() ? "no input texture" : error) << std::endl;
+        return 1;
+    }
+
+    if (image.width % tilesX != 0 || image.height % tilesY != 0) {
+        std::cerr << "gparthull: " << image.width << "x" << image.height
+                  << " does not divide into " << tilesX << "x" << tilesY << " frames" << std::endl;
+        return 1;
+    }
+
+    const int frameWidth = image.width / tilesX;
+    const int frameHeight = image.height / tilesY;
+    const int frameCount = tilesX * tilesY;
+
+    std::printf("%s: %dx%d, %d frame(s) of %dx%d\n",
+                path.c_str(), image.width, image.height, frameCount, frameWidth, frameHeight);
+
+    for (int limit = minVertices; limit <= maxVertices; ++limit) {
+        std::printf("\n%d-vertex outlines\n", limit);
+        std::printf("  frame  corners   area  saved\n");
+
+        double totalArea = 0.0;
+        for (int frame = 0; frame < frameCount; ++frame) {
+            const int x = (frame % tilesX) * frameWidth;
+            const int y = (frame / tilesX) * frameHeight;
+            const uint8_t* first = &image.alpha[static_cast<size_t>(y) * image.width + x];
+
+            const AlphaHull hull = AlphaHull::Compute(first, frameWidth, frameHeight, 1, image.width,
+                                                      limit, static_cast<uint8_t>(threshold));
+            totalArea += hull.area;
+
+            std::printf("  %5d  %7d  %5.1f%%  %4.1f%%\n",
+                        frame, hull.vertexCount, hull.area * 100.0f, (1.0f - hull.area) * 100.0f);
+            if (printUV) {
+                std::printf("         uv:");
+                for (int c = 0; c < hull.vertexCount; ++c) {
+                    std::printf(" (%.4f, %.4f)", hull.u[c], hull.v[c]);
+                }
+                std::printf("\n");
+            }
+        }
+
+        // Frames are shown for equal time over a particle's life, so the
+        // mean is the fill saved on average
+        const double meanArea = totalArea / frameCount;
+        std::printf("  mean   %7s  %5.1f%%  %4.1f%%\n", "", meanArea * 100.0, (1.0 - meanArea) * 100.0);
+    }
+
+    return 0;
+}
@@ -9,8 +9,12 @@ namespace GModParticleExporter
     {
         private ParticleSystem selectedParticleSystem;
         private string exportPath = "Assets/Export/";
+        private int hullVertices = 0;
         private Vector2 scrollPosition;
 
+        private static readonly string[] HullVertexLabels = { "Full Quad", "4", "6", "8" };
+        private static readonly int[] HullVertexCounts = { 0, 4, 6, 8 };
+
         [MenuItem("Tools/GMod Particle Exporter")]
         public static void ShowWindow()
         {
@@ -47,6 +51,9 @@ namespace GModParticleExporter
             }
             EditorGUILayout.EndHorizontal();
 
+            // Corners of the outline drawn around the texture's visible texels
+            hullVertices = EditorGUILayout.IntPopup("Outline Vertices", hullVertices, HullVertexLabels, HullVertexCounts);
+
             EditorGUILayout.Space();
             EditorGUILayout.Space();
 
@@ -386,7 +393,8 @@ namespace GModParticleExporter
                     velocityScale = new Vector3Data(renderer.velocityScale),
                     lengthScale = renderer.lengthScale,
                     normalDirection = renderer.normalDirection,
-                    sortingOrder = renderer.sortingOrder
+                    sortingOrder = renderer.sortingOrder,
+                    hullVertices = hullVertices
                 };
             }
         }
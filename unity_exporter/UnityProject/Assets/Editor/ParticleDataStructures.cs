@@ -352,6 +352,7 @@ namespace GModParticleExporter
         public float lengthScale;
         public float normalDirection;
         public int sortingOrder;
+        public int hullVertices;
     }
 
     [Serializable]